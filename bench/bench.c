@@ -0,0 +1,653 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+/*  build_coast benchmark.  Generates a repeatable set of synthetic coastline shapefiles and times each phase of a
+    build on them.  See usage for the options.  */
+
+#include <getopt.h>
+
+#include "build_coast.h"
+#include "cell_store.h"
+#include "ingest.h"
+#include "prefetch.h"
+#include "encode.h"
+#include "ccl_reader.h"
+#include "version.h"
+
+#ifdef NVWIN3X
+#include <windows.h>
+#define         NULL_DEVICE         "NUL"
+#else
+#include <time.h>
+#define         NULL_DEVICE         "/dev/null"
+#endif
+
+
+/*  Phases that are timed.  */
+
+#define         PHASE_READ          0
+#define         PHASE_INGEST        1
+#define         PHASE_BUCKET        2
+#define         PHASE_ENCODE        3
+#define         PHASE_WRITE         4
+#define         PHASE_DECODE        5
+#define         NUM_PHASES          6
+
+
+/*  build_coast.h expects this (main.c normally has it).  The library code is always quiet here.  */
+
+int32_t verbosity = VERBOSE_QUIET;
+
+
+/*  Synthetic data parameters.  */
+
+typedef struct
+{
+  int32_t       num_files;              /*  Number of shapefiles  */
+  int32_t       num_shapes;             /*  Shapes per file  */
+  int32_t       max_parts;              /*  Each shape has 1 to max_parts rings  */
+  int32_t       vertices;               /*  Vertices per ring  */
+  double        radius;                 /*  Mean ring radius in degrees (bigger rings cross more cell boundaries)  */
+  double        jitter;                 /*  Random radial noise as a fraction of the radius  */
+  uint64_t      seed;
+} GEN_PARAMS;
+
+
+/*  Best and total time for a phase along with the work it did on each run.  */
+
+typedef struct
+{
+  const char    *name;
+  double        best;
+  double        total;
+  int32_t       runs;
+  double        vertices;
+  double        bytes;
+} PHASE;
+
+
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s [--files N] [--shapes N] [--parts N] [--vertices N] [--radius DEG] [--jitter F] [--seed N]\n", name);
+  fprintf (stderr, "       [--repeat N] [--threads N] [--max-memory MB] [--mmap] [--compact] [--dir DIR] [--keep]\n");
+  fprintf (stderr, "--files N        number of synthetic shapefiles (default 4)\n");
+  fprintf (stderr, "--shapes N       shapes in each file (default 2000)\n");
+  fprintf (stderr, "--parts N        each shape has 1 to N rings (default 3)\n");
+  fprintf (stderr, "--vertices N     vertices in each ring, the vertex density (default 2000)\n");
+  fprintf (stderr, "--radius DEG     mean ring radius, the cell crossing frequency (default 0.5)\n");
+  fprintf (stderr, "--jitter F       radial noise as a fraction of the radius, how jagged the coast is (default 0.3)\n");
+  fprintf (stderr, "--seed N         random number seed, the same seed always gives the same files (default 1)\n");
+  fprintf (stderr, "--repeat N       number of timed runs of each phase, the best time is reported (default 3)\n");
+  fprintf (stderr, "--threads N, --max-memory MB, --mmap, --compact   same as build_coast\n");
+  fprintf (stderr, "--dir DIR        directory for the generated files (default .)\n");
+  fprintf (stderr, "--keep           don't remove the generated files\n");
+  exit (-1);
+}
+
+
+
+static double now ()
+{
+#ifdef NVWIN3X
+  LARGE_INTEGER     freq, count;
+
+  QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter (&count);
+
+  return ((double) count.QuadPart / (double) freq.QuadPart);
+#else
+  struct timespec   ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ((double) ts.tv_sec + (double) ts.tv_nsec * 1.0e-9);
+#endif
+}
+
+
+
+static void phase_time (PHASE *phase, double seconds, double vertices, double bytes)
+{
+  if (!phase->runs || seconds < phase->best) phase->best = seconds;
+  phase->total += seconds;
+  phase->runs++;
+  phase->vertices = vertices;
+  phase->bytes = bytes;
+}
+
+
+
+/*  xorshift64* so the files are the same on every system for a given seed.  */
+
+static double random_unit (uint64_t *state)
+{
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+
+  return ((double) ((*state * 0x2545f4914f6cdd1dULL) >> 11) / 9007199254740992.0);
+}
+
+
+
+static int64_t file_size (const char *name)
+{
+  FILE              *fp;
+  int64_t           size;
+
+
+  if ((fp = fopen (name, "rb")) == NULL) return (0);
+
+  fseek (fp, 0, SEEK_END);
+  size = (int64_t) ftell (fp);
+  fclose (fp);
+
+  return (size);
+}
+
+
+
+/*  Write one synthetic polygon shapefile.  Each ring is a jagged circle (closed, like a GSHHS island) placed at random
+    between 70S and 70N (and away from the date line).  Returns the number of vertices written.  */
+
+static double generate_file (const char *name, const GEN_PARAMS *gen, uint64_t *state)
+{
+  SHPHandle         shpHandle;
+  SHPObject         *shape;
+  double            *x, *y, cx, cy, r, angle, margin, total = 0.0;
+  int32_t           i, j, p, parts, nv, part_start[64];
+
+
+  if ((shpHandle = SHPCreate (name, SHPT_POLYGON)) == NULL)
+    {
+      perror (name);
+      exit (-1);
+    }
+
+  /*  Keep the rings clear of the date line so that none of them wraps.  */
+
+  margin = 2.0 * gen->radius;
+
+  x = (double *) malloc ((size_t) gen->max_parts * (gen->vertices + 1) * sizeof (double));
+  y = (double *) malloc ((size_t) gen->max_parts * (gen->vertices + 1) * sizeof (double));
+  if (x == NULL || y == NULL)
+    {
+      perror ("Allocating vertex memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < gen->num_shapes ; i++)
+    {
+      parts = 1 + (int32_t) (random_unit (state) * gen->max_parts);
+      if (parts > gen->max_parts) parts = gen->max_parts;
+
+      for (p = 0, nv = 0 ; p < parts ; p++)
+        {
+          part_start[p] = nv;
+
+          cx = -180.0 + margin + (360.0 - 2.0 * margin) * random_unit (state);
+          cy = -70.0 + margin + (140.0 - 2.0 * margin) * random_unit (state);
+          r = gen->radius * (0.5 + random_unit (state));
+
+          for (j = 0 ; j < gen->vertices ; j++)
+            {
+              angle = 2.0 * M_PI * (double) j / (double) gen->vertices;
+
+              x[nv] = cx + r * (1.0 + gen->jitter * (random_unit (state) - 0.5)) * cos (angle);
+              y[nv] = cy + r * (1.0 + gen->jitter * (random_unit (state) - 0.5)) * sin (angle);
+
+              nv++;
+            }
+
+          x[nv] = x[part_start[p]];
+          y[nv] = y[part_start[p]];
+          nv++;
+        }
+
+      shape = SHPCreateObject (SHPT_POLYGON, -1, parts, part_start, NULL, nv, x, y, NULL, NULL);
+      SHPWriteObject (shpHandle, -1, shape);
+      SHPDestroyObject (shape);
+
+      total += nv;
+    }
+
+  SHPClose (shpHandle);
+
+  free (x);
+  free (y);
+
+  return (total);
+}
+
+
+
+/*  Read every shape with shapelib and nothing else.  This is the floor for the ingest phase.  */
+
+static double read_files (char **files, int32_t num_files)
+{
+  SHPHandle         shpHandle;
+  SHPObject         *shape;
+  int32_t           m, i, numShapes, type;
+  double            minBounds[4], maxBounds[4], total = 0.0;
+
+
+  for (m = 0 ; m < num_files ; m++)
+    {
+      if ((shpHandle = SHPOpen (files[m], "rb")) == NULL)
+        {
+          perror (files[m]);
+          exit (-1);
+        }
+
+      SHPGetInfo (shpHandle, &numShapes, &type, minBounds, maxBounds);
+
+      for (i = 0 ; i < numShapes ; i++)
+        {
+          if ((shape = SHPReadObject (shpHandle, i)) != NULL)
+            {
+              total += shape->nVertices;
+              SHPDestroyObject (shape);
+            }
+        }
+
+      SHPClose (shpHandle);
+    }
+
+  return (total);
+}
+
+
+
+/*  Move every segment record from src to a new store (releasing them from src) the way pass 1 adds them.  Returns
+    the number of vertices moved.  */
+
+static double bucket_store (CELL_STORE *src, CELL_STORE *dst)
+{
+  int32_t           cell, *data;
+  size_t            count, rec;
+  double            total = 0.0;
+
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      if ((data = cell_store_load (src, cell, &count)) == NULL) continue;
+
+      for (rec = 0 ; rec < count ; rec += 1 + 2 * (size_t) data[rec])
+        {
+          cell_store_add (dst, cell % CELL_COLS, cell / CELL_COLS, &data[rec]);
+          total += data[rec];
+        }
+
+      cell_store_release (src, cell);
+    }
+
+  return (total);
+}
+
+
+
+/*  Decode every cell of a .ccl file through the reader.  Returns the number of vertices decoded.  */
+
+static double decode_file (const char *name)
+{
+  CCL_FILE          *ccl;
+  int32_t           cell, max_segments = 0, max_vertices = 0, *count;
+  double            *lon, *lat, total = 0.0;
+
+
+  if ((ccl = ccl_open (name, 1)) == NULL)
+    {
+      fprintf (stderr, "Unable to open %s\n", name);
+      exit (-1);
+    }
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      max_segments = MAX (max_segments, ccl->level[0].num_segments[cell]);
+      max_vertices = MAX (max_vertices, ccl->level[0].num_vertices[cell]);
+    }
+
+  count = (int32_t *) malloc ((size_t) MAX (max_segments, 1) * sizeof (int32_t));
+  lon = (double *) malloc ((size_t) MAX (max_vertices, 1) * sizeof (double));
+  lat = (double *) malloc ((size_t) MAX (max_vertices, 1) * sizeof (double));
+  if (count == NULL || lon == NULL || lat == NULL)
+    {
+      perror ("Allocating decode memory");
+      exit (-1);
+    }
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      if (ccl_decode_cell (ccl, 0, cell, count, max_segments, lon, lat, max_vertices) < 0)
+        {
+          fprintf (stderr, "Unable to decode cell %d of %s\n", cell, name);
+          exit (-1);
+        }
+
+      total += ccl->level[0].num_vertices[cell];
+    }
+
+  free (count);
+  free (lon);
+  free (lat);
+  ccl_close (ccl);
+
+  return (total);
+}
+
+
+
+/*  Write a .ccl file from a store.  Returns the number of vertices packed.  */
+
+static double encode_store (CELL_STORE *store, OPTIONS *options, const char *name)
+{
+  FILE              *fp;
+  char              version[VERSION_SIZE];
+  double            total;
+
+
+  if ((fp = fopen (name, "wb")) == NULL)
+    {
+      perror (name);
+      exit (-1);
+    }
+
+  memset (version, 0, VERSION_SIZE);
+  sprintf (version, "%s\n", options->compact ? COMPACT_FILE_VERSION : FILE_VERSION);
+  fwrite (version, VERSION_SIZE, 1, fp);
+
+  total = encode_cells (store, fp, options, NULL);
+
+  if (fclose (fp))
+    {
+      perror (name);
+      exit (-1);
+    }
+
+  return (total);
+}
+
+
+
+int32_t main (int32_t argc, char **argv)
+{
+  GEN_PARAMS        gen;
+  OPTIONS           options;
+  CELL_STORE        store, bucket;
+  PHASE             phase[NUM_PHASES];
+  FILE              *fp;
+  uint8_t           keep, *buffer;
+  char              dir[512], ccl_name[600], copy_name[600], name[600], **files;
+  int32_t           i, c, option_index, repeat, run, max_memory;
+  int64_t           shp_bytes, ccl_bytes;
+  double            start, vertices, input_vertices;
+  uint64_t          state;
+
+
+  gen.num_files = 4;
+  gen.num_shapes = 2000;
+  gen.max_parts = 3;
+  gen.vertices = 2000;
+  gen.radius = 0.5;
+  gen.jitter = 0.3;
+  gen.seed = 1;
+
+  memset (&options, 0, sizeof (OPTIONS));
+  options.num_threads = default_thread_count ();
+  options.prefetch = DEFAULT_PREFETCH;
+  max_memory = DEFAULT_MAX_MEMORY;
+  repeat = 3;
+  keep = NVFalse;
+  strcpy (dir, ".");
+
+  while (NVTrue)
+    {
+      static struct option long_options[] = {{"files", required_argument, 0, 0},
+                                             {"shapes", required_argument, 0, 0},
+                                             {"parts", required_argument, 0, 0},
+                                             {"vertices", required_argument, 0, 0},
+                                             {"radius", required_argument, 0, 0},
+                                             {"jitter", required_argument, 0, 0},
+                                             {"seed", required_argument, 0, 0},
+                                             {"repeat", required_argument, 0, 0},
+                                             {"threads", required_argument, 0, 0},
+                                             {"max-memory", required_argument, 0, 0},
+                                             {"mmap", no_argument, 0, 0},
+                                             {"compact", no_argument, 0, 0},
+                                             {"dir", required_argument, 0, 0},
+                                             {"keep", no_argument, 0, 0},
+                                             {0, no_argument, 0, 0}};
+
+      c = getopt_long (argc, argv, "", long_options, &option_index);
+      if (c == -1) break;
+
+      if (c != 0) usage (argv[0]);
+
+      switch (option_index)
+        {
+        case 0:
+          if (sscanf (optarg, "%d", &gen.num_files) != 1 || gen.num_files < 1) usage (argv[0]);
+          break;
+
+        case 1:
+          if (sscanf (optarg, "%d", &gen.num_shapes) != 1 || gen.num_shapes < 1) usage (argv[0]);
+          break;
+
+        case 2:
+          if (sscanf (optarg, "%d", &gen.max_parts) != 1 || gen.max_parts < 1 || gen.max_parts > 64) usage (argv[0]);
+          break;
+
+        case 3:
+          if (sscanf (optarg, "%d", &gen.vertices) != 1 || gen.vertices < 3) usage (argv[0]);
+          break;
+
+        case 4:
+          if (sscanf (optarg, "%lf", &gen.radius) != 1 || gen.radius <= 0.0 || gen.radius > 20.0) usage (argv[0]);
+          break;
+
+        case 5:
+          if (sscanf (optarg, "%lf", &gen.jitter) != 1 || gen.jitter < 0.0 || gen.jitter > 1.0) usage (argv[0]);
+          break;
+
+        case 6:
+          if (sscanf (optarg, "%llu", (unsigned long long *) &gen.seed) != 1 || !gen.seed) usage (argv[0]);
+          break;
+
+        case 7:
+          if (sscanf (optarg, "%d", &repeat) != 1 || repeat < 1) usage (argv[0]);
+          break;
+
+        case 8:
+          if (sscanf (optarg, "%d", &options.num_threads) != 1 || options.num_threads < 1) usage (argv[0]);
+          break;
+
+        case 9:
+          if (sscanf (optarg, "%d", &max_memory) != 1 || max_memory < 0) usage (argv[0]);
+          break;
+
+        case 10:
+          options.use_mmap = NVTrue;
+          break;
+
+        case 11:
+          options.compact = NVTrue;
+          break;
+
+        case 12:
+          strncpy (dir, optarg, sizeof (dir) - 1);
+          dir[sizeof (dir) - 1] = 0;
+          break;
+
+        case 13:
+          keep = NVTrue;
+          break;
+        }
+    }
+
+  if (optind != argc) usage (argv[0]);
+
+  options.max_memory = (size_t) max_memory * 1024 * 1024;
+
+
+  memset (phase, 0, sizeof (phase));
+  phase[PHASE_READ].name = "read";
+  phase[PHASE_INGEST].name = "ingest";
+  phase[PHASE_BUCKET].name = "bucket";
+  phase[PHASE_ENCODE].name = "encode";
+  phase[PHASE_WRITE].name = "write";
+  phase[PHASE_DECODE].name = "decode";
+
+
+  /*  Generate the input files.  */
+
+  files = (char **) malloc (gen.num_files * sizeof (char *));
+  if (files == NULL)
+    {
+      perror ("Allocating file names");
+      exit (-1);
+    }
+
+  state = gen.seed;
+  input_vertices = 0.0;
+  shp_bytes = 0;
+
+  start = now ();
+
+  for (i = 0 ; i < gen.num_files ; i++)
+    {
+      sprintf (name, "%s/bench_%d.shp", dir, i);
+      files[i] = strdup (name);
+
+      input_vertices += generate_file (files[i], &gen, &state);
+      shp_bytes += file_size (files[i]);
+    }
+
+  fprintf (stderr, "\nGenerated %d files, %d shapes, %.0f vertices, %.1f MB in %.2f seconds (seed %llu)\n\n", gen.num_files,
+           gen.num_files * gen.num_shapes, input_vertices, (double) shp_bytes / 1048576.0, now () - start,
+           (unsigned long long) gen.seed);
+
+  sprintf (ccl_name, "%s/bench.ccl", dir);
+  sprintf (copy_name, "%s/bench_copy.ccl", dir);
+
+
+  /*  One untimed build to warm up the file cache and get the output size.  */
+
+  cell_store_init (&store, options.max_memory);
+  ingest_files (&store, files, gen.num_files, &options, NULL);
+  encode_store (&store, &options, ccl_name);
+  cell_store_free (&store);
+
+  ccl_bytes = file_size (ccl_name);
+
+  if ((buffer = (uint8_t *) malloc ((size_t) ccl_bytes)) == NULL || (fp = fopen (ccl_name, "rb")) == NULL ||
+      fread (buffer, (size_t) ccl_bytes, 1, fp) != 1)
+    {
+      perror (ccl_name);
+      exit (-1);
+    }
+  fclose (fp);
+
+
+  for (run = 0 ; run < repeat ; run++)
+    {
+      start = now ();
+      vertices = read_files (files, gen.num_files);
+      phase_time (&phase[PHASE_READ], now () - start, vertices, (double) shp_bytes);
+
+
+      cell_store_init (&store, options.max_memory);
+
+      start = now ();
+      ingest_files (&store, files, gen.num_files, &options, NULL);
+      phase_time (&phase[PHASE_INGEST], now () - start, input_vertices, (double) shp_bytes);
+
+
+      /*  Rebucketing the split segments measures the cell store by itself, including spills if the budget is small.  */
+
+      cell_store_init (&bucket, options.max_memory);
+
+      start = now ();
+      vertices = bucket_store (&store, &bucket);
+      phase_time (&phase[PHASE_BUCKET], now () - start, vertices, vertices * 2.0 * sizeof (int32_t));
+
+      cell_store_free (&store);
+
+
+      /*  Packing into the null device leaves out the cost of the file system.  */
+
+      start = now ();
+      vertices = encode_store (&bucket, &options, NULL_DEVICE);
+      phase_time (&phase[PHASE_ENCODE], now () - start, vertices, (double) ccl_bytes);
+
+      cell_store_free (&bucket);
+
+
+      start = now ();
+      if ((fp = fopen (copy_name, "wb")) == NULL || fwrite (buffer, (size_t) ccl_bytes, 1, fp) != 1 || fclose (fp))
+        {
+          perror (copy_name);
+          exit (-1);
+        }
+      phase_time (&phase[PHASE_WRITE], now () - start, vertices, (double) ccl_bytes);
+
+
+      start = now ();
+      vertices = decode_file (ccl_name);
+      phase_time (&phase[PHASE_DECODE], now () - start, vertices, (double) ccl_bytes);
+    }
+
+
+  fprintf (stderr, "Threads %d, memory budget %d MB%s%s, %d runs, output %.1f MB\n\n", options.num_threads, max_memory,
+           options.use_mmap ? ", mmap" : "", options.compact ? ", compact" : "", repeat, (double) ccl_bytes / 1048576.0);
+
+  printf ("%-8s %10s %10s %14s %10s\n", "phase", "best (s)", "mean (s)", "vertices/s", "MB/s");
+
+  for (i = 0 ; i < NUM_PHASES ; i++)
+    {
+      printf ("%-8s %10.4f %10.4f %14.0f %10.1f\n", phase[i].name, phase[i].best, phase[i].total / phase[i].runs,
+              phase[i].best > 0.0 ? phase[i].vertices / phase[i].best : 0.0,
+              phase[i].best > 0.0 ? phase[i].bytes / phase[i].best / 1048576.0 : 0.0);
+    }
+
+
+  free (buffer);
+
+  if (!keep)
+    {
+      for (i = 0 ; i < gen.num_files ; i++)
+        {
+          remove (files[i]);
+          strcpy (name, files[i]);
+          strcpy (&name[strlen (name) - 4], ".shx");
+          remove (name);
+        }
+
+      remove (ccl_name);
+      remove (copy_name);
+    }
+
+  for (i = 0 ; i < gen.num_files ; i++) free (files[i]);
+  free (files);
+
+  return (0);
+}
@@ -0,0 +1,14 @@
+INCLUDEPATH += /c/PFM/compile/include
+LIBS += -L /c/PFM/compile/lib -lnvutility -lgdal -lxml2 -lpoppler -lz -lm -liconv -lpsapi -lpthread
+DEFINES += NVWIN3X
+CONFIG += console
+CONFIG -= qt
+QMAKE_LFLAGS += 
+
+TEMPLATE = app
+TARGET = build_coast_bench
+DEPENDPATH += . ..
+INCLUDEPATH += . ..
+
+HEADERS += ../build_coast.h ../ccl_format.h ../ccl_reader.h ../cell_store.h ../encode.h ../ingest.h ../prefetch.h ../stats.h ../version.h
+SOURCES += bench.c ../ccl_reader.c ../cell_store.c ../encode.c ../ingest.c ../manifest.c ../merge.c ../prefetch.c ../quantize.c ../shp_map.c ../simplify.c ../spool.c ../stats.c ../tile.c
@@ -0,0 +1,88 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __BIT_READER_H__
+#define __BIT_READER_H__
+
+#include <stdint.h>
+#include <string.h>
+
+
+/*  The read side of bit_writer.h.  Fields are read most significant bit first (the bit_pack/bit_unpack layout) by
+    loading the eight bytes that hold the field and shifting, so any field of 1 to 32 bits is one load.  Bytes past the
+    end of the buffer read as zero so a corrupt count can't make us read outside of it.  This header only needs the C
+    library so that the reader can be used outside of build_coast.  */
+
+typedef struct
+{
+  const uint8_t *buffer;                /*  Input buffer  */
+  size_t        size;                   /*  Number of bytes in buffer  */
+  size_t        pos;                    /*  Next bit to read  */
+} BIT_READER;
+
+
+static inline void bit_reader_init (BIT_READER *br, const uint8_t *buffer, size_t size)
+{
+  br->buffer = buffer;
+  br->size = size;
+  br->pos = 0;
+}
+
+
+static inline uint32_t bit_reader_get (BIT_READER *br, int32_t bits)
+{
+  size_t        byte = br->pos >> 3;
+  uint64_t      word = 0;
+  int32_t       i;
+
+
+  if (byte + 8 <= br->size)
+    {
+#if defined (__GNUC__) && defined (__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      memcpy (&word, &br->buffer[byte], 8);
+      word = __builtin_bswap64 (word);
+#else
+      for (i = 0 ; i < 8 ; i++) word = (word << 8) | br->buffer[byte + i];
+#endif
+    }
+  else
+    {
+      for (i = 0 ; i < 8 ; i++) word = (word << 8) | (byte + i < br->size ? br->buffer[byte + i] : 0);
+    }
+
+  word <<= (br->pos & 7);
+  br->pos += bits;
+
+  return ((uint32_t) (word >> (64 - bits)));
+}
+
+
+/*  Skip to the start of the next byte (segment records are byte aligned).  */
+
+static inline void bit_reader_align (BIT_READER *br)
+{
+  br->pos = (br->pos + 7) & ~(size_t) 7;
+}
+
+
+#endif
@@ -0,0 +1,103 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __BIT_WRITER_H__
+#define __BIT_WRITER_H__
+
+#include "build_coast.h"
+
+
+/*  A word at a time replacement for calling bit_pack once per field when packing segment records.  Bits are written
+    most significant bit first, exactly the same layout that bit_pack produces (and bit_unpack reads), so the output
+    is unchanged.  Pending bits are collected in a 64 bit accumulator and written out 32 bits at a time.  Everything
+    is inline so that calls with constant widths (the fixed segment header fields) compile down to a shift and an or.
+
+    Only whole bytes are ever written so the buffer just has to hold all of the bits rounded up to a byte.  Fields may
+    be 1 to 32 bits wide.  */
+
+typedef struct
+{
+  uint8_t       *buffer;                /*  Output buffer  */
+  size_t        pos;                    /*  Next byte to write in buffer  */
+  uint64_t      acc;                    /*  Pending bits (the low nbits bits)  */
+  int32_t       nbits;                  /*  Number of pending bits (always less than 32 between calls)  */
+} BIT_WRITER;
+
+
+static inline void bit_writer_init (BIT_WRITER *bw, uint8_t *buffer)
+{
+  bw->buffer = buffer;
+  bw->pos = 0;
+  bw->acc = 0;
+  bw->nbits = 0;
+}
+
+
+static inline void bit_writer_put (BIT_WRITER *bw, int32_t bits, uint32_t value)
+{
+  uint32_t      word;
+
+
+  bw->acc = (bw->acc << bits) | ((uint64_t) value & ((1ULL << bits) - 1));
+  bw->nbits += bits;
+
+  if (bw->nbits >= 32)
+    {
+      bw->nbits -= 32;
+      word = (uint32_t) (bw->acc >> bw->nbits);
+
+      bw->buffer[bw->pos] = (uint8_t) (word >> 24);
+      bw->buffer[bw->pos + 1] = (uint8_t) (word >> 16);
+      bw->buffer[bw->pos + 2] = (uint8_t) (word >> 8);
+      bw->buffer[bw->pos + 3] = (uint8_t) word;
+      bw->pos += 4;
+    }
+}
+
+
+/*  Write out whatever is left in the accumulator (padded with zero bits to a whole byte).  Returns the number of bytes
+    written to the buffer.  */
+
+static inline size_t bit_writer_flush (BIT_WRITER *bw)
+{
+  while (bw->nbits > 0)
+    {
+      if (bw->nbits >= 8)
+        {
+          bw->nbits -= 8;
+          bw->buffer[bw->pos++] = (uint8_t) (bw->acc >> bw->nbits);
+        }
+      else
+        {
+          bw->buffer[bw->pos++] = (uint8_t) (bw->acc << (8 - bw->nbits));
+          bw->nbits = 0;
+        }
+    }
+
+  bw->acc = 0;
+
+  return (bw->pos);
+}
+
+
+#endif
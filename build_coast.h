@@ -0,0 +1,129 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __BUILD_COAST_H__
+#define __BUILD_COAST_H__
+
+
+/*  The scratch file used when we spill cell data to disk can easily exceed 2GB.  */
+
+#ifndef _FILE_OFFSET_BITS
+#define         _FILE_OFFSET_BITS   64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <sys/types.h>
+
+#ifndef NVWIN3X
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include "nvutility.h"
+
+#include "shapefil.h"
+
+#include "ccl_format.h"
+
+
+/*  Default memory budget (in megabytes) for the in-memory cell store.  */
+
+#define         DEFAULT_MAX_MEMORY  1024
+
+
+/*  Share (1/MEMORY_WINDOW_SHARE) of the memory budget that the ingest task stores may hold in pass 1, and that the
+    cells packed ahead of the writer may hold in pass 2, before the threads wait for the merge or the writer to catch
+    up.  In pass 1 half of it is for the finished tasks waiting to be merged and the other half is split between the
+    running tasks, which hand their stores to the merge in slices.  The cell store gets the rest in pass 1.  In pass 2 the store only shrinks and whatever it
+    and the packed cells don't use is left for the records that have to be held until the end of the file (see
+    spool.h).  */
+
+#define         MEMORY_WINDOW_SHARE 8
+
+
+/*  Verbosity levels (--quiet and --trace).  */
+
+#define         VERBOSE_QUIET       0
+#define         VERBOSE_NORMAL      1
+#define         VERBOSE_TRACE       2
+
+extern int32_t verbosity;
+
+
+/*  Progress and summary messages.  These are suppressed by --quiet.  Errors are always printed.  */
+
+#define PROGRESS(...) do {if (verbosity >= VERBOSE_NORMAL) {fprintf (stderr, __VA_ARGS__); fflush (stderr);}} while (0)
+
+
+/*  Per segment and per vertex diagnostics.  These are compiled out completely unless BUILD_COAST_TRACE is defined (add
+    "DEFINES += BUILD_COAST_TRACE" to the .pro file) so production builds pay nothing for them.  In a trace build they
+    are printed with --trace.  */
+
+#ifdef BUILD_COAST_TRACE
+#define TRACE(...) do {if (verbosity >= VERBOSE_TRACE) fprintf (stderr, __VA_ARGS__);} while (0)
+#else
+#define TRACE(...) do {} while (0)
+#endif
+
+
+/*  What was written for each full resolution cell, kept for --verify (see verify.c).  */
+
+typedef struct
+{
+  uint64_t      hash;                   /*  verify_hash_segment of every segment that was packed, in order  */
+  int32_t       address;                /*  Header entries  */
+  int32_t       num_segments;
+  int32_t       num_vertices;
+  int32_t       size;                   /*  Bytes of cell records  */
+  uint8_t       packed;                 /*  NVTrue if the cell was packed from the store (hash is set)  */
+} CELL_CHECK;
+
+
+/*  Command line options that are needed outside of main.  */
+
+typedef struct
+{
+  size_t        max_memory;             /*  Memory budget (--max-memory) in bytes  */
+  int32_t       num_threads;            /*  Number of ingest and encoder threads  */
+  uint8_t       use_mmap;               /*  Read the input files through the memory mapped fast path  */
+  int32_t       prefetch;               /*  Batches of shapes read ahead of the segment splitter (--prefetch), 0 for none  */
+  uint8_t       streaming;              /*  Output is not seekable (stdout), write everything strictly in order  */
+  const uint8_t *region;                /*  CELL_COUNT flags for the cells inside --bbox, NULL for the whole world  */
+  double        region_bounds[4];       /*  West, south, east, and north edges (degrees) of the cells inside --bbox  */
+  int32_t       num_lod;                /*  Number of simplified levels of detail (--lod)  */
+  int32_t       lod_tolerance[CCL_MAX_LOD]; /*  Simplification tolerance for each level (POSITION_SCALE units)  */
+  uint8_t       compact;                /*  Write V2.0 compact segment records (--compact)  */
+  uint8_t       compress;               /*  zlib compress the compact records of each cell (--zlib)  */
+  uint8_t       merge;                  /*  Join segments whose end points coincide and drop degenerate ones (--merge)  */
+  int32_t       tile_threshold;         /*  Build quadtrees for cells with more vertices than this (--subdivide), 0 for none  */
+  CELL_CHECK    *check;                 /*  CELL_COUNT cells filled in by encode_cells for --verify, NULL otherwise  */
+  uint8_t       index;                  /*  Write the sparse index OUTPUT.cci next to the file (--index)  */
+  const uint8_t *inputs;                /*  --job flags for the input files that go into this output, NULL for all  */
+} OPTIONS;
+
+
+#endif
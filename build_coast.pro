@@ -1,5 +1,5 @@
 INCLUDEPATH += /c/PFM/compile/include
-LIBS += -L /c/PFM/compile/lib -lnvutility -lgdal -lxml2 -lpoppler -lz -lm -liconv
+LIBS += -L /c/PFM/compile/lib -lnvutility -lgdal -lxml2 -lpoppler -lz -lm -liconv -lpsapi -lpthread
 DEFINES += NVWIN3X
 CONFIG += console
 CONFIG -= qt
@@ -14,5 +14,5 @@ DEPENDPATH += .
 INCLUDEPATH += .
 
 # Input
-HEADERS += version.h
-SOURCES += main.c
+HEADERS += bit_reader.h bit_writer.h build_coast.h ccl_format.h ccl_reader.h cell_store.h delta_scan.h encode.h export.h index.h ingest.h job.h manifest.h merge.h prefetch.h quantize.h shp_map.h simplify.h spool.h stats.h tile.h varint.h verify.h version.h
+SOURCES += ccl_reader.c cell_store.c encode.c export.c index.c ingest.c job.c main.c manifest.c merge.c prefetch.c quantize.c shp_map.c simplify.c spool.c stats.c tile.c verify.c
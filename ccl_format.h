@@ -0,0 +1,253 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __CCL_FORMAT_H__
+#define __CCL_FORMAT_H__
+
+
+/*  Layout of the .ccl (compressed coastline) file.  These are shared by the writer (build_coast) and the reader
+    (ccl_reader.c) so keep anything that describes the file in here.  See the format description in main.c.  This
+    header doesn't depend on anything else in build_coast so it can be copied to other programs along with the reader.  */
+
+
+/*  Grid and position profile.  These are fixed when the program is built, not picked at run time, so every grid
+    size and bit width below is a constant in the quantizing and packing loops.  Build another profile by adding, for
+    example, "DEFINES += CCL_GRID=5 CCL_SCALE=6" to the .pro file (or setting CCL_GRID and CCL_SCALE for mk).
+
+        CCL_GRID        cell size in tenths of a degree: 5, 10 (the default), 20, or 50
+        CCL_SCALE       positions are stored in units of 1e-CCL_SCALE degrees: 4, 5 (the default), or 6
+
+    The default profile writes exactly the original one-degree, 1e-5 degree files.  Any other profile is recorded in
+    the version string (CCL_PROFILE_TAG) and the reader only opens files that were built with the profile it was
+    built with.  */
+
+#ifndef CCL_GRID
+#define         CCL_GRID            10
+#endif
+
+#ifndef CCL_SCALE
+#define         CCL_SCALE           5
+#endif
+
+#define         CCL_DEFAULT_PROFILE (CCL_GRID == 10 && CCL_SCALE == 5)
+
+
+/*  The cell grid.  Cells are numbered west to east, south to north beginning at -90/-180.  CELL_DEGREES is the size of
+    a cell and CELLS_PER_DEGREE is one over that (every cell size has to divide 180).  */
+
+#if CCL_GRID == 5
+#define         CELL_DEGREES        0.5
+#define         CELLS_PER_DEGREE    2.0
+#define         CELL_ROWS           360
+#define         CELL_COLS           720
+#define         CCL_GRID_NAME       "0.5"
+#elif CCL_GRID == 10
+#define         CELL_DEGREES        1.0
+#define         CELLS_PER_DEGREE    1.0
+#define         CELL_ROWS           180
+#define         CELL_COLS           360
+#define         CCL_GRID_NAME       "1"
+#elif CCL_GRID == 20
+#define         CELL_DEGREES        2.0
+#define         CELLS_PER_DEGREE    0.5
+#define         CELL_ROWS           90
+#define         CELL_COLS           180
+#define         CCL_GRID_NAME       "2"
+#elif CCL_GRID == 50
+#define         CELL_DEGREES        5.0
+#define         CELLS_PER_DEGREE    0.2
+#define         CELL_ROWS           36
+#define         CELL_COLS           72
+#define         CCL_GRID_NAME       "5"
+#else
+#error "CCL_GRID must be 5, 10, 20, or 50"
+#endif
+
+#define         CELL_COUNT          (CELL_ROWS * CELL_COLS)
+
+
+/*  Sizes of the version block and the header (address, number of segments, and number of vertices for each cell).  */
+
+#define         VERSION_SIZE        128
+#define         HEADER_ENTRY_SIZE   (3 * (int32_t) sizeof (int32_t))
+#define         HEADER_SIZE         (CELL_COUNT * HEADER_ENTRY_SIZE)
+
+
+/*  Every version block starts with this followed by " V<major>.<minor>".  The full strings are FILE_VERSION (V1.0, the
+    bit packed records) and COMPACT_FILE_VERSION (V2.0, the compact records) in version.h.  */
+
+#define         CCL_VERSION_PREFIX  "PFM Software - Compressed Coastline file"
+#define         CCL_COMPACT_MAJOR   2
+
+
+/*  Positions are stored as (lon + 180) and (lat + 90) times POSITION_SCALE.  The start fields have to hold 360 and 180
+    degrees and the 18 bit (at 1e-5) bias fields reach about 1.3 degrees, a little more than the longest step we
+    allow between two vertices that are kept by the simplification (CCL_MAX_LOD_STEP).  */
+
+#if CCL_SCALE == 4
+#define         POSITION_SCALE      10000.0
+#define         BIAS_WIDTH          15
+#define         START_LON_WIDTH     22
+#define         START_LAT_WIDTH     21
+#define         CCL_SCALE_NAME      "1e-4"
+#elif CCL_SCALE == 5
+#define         POSITION_SCALE      100000.0
+#define         BIAS_WIDTH          18
+#define         START_LON_WIDTH     26
+#define         START_LAT_WIDTH     25
+#define         CCL_SCALE_NAME      "1e-5"
+#elif CCL_SCALE == 6
+#define         POSITION_SCALE      1000000.0
+#define         BIAS_WIDTH          21
+#define         START_LON_WIDTH     29
+#define         START_LAT_WIDTH     28
+#define         CCL_SCALE_NAME      "1e-6"
+#else
+#error "CCL_SCALE must be 4, 5, or 6"
+#endif
+
+
+/*  Size of a cell in POSITION_SCALE units.  */
+
+#define         CELL_SPAN           ((int32_t) (CELL_DEGREES * POSITION_SCALE))
+
+
+/*  Cell size and position resolution (both in degrees).  Any profile but the default adds " (" CCL_PROFILE_NAME ")"
+    after the version number in FILE_VERSION and COMPACT_FILE_VERSION, for example "V1.0 (0.5 1e-6) - ".  */
+
+#define         CCL_PROFILE_NAME    CCL_GRID_NAME " " CCL_SCALE_NAME
+
+#if CCL_DEFAULT_PROFILE
+#define         CCL_PROFILE_TAG     ""
+#else
+#define         CCL_PROFILE_TAG     " (" CCL_PROFILE_NAME ")"
+#endif
+
+
+/*  Widths of the other fixed size fields at the start of each segment record.  */
+
+#define         COUNT_BITS_WIDTH    5
+#define         OFFSET_BITS_WIDTH   5
+
+
+/*  Largest lat/lon bias that can be stored in the bias fields (2**(BIAS_WIDTH - 1) - 1, 131071 at 1e-5).  This is
+    added to the bias before it is stored.  */
+
+#define         MAX_BIAS            ((1 << (BIAS_WIDTH - 1)) - 1)
+
+
+/*  Number of bytes in a segment record.  This is one lon/lat offset pair bigger than it needs to be (and always rounds
+    up a byte) but it's part of the format now since the records are packed back to back.  */
+
+#define         SEGMENT_RECORD_BYTES(count_bits, lon_bits, lat_bits, count) \
+  ((COUNT_BITS_WIDTH + 2 * OFFSET_BITS_WIDTH + (count_bits) + (lon_bits) + (lat_bits) + 2 * BIAS_WIDTH + \
+    START_LON_WIDTH + START_LAT_WIDTH + ((count) - 1) * ((lon_bits) + (lat_bits))) / 8 + 1)
+
+
+/*  Compact (V2.0) segment records.  The version block, header, and extensions are the same as V1.0 but each segment
+    record is a byte aligned run of varints (see varint.h):
+
+        vertex count
+        start lon and lat relative to the southwest corner of the cell (zigzag, POSITION_SCALE units)
+        count - 1 lon/lat offsets from the previous vertex (zigzag)
+
+    A typical offset takes one or two bytes and there is no fixed per segment overhead beyond the count and start.  If
+    the version block also has "[CELL COMPRESSION] = zlib" the records of each cell (at every level) are stored as the
+    32 bit big endian size of the records followed by one zlib stream of them.  Offsets in CCL_TAG_TILE leaves are
+    into the uncompressed records.  */
+
+#define         CCL_COMPRESSION_ZLIB "zlib"
+
+
+/*  Optional extensions.  A file with extensions has "[EXTENSION VERSION] = 1" (and a line for each extension, for
+    example "[LOD LEVELS] = 3") after FILE_VERSION in the version block and ends with a trailer that points to a
+    directory of the extension blocks.  Everything in front of the extensions is the plain V1.0 file so old readers
+    still work (they just see some slack after the last cell).  All values are 32 bit big endian (bit_pack) integers.
+
+        Trailer (last CCL_TRAILER_SIZE bytes):       directory address, number of entries, CCL_TRAILER_MAGIC
+
+        Directory entry (CCL_DIR_ENTRY_SIZE bytes):  4 character tag, block address, block size, parameter
+
+    CCL_TAG_BASE covers the plain file (version, header, and cells) so that readers know where the last cell ends.
+    Each CCL_TAG_LOD block is a simplified level of detail (coarsest last) and is laid out just like the plain file
+    without the version block.  That is, a HEADER_SIZE header (with absolute addresses) followed by the cell records.
+    The parameter is the simplification tolerance in POSITION_SCALE units.
+
+    The CCL_TAG_TILE block ("[TILE THRESHOLD] = N" in the version block) holds a quadtree for each full resolution
+    cell with more than N (the parameter) vertices so that small queries only have to decode some of the segments in a
+    dense cell.  The cell records themselves are not changed.  The block starts with the number of tiled cells and a
+    cell number, tree offset (from the start of the block), and tree size (bytes) for each of them.  A tree is a list
+    of nodes in depth first order.  A node that is CCL_TILE_SPLIT is followed by its four quarters (southwest,
+    southeast, northwest, northeast).  Any other node is a leaf holding the number of segments that touch it followed
+    by the byte offset (from the start of the cell's records) of each of those segment records, in increasing order.
+    A segment that crosses more than one leaf is listed in all of them.  */
+
+#define         CCL_EXTENSION_VERSION 1
+#define         CCL_TRAILER_MAGIC   "CCLX"
+#define         CCL_TRAILER_SIZE    12
+#define         CCL_DIR_ENTRY_SIZE  16
+#define         CCL_TAG_BASE        "BASE"
+#define         CCL_TAG_LOD         "LOD "
+#define         CCL_TAG_TILE        "TILE"
+#define         CCL_TILE_SPLIT      0xffffffff
+
+
+/*  Optional sparse index (OUTPUT.cci, written by --index next to OUTPUT.ccl) so that a reader can start without
+    loading the HEADER_SIZE header of each level, most of which is empty cells.  The .ccl file itself is unchanged.
+    All values are 32 bit big endian integers.
+
+        Version block:  a copy of the first VERSION_SIZE bytes of the .ccl file
+        Index header:   CCL_INDEX_MAGIC, CCL_INDEX_VERSION, size of the .ccl file, number of levels, address and size
+                        of the CCL_TAG_TILE block (0 if there isn't one), tile threshold
+        Each level:     tolerance, address one past the end of its cell records, number of populated cells N, a
+                        CELL_COUNT bit map of the populated cells (in header order, the first cell in the high bit,
+                        padded to a multiple of 32 bits), and the address, number of segments, and number of vertices
+                        of each of the N populated cells (in header order)
+
+    A reader only uses the index if its version block and .ccl size match the .ccl file (and it isn't older than the
+    .ccl file) and falls back to the headers otherwise.  */
+
+#define         CCL_INDEX_MAGIC     "CCLI"
+#define         CCL_INDEX_VERSION   1
+#define         CCL_INDEX_EXTENSION ".cci"
+#define         CCL_INDEX_HEADER_SIZE (VERSION_SIZE + 28)
+#define         CCL_INDEX_MAP_SIZE  (((CELL_COUNT + 31) / 32) * 4)
+
+
+/*  Maximum number of simplified levels.  */
+
+#define         CCL_MAX_LOD         8
+
+
+/*  Longest lon or lat step allowed between two vertices that are kept by the simplification (one degree).  This keeps
+    the deltas inside of what the bias fields can hold.  */
+
+#define         CCL_MAX_LOD_STEP    ((int32_t) POSITION_SCALE)
+
+
+/*  Maximum depth of a cell's quadtree (the smallest tiles are 1/32 of a degree on a side).  */
+
+#define         CCL_TILE_MAX_DEPTH  5
+
+
+#endif
@@ -0,0 +1,1127 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "ccl_reader.h"
+#include "bit_reader.h"
+#include "varint.h"
+
+#include <zlib.h>
+
+#include <math.h>
+
+#ifndef NVWIN3X
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+/*  Load the whole file.  We map it if we can, otherwise (Windows) we just read it.  Returns 0 on failure.  */
+
+static int32_t load_file (CCL_FILE *ccl, const char *name)
+{
+#ifndef NVWIN3X
+  struct stat       st;
+  void              *ptr;
+  int32_t           fd;
+
+
+  if ((fd = open (name, O_RDONLY)) < 0) return (0);
+
+  if (fstat (fd, &st) || st.st_size <= 0)
+    {
+      close (fd);
+      return (0);
+    }
+
+  ptr = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close (fd);
+
+  if (ptr == MAP_FAILED) return (0);
+
+  ccl->data = (const uint8_t *) ptr;
+  ccl->size = (size_t) st.st_size;
+  ccl->mapped = 1;
+#else
+  FILE              *fp;
+  uint8_t           *buf;
+  long              size;
+
+
+  if ((fp = fopen (name, "rb")) == NULL) return (0);
+
+  if (fseek (fp, 0, SEEK_END) || (size = ftell (fp)) <= 0 || fseek (fp, 0, SEEK_SET))
+    {
+      fclose (fp);
+      return (0);
+    }
+
+  if ((buf = (uint8_t *) malloc ((size_t) size)) == NULL || fread (buf, (size_t) size, 1, fp) != 1)
+    {
+      if (buf != NULL) free (buf);
+      fclose (fp);
+      return (0);
+    }
+
+  fclose (fp);
+
+  ccl->data = buf;
+  ccl->size = (size_t) size;
+  ccl->mapped = 0;
+#endif
+
+  return (1);
+}
+
+
+
+static void unload_file (CCL_FILE *ccl)
+{
+  if (ccl->data == NULL) return;
+
+#ifndef NVWIN3X
+  if (ccl->mapped)
+    {
+      munmap ((void *) ccl->data, ccl->size);
+      ccl->data = NULL;
+      return;
+    }
+#endif
+
+  free ((void *) ccl->data);
+  ccl->data = NULL;
+}
+
+
+
+/*  Work out the cell record sizes of a level.  The sizes aren't stored in the file but the cells are written back to
+    back in header order so each one runs up to the start of the next non-empty cell (or the end of the level's data).
+    No cell can start before first.  Returns 0 if the addresses don't make sense.  */
+
+static int32_t set_cell_sizes (CCL_LEVEL *level, size_t first, size_t end)
+{
+  int32_t           cell, next;
+
+
+  next = (int32_t) end;
+
+  for (cell = CELL_COUNT - 1 ; cell >= 0 ; cell--)
+    {
+      level->cell_size[cell] = 0;
+
+      if (level->address[cell])
+        {
+          if ((size_t) level->address[cell] < first || level->address[cell] > next) return (0);
+
+          level->cell_size[cell] = next - level->address[cell];
+          next = level->address[cell];
+        }
+    }
+
+  return (1);
+}
+
+
+
+/*  Allocate the four CELL_COUNT arrays of a level (zeroed).  */
+
+static int32_t alloc_level (CCL_LEVEL *level)
+{
+  if ((level->address = (int32_t *) calloc (4 * CELL_COUNT, sizeof (int32_t))) == NULL) return (0);
+
+  level->cell_size = level->address + CELL_COUNT;
+  level->num_segments = level->cell_size + CELL_COUNT;
+  level->num_vertices = level->num_segments + CELL_COUNT;
+
+  return (1);
+}
+
+
+
+/*  Load one level header (at header) and work out the cell record sizes.  Returns 0 if the header doesn't make
+    sense.  */
+
+static int32_t load_level (CCL_FILE *ccl, CCL_LEVEL *level, size_t header, size_t end)
+{
+  BIT_READER        br;
+  int32_t           cell;
+
+
+  if (header + HEADER_SIZE > end || end > ccl->size) return (0);
+
+  if (!alloc_level (level)) return (0);
+
+  bit_reader_init (&br, ccl->data + header, HEADER_SIZE);
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      level->address[cell] = (int32_t) bit_reader_get (&br, 32);
+      level->num_segments[cell] = (int32_t) bit_reader_get (&br, 32);
+      level->num_vertices[cell] = (int32_t) bit_reader_get (&br, 32);
+    }
+
+  return (set_cell_sizes (level, header + HEADER_SIZE, end));
+}
+
+
+
+/*  Load the CCL_TAG_TILE table (at address, size bytes).  Returns 0 if it doesn't make sense.  */
+
+static int32_t load_tiles (CCL_FILE *ccl, size_t address, size_t size)
+{
+  BIT_READER        br;
+  size_t            num, i, cell, offset, tree_size;
+
+
+  if (ccl->tile_address != NULL || size < 4) return (0);
+
+  bit_reader_init (&br, ccl->data + address, size);
+
+  num = bit_reader_get (&br, 32);
+  if (num > CELL_COUNT || 4 + 12 * num > size) return (0);
+
+  if ((ccl->tile_address = (int32_t *) calloc (2 * CELL_COUNT, sizeof (int32_t))) == NULL) return (0);
+  ccl->tile_size = ccl->tile_address + CELL_COUNT;
+
+  for (i = 0 ; i < num ; i++)
+    {
+      cell = bit_reader_get (&br, 32);
+      offset = bit_reader_get (&br, 32);
+      tree_size = bit_reader_get (&br, 32);
+
+      if (cell >= CELL_COUNT || tree_size < 4 || offset + tree_size > size) return (0);
+
+      ccl->tile_address[cell] = (int32_t) (address + offset);
+      ccl->tile_size[cell] = (int32_t) tree_size;
+    }
+
+  return (1);
+}
+
+
+
+/*  Read the extension directory (see ccl_format.h) if the file has one.  level 0 ends where the CCL_TAG_BASE block
+    says it does, each CCL_TAG_LOD block adds a level, and a CCL_TAG_TILE block has the quadtrees for the dense cells.
+    Returns 0 if the extensions are corrupt.  */
+
+static int32_t load_extensions (CCL_FILE *ccl, size_t *base_end)
+{
+  BIT_READER        br;
+  const uint8_t     *entry;
+  size_t            dir, num, address, size, i;
+  uint32_t          param;
+
+
+  *base_end = ccl->size;
+
+  if (strstr (ccl->version, "[EXTENSION VERSION]") == NULL) return (1);
+
+  if (ccl->size < VERSION_SIZE + HEADER_SIZE + CCL_TRAILER_SIZE ||
+      memcmp (ccl->data + ccl->size - 4, CCL_TRAILER_MAGIC, 4)) return (0);
+
+  bit_reader_init (&br, ccl->data + ccl->size - CCL_TRAILER_SIZE, CCL_TRAILER_SIZE);
+  dir = bit_reader_get (&br, 32);
+  num = bit_reader_get (&br, 32);
+
+  if (dir + num * CCL_DIR_ENTRY_SIZE + CCL_TRAILER_SIZE > ccl->size) return (0);
+
+  for (i = 0 ; i < num ; i++)
+    {
+      entry = ccl->data + dir + i * CCL_DIR_ENTRY_SIZE;
+
+      bit_reader_init (&br, entry + 4, CCL_DIR_ENTRY_SIZE - 4);
+      address = bit_reader_get (&br, 32);
+      size = bit_reader_get (&br, 32);
+      param = bit_reader_get (&br, 32);
+
+      if (address + size > dir) return (0);
+
+      if (!memcmp (entry, CCL_TAG_BASE, 4))
+        {
+          *base_end = address + size;
+        }
+      else if (!memcmp (entry, CCL_TAG_LOD, 4))
+        {
+          if (ccl->num_levels > CCL_MAX_LOD) return (0);
+
+          ccl->level[ccl->num_levels].tolerance = (int32_t) param;
+          if (!load_level (ccl, &ccl->level[ccl->num_levels], address, address + size)) return (0);
+          ccl->num_levels++;
+        }
+      else if (!memcmp (entry, CCL_TAG_TILE, 4))
+        {
+          ccl->tile_threshold = (int32_t) param;
+          ccl->tile_block = (int32_t) address;
+          ccl->tile_block_size = (int32_t) size;
+          if (!load_tiles (ccl, address, size)) return (0);
+        }
+
+
+      /*  Anything else is an extension that we don't know about.  */
+    }
+
+  return (1);
+}
+
+
+
+/*  Name of the sparse index of the .ccl file name (name with .ccl replaced by CCL_INDEX_EXTENSION).  */
+
+void ccl_index_name (const char *name, char *index_name, size_t size)
+{
+  size_t            len = strlen (name);
+
+
+  if (len >= 4 && !strcmp (name + len - 4, ".ccl")) len -= 4;
+
+  snprintf (index_name, size, "%.*s%s", (int) len, name, CCL_INDEX_EXTENSION);
+}
+
+
+
+/*  Read the whole index file into memory.  Returns NULL if there isn't one or it's older than the .ccl file.  */
+
+static uint8_t *read_index (const char *name, size_t *size)
+{
+  char              index_name[1024];
+  FILE              *fp;
+  uint8_t           *buf;
+  long              len;
+#ifndef NVWIN3X
+  struct stat       ccl_st, index_st;
+#endif
+
+
+  ccl_index_name (name, index_name, sizeof (index_name));
+
+#ifndef NVWIN3X
+  if (stat (index_name, &index_st) || stat (name, &ccl_st) || index_st.st_mtime < ccl_st.st_mtime) return (NULL);
+#endif
+
+  if ((fp = fopen (index_name, "rb")) == NULL) return (NULL);
+
+  if (fseek (fp, 0, SEEK_END) || (len = ftell (fp)) < CCL_INDEX_HEADER_SIZE || fseek (fp, 0, SEEK_SET) ||
+      (buf = (uint8_t *) malloc ((size_t) len)) == NULL)
+    {
+      fclose (fp);
+      return (NULL);
+    }
+
+  if (fread (buf, (size_t) len, 1, fp) != 1)
+    {
+      free (buf);
+      fclose (fp);
+      return (NULL);
+    }
+
+  fclose (fp);
+
+  *size = (size_t) len;
+
+  return (buf);
+}
+
+
+
+/*  Load the level headers and the quadtree table from the sparse index (see ccl_format.h) instead of the .ccl file,
+    so the only pages of the .ccl file that we touch are the version block and the quadtree table.  Returns 0 (and
+    the caller loads the headers) if there is no index or it doesn't match the .ccl file.  */
+
+static int32_t load_index (CCL_FILE *ccl, const char *name)
+{
+  BIT_READER        br, map;
+  CCL_LEVEL         *level;
+  uint8_t           *buf;
+  size_t            size, pos, end, tile_block, tile_size;
+  uint32_t          bits;
+  int32_t           i, k, cell, num, found, ok = 0;
+
+
+  if ((buf = read_index (name, &size)) == NULL) return (0);
+
+  if (memcmp (buf, ccl->data, VERSION_SIZE) || memcmp (buf + VERSION_SIZE, CCL_INDEX_MAGIC, 4)) goto done;
+
+  bit_reader_init (&br, buf + VERSION_SIZE + 4, CCL_INDEX_HEADER_SIZE - VERSION_SIZE - 4);
+
+  if (bit_reader_get (&br, 32) != CCL_INDEX_VERSION || bit_reader_get (&br, 32) != ccl->size) goto done;
+
+  ccl->num_levels = (int32_t) bit_reader_get (&br, 32);
+  tile_block = bit_reader_get (&br, 32);
+  tile_size = bit_reader_get (&br, 32);
+  ccl->tile_threshold = (int32_t) bit_reader_get (&br, 32);
+
+  if (ccl->num_levels < 1 || ccl->num_levels > 1 + CCL_MAX_LOD || tile_block + tile_size > ccl->size) goto done;
+
+
+  pos = CCL_INDEX_HEADER_SIZE;
+
+  for (i = 0 ; i < ccl->num_levels ; i++)
+    {
+      level = &ccl->level[i];
+
+      if (pos + 12 + CCL_INDEX_MAP_SIZE > size || !alloc_level (level)) goto done;
+
+      bit_reader_init (&br, buf + pos, 12);
+      level->tolerance = (int32_t) bit_reader_get (&br, 32);
+      end = bit_reader_get (&br, 32);
+      num = (int32_t) bit_reader_get (&br, 32);
+      pos += 12;
+
+      if (num < 0 || num > CELL_COUNT || end > ccl->size || pos + CCL_INDEX_MAP_SIZE + (size_t) num * 12 > size)
+        goto done;
+
+      bit_reader_init (&map, buf + pos, CCL_INDEX_MAP_SIZE);
+      pos += CCL_INDEX_MAP_SIZE;
+
+      bit_reader_init (&br, buf + pos, (size_t) num * 12);
+      pos += (size_t) num * 12;
+
+
+      /*  Walk the map a word at a time since most of it is empty.  */
+
+      found = 0;
+
+      for (cell = 0 ; cell < CELL_COUNT ; cell += 32)
+        {
+          for (bits = bit_reader_get (&map, 32) ; bits ; bits &= ~(0x80000000u >> k))
+            {
+              k = __builtin_clz (bits);
+
+              if (cell + k >= CELL_COUNT || ++found > num) goto done;
+
+              level->address[cell + k] = (int32_t) bit_reader_get (&br, 32);
+              level->num_segments[cell + k] = (int32_t) bit_reader_get (&br, 32);
+              level->num_vertices[cell + k] = (int32_t) bit_reader_get (&br, 32);
+
+              if (!level->address[cell + k]) goto done;
+            }
+        }
+
+      if (found != num || !set_cell_sizes (level, VERSION_SIZE + HEADER_SIZE, end)) goto done;
+    }
+
+  if (tile_size && !load_tiles (ccl, tile_block, tile_size)) goto done;
+
+  ccl->tile_block = (int32_t) tile_block;
+  ccl->tile_block_size = (int32_t) tile_size;
+  ccl->indexed = 1;
+  ok = 1;
+
+
+ done:
+  free (buf);
+
+  return (ok);
+}
+
+
+
+/*  Free the level headers and the quadtree table.  */
+
+static void unload_headers (CCL_FILE *ccl)
+{
+  int32_t           i;
+
+
+  for (i = 0 ; i <= CCL_MAX_LOD ; i++)
+    {
+      if (ccl->level[i].address != NULL) free (ccl->level[i].address);
+      memset (&ccl->level[i], 0, sizeof (CCL_LEVEL));
+    }
+
+  if (ccl->tile_address != NULL) free (ccl->tile_address);
+
+  ccl->tile_address = ccl->tile_size = NULL;
+  ccl->tile_threshold = ccl->tile_block = ccl->tile_block_size = 0;
+  ccl->num_levels = 0;
+}
+
+
+
+/*  Open a .ccl file, check the version block, and load the header (and the level of detail headers if there are any)
+    from the sparse index if use_index is set and there is one that matches the file, otherwise from the file.  */
+
+static CCL_FILE *open_file (const char *name, int32_t cache_cells, int32_t use_index)
+{
+  CCL_FILE          *ccl;
+  size_t            base_end;
+  int32_t           i, slots, major, end = 0;
+
+
+  if ((ccl = (CCL_FILE *) calloc (1, sizeof (CCL_FILE))) == NULL) return (NULL);
+
+  if (!load_file (ccl, name)) goto bad;
+
+
+  if (ccl->size < VERSION_SIZE + HEADER_SIZE || ccl->size > 0x7fffffff ||
+      strncmp ((const char *) ccl->data, CCL_VERSION_PREFIX, strlen (CCL_VERSION_PREFIX))) goto bad;
+
+  memcpy (ccl->version, ccl->data, VERSION_SIZE);
+  ccl->version[VERSION_SIZE - 1] = 0;
+
+
+  /*  V1.0 files have the bit packed records, V2.0 the compact ones.  We don't know what a later version looks like.  */
+
+  if (sscanf (ccl->version + strlen (CCL_VERSION_PREFIX), " V%d.%*d%n", &major, &end) != 1 || !end || major < 1 ||
+      major > CCL_COMPACT_MAJOR) goto bad;
+
+  ccl->compact = (major == CCL_COMPACT_MAJOR);
+
+
+  /*  Files from any other grid profile have a different header size and record field widths (see ccl_format.h).  */
+
+  if (strncmp (ccl->version + strlen (CCL_VERSION_PREFIX) + end, CCL_PROFILE_TAG " - ", strlen (CCL_PROFILE_TAG) + 3))
+    goto bad;
+
+  ccl->compressed = (strstr (ccl->version, "[CELL COMPRESSION] = " CCL_COMPRESSION_ZLIB) != NULL);
+
+  if (ccl->compressed && !ccl->compact) goto bad;
+
+
+  if (!use_index || !load_index (ccl, name))
+    {
+      unload_headers (ccl);
+
+
+      /*  The simplified levels are loaded into 1 and up so make room for level 0 first.  */
+
+      ccl->num_levels = 1;
+
+      if (!load_extensions (ccl, &base_end)) goto bad;
+
+      if (!load_level (ccl, &ccl->level[0], VERSION_SIZE, base_end)) goto bad;
+    }
+
+
+  ccl->cache_size = cache_cells > 0 ? cache_cells : CCL_DEFAULT_CACHE;
+  slots = ccl->num_levels * CELL_COUNT;
+
+  ccl->cache = (CCL_CELL *) calloc (ccl->cache_size, sizeof (CCL_CELL));
+  ccl->cache_cell = (int32_t *) malloc ((3 * (size_t) ccl->cache_size + slots) * sizeof (int32_t));
+  if (ccl->cache == NULL || ccl->cache_cell == NULL) goto bad;
+
+  ccl->cache_prev = ccl->cache_cell + ccl->cache_size;
+  ccl->cache_next = ccl->cache_prev + ccl->cache_size;
+  ccl->cache_slot = ccl->cache_next + ccl->cache_size;
+
+  for (i = 0 ; i < ccl->cache_size ; i++)
+    {
+      ccl->cache_cell[i] = -1;
+      ccl->cache_prev[i] = i - 1;
+      ccl->cache_next[i] = i + 1 < ccl->cache_size ? i + 1 : -1;
+    }
+
+  for (i = 0 ; i < slots ; i++) ccl->cache_slot[i] = -1;
+
+  ccl->cache_head = 0;
+  ccl->cache_tail = ccl->cache_size - 1;
+
+  return (ccl);
+
+
+ bad:
+  ccl_close (ccl);
+
+  return (NULL);
+}
+
+
+
+/*  Open a .ccl file.  The headers come from its sparse index (OUTPUT.cci, see ccl_format.h) if there is one that
+    matches the file, so opening only reads a few pages of the file and the cells are faulted in as they are decoded.
+    cache_cells is the number of decoded cells that ccl_get_cell keeps (0 for the default).  Returns NULL (with errno
+    set if it was a system error) if the file can't be read or isn't a .ccl file.  */
+
+CCL_FILE *ccl_open (const char *name, int32_t cache_cells)
+{
+  return (open_file (name, cache_cells, 1));
+}
+
+
+
+/*  Same as ccl_open but always loads the headers from the .ccl file, ignoring any index.  */
+
+CCL_FILE *ccl_open_headers (const char *name, int32_t cache_cells)
+{
+  return (open_file (name, cache_cells, 0));
+}
+
+
+
+void ccl_close (CCL_FILE *ccl)
+{
+  int32_t           i;
+
+
+  if (ccl == NULL) return;
+
+  unload_file (ccl);
+
+  unload_headers (ccl);
+
+  if (ccl->cache != NULL)
+    {
+      for (i = 0 ; i < ccl->cache_size ; i++)
+        {
+          if (ccl->cache[i].count != NULL) free (ccl->cache[i].count);
+          if (ccl->cache[i].lon != NULL) free (ccl->cache[i].lon);
+          if (ccl->cache[i].lat != NULL) free (ccl->cache[i].lat);
+        }
+
+      free (ccl->cache);
+    }
+
+  if (ccl->cache_cell != NULL) free (ccl->cache_cell);
+
+  free (ccl);
+}
+
+
+
+/*  Cell index for the cell that holds lat/lon (degrees, -90 up to 90 and -180 up to 180).  With the default one-degree
+    grid that is the cell whose southwest corner is at the integer degrees below lat/lon.  Returns -1 if it's outside
+    of the grid.  */
+
+int32_t ccl_cell_index (double lat, double lon)
+{
+  if (lat < -90.0 || lat >= 90.0 || lon < -180.0 || lon >= 180.0) return (-1);
+
+  return ((int32_t) floor ((lat + 90.0) * CELLS_PER_DEGREE) * CELL_COLS +
+          (int32_t) floor ((lon + 180.0) * CELLS_PER_DEGREE));
+}
+
+
+
+/*  Find the non-empty cells that overlap a west, south, east, north bounding box (degrees).  Up to max_cells cell
+    indices are put in cells (in header order).  Returns the total number of non-empty cells that overlap the box,
+    which may be more than max_cells.  */
+
+int32_t ccl_bbox_cells (const CCL_FILE *ccl, int32_t level, double west, double south, double east, double north,
+                        int32_t *cells, int32_t max_cells)
+{
+  int32_t           lon0, lon1, lat0, lat1, i, j, cell, num = 0;
+
+
+  if (level < 0 || level >= ccl->num_levels) return (0);
+
+  lon0 = (int32_t) floor ((west + 180.0) * CELLS_PER_DEGREE);
+  lon1 = (int32_t) ceil ((east + 180.0) * CELLS_PER_DEGREE) - 1;
+  lat0 = (int32_t) floor ((south + 90.0) * CELLS_PER_DEGREE);
+  lat1 = (int32_t) ceil ((north + 90.0) * CELLS_PER_DEGREE) - 1;
+
+  if (lon0 < 0) lon0 = 0;
+  if (lat0 < 0) lat0 = 0;
+  if (lon1 > CELL_COLS - 1) lon1 = CELL_COLS - 1;
+  if (lat1 > CELL_ROWS - 1) lat1 = CELL_ROWS - 1;
+  if (lon1 < lon0) lon1 = lon0;
+  if (lat1 < lat0) lat1 = lat0;
+
+  for (i = lat0 ; i <= lat1 ; i++)
+    {
+      for (j = lon0 ; j <= lon1 ; j++)
+        {
+          cell = i * CELL_COLS + j;
+
+          if (!ccl->level[level].num_segments[cell]) continue;
+
+          if (num < max_cells) cells[num] = cell;
+          num++;
+        }
+    }
+
+  return (num);
+}
+
+
+
+/*  Decode the V1.0 segment record at offset in a cell's records (base, size bytes).  The n vertices go either to xy
+    (interleaved fixed point lon/lat pairs, biased by 180/90 and scaled by POSITION_SCALE, the same values build_coast
+    packed) or to lon/lat in degrees, at most max_vertices of them.  Returns the size of the record in bytes, or 0 if
+    it is corrupt or doesn't fit.  */
+
+static size_t decode_packed_segment (const uint8_t *base, size_t size, size_t offset, int32_t *n, int32_t *xy,
+                                     double *lon, double *lat, int32_t max_vertices)
+{
+  BIT_READER        br;
+  int32_t           k, count_bits, lon_bits, lat_bits, pair_bits, bias_x, bias_y, x, y;
+  uint32_t          v, lat_mask;
+  size_t            record;
+
+
+  if (offset >= size) return (0);
+
+  bit_reader_init (&br, base + offset, size - offset);
+
+  count_bits = bit_reader_get (&br, COUNT_BITS_WIDTH);
+  lon_bits = bit_reader_get (&br, OFFSET_BITS_WIDTH);
+  lat_bits = bit_reader_get (&br, OFFSET_BITS_WIDTH);
+
+  if (!count_bits || !lon_bits || !lat_bits) return (0);
+
+  *n = (int32_t) bit_reader_get (&br, count_bits);
+  bias_x = (int32_t) bit_reader_get (&br, BIAS_WIDTH) - MAX_BIAS;
+  bias_y = (int32_t) bit_reader_get (&br, BIAS_WIDTH) - MAX_BIAS;
+  x = (int32_t) bit_reader_get (&br, START_LON_WIDTH);
+  y = (int32_t) bit_reader_get (&br, START_LAT_WIDTH);
+
+  if (*n < 1 || *n > max_vertices) return (0);
+
+  record = SEGMENT_RECORD_BYTES ((size_t) count_bits, (size_t) lon_bits, (size_t) lat_bits, (size_t) *n);
+  if (offset + record > size) return (0);
+
+  pair_bits = lon_bits + lat_bits;
+  lat_mask = (uint32_t) ((1ULL << lat_bits) - 1);
+
+  for (k = 0 ; k < *n ; k++)
+    {
+      if (k)
+        {
+          if (pair_bits <= 32)
+            {
+              v = bit_reader_get (&br, pair_bits);
+              x += (int32_t) (v >> lat_bits) - bias_x;
+              y += (int32_t) (v & lat_mask) - bias_y;
+            }
+          else
+            {
+              x += (int32_t) bit_reader_get (&br, lon_bits) - bias_x;
+              y += (int32_t) bit_reader_get (&br, lat_bits) - bias_y;
+            }
+        }
+
+      if (xy != NULL)
+        {
+          xy[2 * k] = x;
+          xy[2 * k + 1] = y;
+        }
+      else
+        {
+          lon[k] = (double) x / POSITION_SCALE - 180.0;
+          lat[k] = (double) y / POSITION_SCALE - 90.0;
+        }
+    }
+
+  return (record);
+}
+
+
+
+/*  Same as decode_packed_segment for a compact (V2.0) record in cell.  */
+
+static size_t decode_compact_segment (const uint8_t *base, size_t size, size_t offset, int32_t cell, int32_t *n,
+                                      int32_t *xy, double *lon, double *lat, int32_t max_vertices)
+{
+  const uint8_t     *ptr, *end = base + size;
+  uint32_t          v, dx, dy;
+  int32_t           k, x, y;
+
+
+  if (offset >= size) return (0);
+
+  ptr = base + offset;
+
+  if (!varint_get (&ptr, end, &v) || v < 1 || v > (uint32_t) max_vertices) return (0);
+  *n = (int32_t) v;
+
+  if (!varint_get (&ptr, end, &dx) || !varint_get (&ptr, end, &dy)) return (0);
+
+  x = (cell % CELL_COLS) * CELL_SPAN + zigzag_decode (dx);
+  y = (cell / CELL_COLS) * CELL_SPAN + zigzag_decode (dy);
+
+  for (k = 0 ; k < *n ; k++)
+    {
+      if (k)
+        {
+          if (!varint_get (&ptr, end, &dx) || !varint_get (&ptr, end, &dy)) return (0);
+
+          x += zigzag_decode (dx);
+          y += zigzag_decode (dy);
+        }
+
+      if (xy != NULL)
+        {
+          xy[2 * k] = x;
+          xy[2 * k + 1] = y;
+        }
+      else
+        {
+          lon[k] = (double) x / POSITION_SCALE - 180.0;
+          lat[k] = (double) y / POSITION_SCALE - 90.0;
+        }
+    }
+
+  return ((size_t) (ptr - (base + offset)));
+}
+
+
+
+static size_t decode_segment (const CCL_FILE *ccl, const uint8_t *base, size_t size, size_t offset, int32_t cell,
+                              int32_t *n, int32_t *xy, double *lon, double *lat, int32_t max_vertices)
+{
+  if (ccl->compact) return (decode_compact_segment (base, size, offset, cell, n, xy, lon, lat, max_vertices));
+
+  return (decode_packed_segment (base, size, offset, n, xy, lon, lat, max_vertices));
+}
+
+
+
+/*  The records of a cell at a level.  If the cells are zlib compressed they are uncompressed into *buffer (which the
+    caller frees, it's NULL otherwise).  Returns NULL (with size 0) for an empty cell or if the data is corrupt.  */
+
+static const uint8_t *cell_records (const CCL_FILE *ccl, const CCL_LEVEL *lv, int32_t cell, size_t *size, uint8_t **buffer)
+{
+  const uint8_t     *data = ccl->data + lv->address[cell];
+  size_t            stored = (size_t) lv->cell_size[cell];
+  uLongf            length;
+
+
+  *buffer = NULL;
+  *size = 0;
+
+  if (!stored) return (NULL);
+
+  if (!ccl->compressed)
+    {
+      *size = stored;
+      return (data);
+    }
+
+  if (stored < 4) return (NULL);
+
+  length = ((uLongf) data[0] << 24) | ((uLongf) data[1] << 16) | ((uLongf) data[2] << 8) | (uLongf) data[3];
+
+  if ((*buffer = (uint8_t *) malloc (length ? length : 1)) == NULL) return (NULL);
+
+  if (uncompress (*buffer, &length, data + 4, (uLong) (stored - 4)) != Z_OK)
+    {
+      free (*buffer);
+      *buffer = NULL;
+      return (NULL);
+    }
+
+  *size = (size_t) length;
+
+  return (*buffer);
+}
+
+
+
+/*  Decode all of the segments in a cell (see decode_segment for xy, lon, and lat).  Returns the number of segments, or
+    -1 if the cell number is bad, the buffers are too small, or the cell records are corrupt.  */
+
+static int32_t decode_cell (const CCL_FILE *ccl, int32_t level, int32_t cell, int32_t *count, int32_t max_segments,
+                            int32_t *xy, double *lon, double *lat, int32_t max_vertices)
+{
+  const CCL_LEVEL   *lv;
+  const uint8_t     *base;
+  uint8_t           *buffer;
+  size_t            offset, size, record;
+  int32_t           i, nv;
+
+
+  if (cell < 0 || cell >= CELL_COUNT || level < 0 || level >= ccl->num_levels) return (-1);
+
+  lv = &ccl->level[level];
+
+  if (lv->num_segments[cell] > max_segments || lv->num_vertices[cell] > max_vertices) return (-1);
+
+  if (!lv->num_segments[cell]) return (0);
+
+  if ((base = cell_records (ccl, lv, cell, &size, &buffer)) == NULL) return (-1);
+
+  offset = 0;
+  nv = 0;
+
+  for (i = 0 ; i < lv->num_segments[cell] ; i++)
+    {
+      record = decode_segment (ccl, base, size, offset, cell, &count[i], xy != NULL ? &xy[2 * nv] : NULL,
+                               xy != NULL ? NULL : &lon[nv], xy != NULL ? NULL : &lat[nv], max_vertices - nv);
+      if (!record) break;
+
+      nv += count[i];
+      offset += record;
+    }
+
+  if (buffer != NULL) free (buffer);
+
+  if (i < lv->num_segments[cell] || nv != lv->num_vertices[cell]) return (-1);
+
+  return (lv->num_segments[cell]);
+}
+
+
+
+/*  Decode a cell into caller supplied buffers.  count needs room for the cell's num_segments entries and lon/lat for
+    its num_vertices entries (from the level header arrays).  The vertex positions are in degrees.  */
+
+int32_t ccl_decode_cell (const CCL_FILE *ccl, int32_t level, int32_t cell, int32_t *count, int32_t max_segments,
+                         double *lon, double *lat, int32_t max_vertices)
+{
+  return (decode_cell (ccl, level, cell, count, max_segments, NULL, lon, lat, max_vertices));
+}
+
+
+
+/*  Same as ccl_decode_cell but the vertices are left as the stored fixed point values (2 * num_vertices entries in
+    xy, interleaved lon/lat).  */
+
+int32_t ccl_decode_cell_fixed (const CCL_FILE *ccl, int32_t level, int32_t cell, int32_t *count, int32_t max_segments,
+                               int32_t *xy, int32_t max_vertices)
+{
+  return (decode_cell (ccl, level, cell, count, max_segments, xy, NULL, NULL, max_vertices));
+}
+
+
+
+/*  Collect the segment record offsets from the leaves of the quadtree node at *pos (covering west to east and south
+    to north in fixed point) that overlap the query box (x0, y0, x1, y1).  Returns 0 if the tree is corrupt.  */
+
+static int32_t tile_offsets (const uint8_t *tree, size_t size, size_t *pos, int32_t west, int32_t south, int32_t east,
+                             int32_t north, const int32_t *query, int32_t depth, int32_t **offsets, int32_t *num,
+                             int32_t *alloc)
+{
+  BIT_READER        br;
+  uint32_t          node, n, i;
+  int32_t           q, *new_offsets;
+  uint8_t           hit;
+
+
+  if (*pos + 4 > size) return (0);
+
+  bit_reader_init (&br, tree + *pos, size - *pos);
+  node = bit_reader_get (&br, 32);
+  *pos += 4;
+
+  if (node == CCL_TILE_SPLIT)
+    {
+      if (depth == CCL_TILE_MAX_DEPTH) return (0);
+
+      for (q = 0 ; q < 4 ; q++)
+        {
+          if (!tile_offsets (tree, size, pos, (q & 1) ? (west + east) / 2 : west, (q & 2) ? (south + north) / 2 : south,
+                             (q & 1) ? east : (west + east) / 2, (q & 2) ? north : (south + north) / 2, query, depth + 1,
+                             offsets, num, alloc)) return (0);
+        }
+
+      return (1);
+    }
+
+
+  n = node;
+  if (*pos + 4 * (size_t) n > size) return (0);
+
+  hit = query[0] <= east && query[2] >= west && query[1] <= north && query[3] >= south;
+
+  if (hit)
+    {
+      if (*num + (int32_t) n > *alloc)
+        {
+          *alloc = (*num + (int32_t) n) * 2;
+          if ((new_offsets = (int32_t *) realloc (*offsets, (size_t) *alloc * sizeof (int32_t))) == NULL) return (0);
+          *offsets = new_offsets;
+        }
+
+      for (i = 0 ; i < n ; i++) (*offsets)[(*num)++] = (int32_t) bit_reader_get (&br, 32);
+    }
+
+  *pos += 4 * (size_t) n;
+
+  return (1);
+}
+
+
+
+static int offset_compare (const void *a, const void *b)
+{
+  int32_t           x = *(const int32_t *) a, y = *(const int32_t *) b;
+
+  return (x < y ? -1 : x > y);
+}
+
+
+
+/*  Decode the full resolution segments of a cell that might overlap a west, south, east, north box (degrees).  If the
+    cell has a quadtree (CCL_TAG_TILE) only the segments listed in the leaves that overlap the box are decoded,
+    otherwise this is the same as ccl_decode_cell.  Either way some of the segments may not actually touch the box.
+    The buffers are the same as for ccl_decode_cell and the segments are in the same order.  Returns the number of
+    segments decoded (their vertices are back to back in lon/lat), or -1 on error.  */
+
+int32_t ccl_decode_window (const CCL_FILE *ccl, int32_t cell, double west, double south, double east, double north,
+                           int32_t *count, int32_t max_segments, double *lon, double *lat, int32_t max_vertices)
+{
+  const CCL_LEVEL   *lv = &ccl->level[0];
+  const uint8_t     *base;
+  uint8_t           *buffer;
+  size_t            pos, record, size;
+  int32_t           i, num, alloc, nv, ns, cell_west, cell_south, query[4], *offsets;
+
+
+  if (cell < 0 || cell >= CELL_COUNT) return (-1);
+
+  if (ccl->tile_address == NULL || !ccl->tile_size[cell])
+    return (decode_cell (ccl, 0, cell, count, max_segments, NULL, lon, lat, max_vertices));
+
+
+  query[0] = (int32_t) floor ((west + 180.0) * POSITION_SCALE);
+  query[1] = (int32_t) floor ((south + 90.0) * POSITION_SCALE);
+  query[2] = (int32_t) ceil ((east + 180.0) * POSITION_SCALE);
+  query[3] = (int32_t) ceil ((north + 90.0) * POSITION_SCALE);
+
+  cell_west = (cell % CELL_COLS) * CELL_SPAN;
+  cell_south = (cell / CELL_COLS) * CELL_SPAN;
+
+  offsets = NULL;
+  num = alloc = 0;
+  pos = 0;
+
+  if (!tile_offsets (ccl->data + ccl->tile_address[cell], (size_t) ccl->tile_size[cell], &pos, cell_west, cell_south,
+                     cell_west + CELL_SPAN, cell_south + CELL_SPAN, query, 0, &offsets, &num,
+                     &alloc))
+    {
+      free (offsets);
+      return (-1);
+    }
+
+
+  /*  Segments that cross more than one leaf are listed in each of them.  */
+
+  qsort (offsets, num, sizeof (int32_t), offset_compare);
+
+  if ((base = cell_records (ccl, lv, cell, &size, &buffer)) == NULL)
+    {
+      free (offsets);
+      return (-1);
+    }
+
+  nv = 0;
+  ns = 0;
+
+  for (i = 0 ; i < num ; i++)
+    {
+      if (i && offsets[i] == offsets[i - 1]) continue;
+
+      if (ns == max_segments ||
+          !(record = decode_segment (ccl, base, size, (size_t) offsets[i], cell, &count[ns], NULL, &lon[nv], &lat[nv],
+                                     max_vertices - nv)))
+        {
+          ns = -1;
+          break;
+        }
+
+      nv += count[ns];
+      ns++;
+    }
+
+  if (buffer != NULL) free (buffer);
+  free (offsets);
+
+  return (ns);
+}
+
+
+
+/*  Move a cache slot to the head (most recently used end) of the list.  */
+
+static void cache_touch (CCL_FILE *ccl, int32_t slot)
+{
+  if (ccl->cache_head == slot) return;
+
+  if (ccl->cache_prev[slot] >= 0) ccl->cache_next[ccl->cache_prev[slot]] = ccl->cache_next[slot];
+  if (ccl->cache_next[slot] >= 0) ccl->cache_prev[ccl->cache_next[slot]] = ccl->cache_prev[slot];
+  if (ccl->cache_tail == slot) ccl->cache_tail = ccl->cache_prev[slot];
+
+  ccl->cache_prev[slot] = -1;
+  ccl->cache_next[slot] = ccl->cache_head;
+  ccl->cache_prev[ccl->cache_head] = slot;
+  ccl->cache_head = slot;
+}
+
+
+
+/*  Get a decoded cell through the cache.  The least recently used cell is dropped when the cache is full.  The returned
+    cell stays valid until cache_size other cells have been requested (or the file is closed).  Returns NULL if the
+    cell can't be decoded.  */
+
+const CCL_CELL *ccl_get_cell (CCL_FILE *ccl, int32_t level, int32_t cell)
+{
+  CCL_CELL          *cl;
+  int32_t           slot, ns, nv, key;
+
+
+  if (cell < 0 || cell >= CELL_COUNT || level < 0 || level >= ccl->num_levels) return (NULL);
+
+  key = level * CELL_COUNT + cell;
+
+  if ((slot = ccl->cache_slot[key]) >= 0)
+    {
+      ccl->cache_hits++;
+      cache_touch (ccl, slot);
+      return (&ccl->cache[slot]);
+    }
+
+  ccl->cache_misses++;
+
+
+  /*  Reuse the least recently used slot.  */
+
+  slot = ccl->cache_tail;
+  cl = &ccl->cache[slot];
+
+  if (ccl->cache_cell[slot] >= 0) ccl->cache_slot[ccl->cache_cell[slot]] = -1;
+  ccl->cache_cell[slot] = -1;
+
+  ns = ccl->level[level].num_segments[cell];
+  nv = ccl->level[level].num_vertices[cell];
+
+  if (ns > cl->segment_alloc)
+    {
+      free (cl->count);
+      cl->segment_alloc = 0;
+      if ((cl->count = (int32_t *) malloc ((size_t) ns * sizeof (int32_t))) == NULL) return (NULL);
+      cl->segment_alloc = ns;
+    }
+
+  if (nv > cl->vertex_alloc)
+    {
+      free (cl->lon);
+      free (cl->lat);
+      cl->vertex_alloc = 0;
+      cl->lon = (double *) malloc ((size_t) nv * sizeof (double));
+      cl->lat = (double *) malloc ((size_t) nv * sizeof (double));
+      if (cl->lon == NULL || cl->lat == NULL) return (NULL);
+      cl->vertex_alloc = nv;
+    }
+
+  if (decode_cell (ccl, level, cell, cl->count, cl->segment_alloc, NULL, cl->lon, cl->lat, cl->vertex_alloc) < 0)
+    return (NULL);
+
+  cl->num_segments = ns;
+  cl->num_vertices = nv;
+
+  ccl->cache_cell[slot] = key;
+  ccl->cache_slot[key] = slot;
+  cache_touch (ccl, slot);
+
+  return (cl);
+}
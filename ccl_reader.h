@@ -0,0 +1,137 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __CCL_READER_H__
+#define __CCL_READER_H__
+
+#ifndef _FILE_OFFSET_BITS
+#define         _FILE_OFFSET_BITS   64
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "ccl_format.h"
+
+
+/*  Random access reader for .ccl files.  The whole file is memory mapped (or read into memory on Windows) and the
+    header is loaded when the file is opened, after that any cell can be decoded without touching the rest of the
+    file.  This only depends on ccl_format.h, bit_reader.h, and varint.h (and the C library and zlib) so it can be
+    dropped into other programs such as the display and clipping tools.  Both the V1.0 (bit packed) and V2.0
+    (compact) record formats are read.  Only files built with the same grid profile (CCL_GRID and CCL_SCALE in
+    ccl_format.h) as the reader can be opened.  If the file has a sparse index (OUTPUT.cci, see ccl_format.h) the
+    headers are loaded from that instead so opening a file only reads a few pages of it.
+
+    Cells are given by index (see ccl_cell_index) in the same order as the header, that is, latdeg * CELL_COLS +
+    londeg with latdeg 0 to 179 (-90 to 89) and londeg 0 to 359 (-180 to 179) for the default one-degree grid.  Every
+    call also takes the level of detail, 0 being the full resolution data (the only level in a plain file).
+
+    ccl_decode_cell, ccl_decode_cell_fixed, and ccl_decode_window don't modify the CCL_FILE so they can be called from
+    several threads at once.  ccl_get_cell goes through the decoded cell cache so it must not be.  */
+
+
+/*  A decoded cell.  The vertices for segment i follow those of segments 0 through i - 1.  */
+
+typedef struct
+{
+  int32_t       num_segments;           /*  Number of segments in the cell  */
+  int32_t       num_vertices;           /*  Total number of vertices in the cell  */
+  int32_t       *count;                 /*  Number of vertices in each segment  */
+  double        *lon;                   /*  Vertex longitudes (degrees)  */
+  double        *lat;                   /*  Vertex latitudes (degrees)  */
+  int32_t       segment_alloc;          /*  Number of entries allocated in count  */
+  int32_t       vertex_alloc;           /*  Number of entries allocated in lon and lat  */
+} CCL_CELL;
+
+
+/*  The header of one level of detail.  Level 0 is the full resolution data, levels 1 and up are the simplified
+    levels from the CCL_TAG_LOD extension blocks (if there are any).  */
+
+typedef struct
+{
+  int32_t       tolerance;              /*  Simplification tolerance (POSITION_SCALE units, 0 for level 0)  */
+  int32_t       *address;               /*  CELL_COUNT cell record addresses (0 for empty cells)  */
+  int32_t       *cell_size;             /*  CELL_COUNT cell record sizes in bytes  */
+  int32_t       *num_segments;          /*  CELL_COUNT segment counts  */
+  int32_t       *num_vertices;          /*  CELL_COUNT vertex counts  */
+} CCL_LEVEL;
+
+
+typedef struct
+{
+  const uint8_t *data;                  /*  The whole file  */
+  size_t        size;                   /*  Size of the file in bytes  */
+  int32_t       mapped;                 /*  1 if data is memory mapped, 0 if it was read into memory  */
+  char          version[VERSION_SIZE];  /*  Version block (NUL terminated)  */
+  int32_t       compact;                /*  1 for compact (V2.0) segment records, 0 for bit packed (V1.0)  */
+  int32_t       compressed;             /*  1 if the compact records of each cell are zlib compressed  */
+  int32_t       num_levels;             /*  Number of levels of detail (1 + number of simplified levels)  */
+  CCL_LEVEL     level[1 + CCL_MAX_LOD];
+  int32_t       tile_threshold;         /*  Vertex count over which cells have a quadtree (CCL_TAG_TILE), 0 for none  */
+  int32_t       *tile_address;          /*  CELL_COUNT quadtree addresses or NULL if there is no CCL_TAG_TILE block  */
+  int32_t       *tile_size;             /*  CELL_COUNT quadtree sizes in bytes (0 for cells without one)  */
+  int32_t       tile_block;             /*  Address and size of the CCL_TAG_TILE block (0 if there isn't one)  */
+  int32_t       tile_block_size;
+  int32_t       indexed;                /*  1 if the headers were loaded from the sparse index (see ccl_open)  */
+
+
+  /*  Least recently used cache of decoded cells for ccl_get_cell.  The slots are kept in a doubly linked list with
+      the most recently used at the head.  */
+
+  int32_t       cache_size;             /*  Number of cache slots  */
+  CCL_CELL      *cache;                 /*  Decoded cell for each slot  */
+  int32_t       *cache_cell;            /*  level * CELL_COUNT + cell held in each slot (-1 if unused)  */
+  int32_t       *cache_prev;            /*  Previous (more recently used) slot or -1  */
+  int32_t       *cache_next;            /*  Next (less recently used) slot or -1  */
+  int32_t       *cache_slot;            /*  num_levels * CELL_COUNT slot holding each level/cell (-1 if not cached)  */
+  int32_t       cache_head;
+  int32_t       cache_tail;
+  int32_t       cache_hits;
+  int32_t       cache_misses;
+} CCL_FILE;
+
+
+/*  Default number of decoded cells kept by ccl_get_cell.  */
+
+#define         CCL_DEFAULT_CACHE   64
+
+
+CCL_FILE *ccl_open (const char *name, int32_t cache_cells);
+CCL_FILE *ccl_open_headers (const char *name, int32_t cache_cells);
+void ccl_index_name (const char *name, char *index_name, size_t size);
+void ccl_close (CCL_FILE *ccl);
+int32_t ccl_cell_index (double lat, double lon);
+int32_t ccl_bbox_cells (const CCL_FILE *ccl, int32_t level, double west, double south, double east, double north,
+                        int32_t *cells, int32_t max_cells);
+int32_t ccl_decode_cell (const CCL_FILE *ccl, int32_t level, int32_t cell, int32_t *count, int32_t max_segments,
+                         double *lon, double *lat, int32_t max_vertices);
+int32_t ccl_decode_cell_fixed (const CCL_FILE *ccl, int32_t level, int32_t cell, int32_t *count, int32_t max_segments,
+                               int32_t *xy, int32_t max_vertices);
+int32_t ccl_decode_window (const CCL_FILE *ccl, int32_t cell, double west, double south, double east, double north,
+                           int32_t *count, int32_t max_segments, double *lon, double *lat, int32_t max_vertices);
+const CCL_CELL *ccl_get_cell (CCL_FILE *ccl, int32_t level, int32_t cell);
+
+
+#endif
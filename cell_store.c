@@ -0,0 +1,727 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "cell_store.h"
+
+#ifdef NVWIN3X
+struct iovec
+{
+  void          *iov_base;
+  size_t        iov_len;
+};
+#else
+#include <sys/uio.h>
+#endif
+
+
+/*  Maximum number of buffers we hand to one pwritev call when spilling.  */
+
+#define         SPILL_IOV           512
+
+
+/*  Zeros used to pad out the last chunk of each cell's run in a spill so that the runs are contiguous in the file.  */
+
+static const uint8_t chunk_pad[CHUNK_SIZE];
+
+
+/*  Write len bytes to the scratch file at offset.  */
+
+static void scratch_write (CELL_STORE *store, int64_t offset, void *buf, size_t len)
+{
+  store->scratch_written += len;
+
+#ifdef NVWIN3X
+  if (fseeko64 (store->scratch, offset, SEEK_SET) || fwrite (buf, 1, len, store->scratch) != len)
+    {
+      perror ("Writing scratch file");
+      exit (-1);
+    }
+#else
+  uint8_t           *ptr = (uint8_t *) buf;
+  ssize_t           n;
+
+
+  while (len)
+    {
+      n = pwrite (fileno (store->scratch), ptr, len, (off_t) offset);
+
+      if (n < 0)
+        {
+          if (errno == EINTR) continue;
+
+          perror ("Writing scratch file");
+          exit (-1);
+        }
+
+      ptr += n;
+      offset += n;
+      len -= n;
+    }
+#endif
+}
+
+
+
+/*  Write a list of buffers to consecutive locations in the scratch file starting at offset.  The iov array is modified
+    if we get a short write.  */
+
+static void scratch_writev (CELL_STORE *store, int64_t offset, struct iovec *iov, int32_t niov)
+{
+#ifdef NVWIN3X
+  int32_t           i;
+
+
+  for (i = 0 ; i < niov ; i++)
+    {
+      scratch_write (store, offset, iov[i].iov_base, iov[i].iov_len);
+      offset += iov[i].iov_len;
+    }
+#else
+  ssize_t           n;
+
+
+  while (niov)
+    {
+      n = pwritev (fileno (store->scratch), iov, niov, (off_t) offset);
+
+      if (n < 0)
+        {
+          if (errno == EINTR) continue;
+
+          perror ("Writing scratch file");
+          exit (-1);
+        }
+
+      offset += n;
+      store->scratch_written += n;
+
+      while (niov && (size_t) n >= iov->iov_len)
+        {
+          n -= iov->iov_len;
+          iov++;
+          niov--;
+        }
+
+      if (niov)
+        {
+          iov->iov_base = (uint8_t *) iov->iov_base + n;
+          iov->iov_len -= n;
+        }
+    }
+#endif
+}
+
+
+
+/*  Read len bytes from the scratch file at offset.  */
+
+static void scratch_read (CELL_STORE *store, int64_t offset, void *buf, size_t len)
+{
+#ifdef NVWIN3X
+  pthread_mutex_lock (&store->mutex);
+
+  if (fseeko64 (store->scratch, offset, SEEK_SET) || fread (buf, 1, len, store->scratch) != len)
+    {
+      fprintf (stderr, "Bad return in file %s, function %s at line %d.  This should never happen!", __FILE__, __FUNCTION__, __LINE__ - 2);
+      fflush (stderr);
+      exit (-1);
+    }
+
+  pthread_mutex_unlock (&store->mutex);
+#else
+  uint8_t           *ptr = (uint8_t *) buf;
+  ssize_t           n;
+
+
+  while (len)
+    {
+      n = pread (fileno (store->scratch), ptr, len, (off_t) offset);
+
+      if (n <= 0)
+        {
+          if (n < 0 && errno == EINTR) continue;
+
+          fprintf (stderr, "Bad return in file %s, function %s at line %d.  This should never happen!", __FILE__, __FUNCTION__, __LINE__ - 4);
+          fflush (stderr);
+          exit (-1);
+        }
+
+      ptr += n;
+      offset += n;
+      len -= n;
+    }
+#endif
+}
+
+
+
+/*  Allocate num consecutive chunks at the end of the scratch file and return the index of the first one.  The scratch
+    file is created on first use and grown CHUNK_EXTENT chunks at a time.  */
+
+static int32_t scratch_alloc (CELL_STORE *store, int32_t num)
+{
+  int32_t           first, i;
+
+
+  if (store->scratch == NULL)
+    {
+      if ((store->scratch = tmpfile ()) == NULL)
+        {
+          perror ("Opening scratch file");
+          exit (-1);
+        }
+    }
+
+
+  if (store->num_chunks + num > store->alloc_chunks)
+    {
+      int32_t new_alloc = store->alloc_chunks + MAX (num, CHUNK_EXTENT);
+
+      store->chunk_next = (int32_t *) realloc (store->chunk_next, new_alloc * sizeof (int32_t));
+      if (store->chunk_next == NULL)
+        {
+          perror ("Allocating chunk chain memory");
+          exit (-1);
+        }
+
+
+#ifdef NVLinux
+      /*  Reserve the space up front so the filesystem can give us contiguous extents.  If it isn't supported we'll just
+          grow the file as we write.  */
+
+      posix_fallocate (fileno (store->scratch), (off_t) store->alloc_chunks * CHUNK_SIZE,
+                       (off_t) (new_alloc - store->alloc_chunks) * CHUNK_SIZE);
+#endif
+
+      store->alloc_chunks = new_alloc;
+    }
+
+
+  first = store->num_chunks;
+
+  for (i = first ; i < first + num ; i++) store->chunk_next[i] = -1;
+
+  store->num_chunks += num;
+
+  return (first);
+}
+
+
+
+/*  Spill every bucket that has data in memory to the scratch file.  Each bucket's partially filled last chunk is topped
+    off first.  The rest of every bucket goes into new consecutive chunks at the end of the file, and since those runs
+    are allocated one after the other (the last chunk of each run padded out with zeros) the whole lot is written with
+    a few large pwritev calls instead of one write per cell.  */
+
+static void cell_store_spill (CELL_STORE *store)
+{
+  CELL_BUCKET       *bucket;
+  struct iovec      iov[SPILL_IOV];
+  int32_t           i, first, num, k, niov = 0;
+  int64_t           batch_offset = 0;
+  size_t            left, n, skip;
+
+
+  for (i = 0 ; i < store->num_dirty ; i++)
+    {
+      bucket = &store->bucket[store->dirty[i]];
+      left = bucket->count;
+      skip = 0;
+
+
+      if (bucket->last_chunk >= 0 && bucket->last_used < CHUNK_INTS)
+        {
+          n = MIN (left, (size_t) (CHUNK_INTS - bucket->last_used));
+
+          scratch_write (store, (int64_t) bucket->last_chunk * CHUNK_SIZE + bucket->last_used * sizeof (int32_t),
+                         bucket->data, n * sizeof (int32_t));
+
+          bucket->last_used += n;
+          skip = n;
+          left -= n;
+        }
+
+
+      if (left)
+        {
+          if (niov > SPILL_IOV - 2)
+            {
+              scratch_writev (store, batch_offset, iov, niov);
+              niov = 0;
+            }
+
+          num = (int32_t) ((left + CHUNK_INTS - 1) / CHUNK_INTS);
+
+          first = scratch_alloc (store, num);
+
+          if (!niov) batch_offset = (int64_t) first * CHUNK_SIZE;
+
+          for (k = first ; k < first + num - 1 ; k++) store->chunk_next[k] = k + 1;
+
+          if (bucket->last_chunk >= 0)
+            {
+              store->chunk_next[bucket->last_chunk] = first;
+            }
+          else
+            {
+              bucket->first_chunk = first;
+            }
+
+          bucket->last_chunk = first + num - 1;
+          bucket->last_used = (int32_t) (left - (size_t) (num - 1) * CHUNK_INTS);
+
+
+          iov[niov].iov_base = &bucket->data[skip];
+          iov[niov++].iov_len = left * sizeof (int32_t);
+
+          if (bucket->last_used < CHUNK_INTS)
+            {
+              iov[niov].iov_base = (void *) chunk_pad;
+              iov[niov++].iov_len = (CHUNK_INTS - bucket->last_used) * sizeof (int32_t);
+            }
+        }
+
+      bucket->spilled += bucket->count;
+    }
+
+
+  if (niov) scratch_writev (store, batch_offset, iov, niov);
+
+
+  /*  Now that everything is on disk we can free the memory.  */
+
+  for (i = 0 ; i < store->num_dirty ; i++)
+    {
+      bucket = &store->bucket[store->dirty[i]];
+
+      free (bucket->data);
+      bucket->data = NULL;
+      bucket->count = bucket->size = 0;
+    }
+
+  store->num_dirty = 0;
+  store->bytes = 0;
+  store->spills++;
+}
+
+
+
+void cell_store_init (CELL_STORE *store, size_t budget)
+{
+  int32_t           i;
+
+
+  store->bucket = (CELL_BUCKET *) calloc (CELL_COUNT, sizeof (CELL_BUCKET));
+  if (store->bucket == NULL)
+    {
+      perror ("Allocating cell store memory");
+      exit (-1);
+    }
+
+  store->dirty = (int32_t *) malloc (CELL_COUNT * sizeof (int32_t));
+  if (store->dirty == NULL)
+    {
+      perror ("Allocating cell store memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < CELL_COUNT ; i++) store->bucket[i].first_chunk = store->bucket[i].last_chunk = -1;
+
+  store->num_dirty = 0;
+
+  store->bytes = 0;
+  store->budget = budget;
+  store->spills = 0;
+  store->scratch_written = 0;
+  store->scratch_read = 0;
+  store->scratch = NULL;
+  store->num_chunks = 0;
+  store->alloc_chunks = 0;
+  store->chunk_next = NULL;
+  store->filter = NULL;
+  store->file_start = NULL;
+  store->num_files = 0;
+  store->marked = 0;
+
+  pthread_mutex_init (&store->mutex, NULL);
+}
+
+
+
+/*  Make room for count more int32_t values at the end of a bucket and return a pointer to them.  */
+
+static int32_t *bucket_reserve (CELL_STORE *store, int32_t cell, size_t count)
+{
+  CELL_BUCKET       *bucket = &store->bucket[cell];
+  size_t            needed;
+  int32_t           *ptr;
+
+
+  if (!bucket->count) store->dirty[store->num_dirty++] = cell;
+
+  needed = bucket->count + count;
+
+
+  /*  Grow geometrically so that we're not reallocating for every segment.  */
+
+  if (needed > bucket->size)
+    {
+      size_t new_size = bucket->size ? bucket->size : 64;
+
+      while (new_size < needed) new_size *= 2;
+
+      bucket->data = (int32_t *) realloc (bucket->data, new_size * sizeof (int32_t));
+      if (bucket->data == NULL)
+        {
+          perror ("Allocating cell bucket memory");
+          exit (-1);
+        }
+
+      store->bytes += (new_size - bucket->size) * sizeof (int32_t);
+      bucket->size = new_size;
+    }
+
+
+  ptr = &bucket->data[bucket->count];
+
+  bucket->count = needed;
+
+  return (ptr);
+}
+
+
+
+/*  Append a segment record (the vertex count followed by that many lon/lat pairs) to the bucket for the londeg/latdeg
+    cell.  Empty segments and cells outside of the CELL_ROWS X CELL_COLS grid are discarded (pass 2 never looked at
+    either of them when they were written to cell files).  */
+
+void cell_store_add (CELL_STORE *store, int32_t londeg, int32_t latdeg, const int32_t *record)
+{
+  size_t            count;
+
+
+  if (record[0] <= 0 || londeg < 0 || londeg >= CELL_COLS || latdeg < 0 || latdeg >= CELL_ROWS) return;
+
+  if (store->filter != NULL && !store->filter[latdeg * CELL_COLS + londeg]) return;
+
+  count = 1 + 2 * (size_t) record[0];
+
+  memcpy (bucket_reserve (store, latdeg * CELL_COLS + londeg, count), record, count * sizeof (int32_t));
+
+
+  if (store->bytes > store->budget) cell_store_spill (store);
+}
+
+
+
+/*  Append everything in src (which must not have spilled) to the end of the matching buckets in store.  Used to merge
+    the task local stores from the ingest threads.  Each cell's records are copied in one piece so the segment order is
+    preserved.  */
+
+void cell_store_merge (CELL_STORE *store, CELL_STORE *src)
+{
+  CELL_BUCKET       *bucket;
+  int32_t           i, cell;
+
+
+  for (i = 0 ; i < src->num_dirty ; i++)
+    {
+      cell = src->dirty[i];
+      bucket = &src->bucket[cell];
+
+      if (!bucket->count) continue;
+
+      memcpy (bucket_reserve (store, cell, bucket->count), bucket->data, bucket->count * sizeof (int32_t));
+
+      if (store->bytes > store->budget) cell_store_spill (store);
+    }
+}
+
+
+
+/*  Free everything held in memory by a store that hasn't spilled (after it has been merged) so it can be filled
+    again.  */
+
+void cell_store_empty (CELL_STORE *store)
+{
+  CELL_BUCKET       *bucket;
+  int32_t           i;
+
+
+  for (i = 0 ; i < store->num_dirty ; i++)
+    {
+      bucket = &store->bucket[store->dirty[i]];
+
+      free (bucket->data);
+      bucket->data = NULL;
+      bucket->count = bucket->size = 0;
+    }
+
+  store->num_dirty = 0;
+  store->bytes = 0;
+}
+
+
+
+/*  Read the spilled part of a bucket (its chunk chain) into data.  Runs of consecutive chunks are read with a single
+    call.  */
+
+static void read_spilled (CELL_STORE *store, CELL_BUCKET *bucket, int32_t *data)
+{
+  int32_t           chunk, run_start, run_length;
+  size_t            pos, n;
+
+
+  pos = 0;
+  chunk = bucket->first_chunk;
+
+  while (chunk >= 0)
+    {
+      run_start = chunk;
+      run_length = 1;
+
+      while (store->chunk_next[chunk] == chunk + 1)
+        {
+          chunk++;
+          run_length++;
+        }
+
+
+      /*  Every chunk but the last one in the chain is full.  */
+
+      n = MIN ((size_t) run_length * CHUNK_INTS, bucket->spilled - pos);
+
+      scratch_read (store, (int64_t) run_start * CHUNK_SIZE, &data[pos], n * sizeof (int32_t));
+
+      pos += n;
+      chunk = store->chunk_next[chunk];
+    }
+}
+
+
+
+/*  Get all of the segment records for a cell.  If part of the cell was spilled we read its chunk chain back in front of
+    whatever is still in memory (so the segment order is unchanged).  Runs of consecutive chunks are read with a single
+    call.  Returns NULL if the cell is empty.  */
+
+int32_t *cell_store_load (CELL_STORE *store, int32_t cell, size_t *count)
+{
+  CELL_BUCKET       *bucket = &store->bucket[cell];
+  int32_t           *data;
+
+
+  if (bucket->spilled)
+    {
+      data = (int32_t *) malloc ((bucket->spilled + bucket->count) * sizeof (int32_t));
+      if (data == NULL)
+        {
+          perror ("Allocating cell bucket memory");
+          exit (-1);
+        }
+
+
+      read_spilled (store, bucket, data);
+
+
+      if (bucket->count) memcpy (&data[bucket->spilled], bucket->data, bucket->count * sizeof (int32_t));
+
+      free (bucket->data);
+
+      pthread_mutex_lock (&store->mutex);
+      store->bytes -= bucket->size * sizeof (int32_t);
+      store->bytes += (bucket->count + bucket->spilled) * sizeof (int32_t);
+      store->scratch_read += bucket->spilled * sizeof (int32_t);
+      pthread_mutex_unlock (&store->mutex);
+
+      bucket->count += bucket->spilled;
+      bucket->size = bucket->count;
+      bucket->data = data;
+      bucket->spilled = 0;
+      bucket->first_chunk = bucket->last_chunk = -1;
+    }
+
+
+  *count = bucket->count;
+
+  if (!bucket->count) return (NULL);
+
+  return (bucket->data);
+}
+
+
+
+/*  Start keeping track of where the records of each of num_files input files start in every cell (--job).  The files
+    have to be merged in order and cell_store_mark_file called as each one starts.  */
+
+void cell_store_track_files (CELL_STORE *store, int32_t num_files)
+{
+  store->num_files = num_files;
+  store->marked = 0;
+
+  if ((store->file_start = (size_t *) calloc ((size_t) (num_files + 1) * CELL_COUNT, sizeof (size_t))) == NULL)
+    {
+      perror ("Allocating cell store memory");
+      exit (-1);
+    }
+}
+
+
+
+/*  Everything that is added to the store from now on comes from input file number file (or later).  Files that were
+    skipped in between get no records.  Marking num_files closes the last file.  */
+
+void cell_store_mark_file (CELL_STORE *store, int32_t file)
+{
+  CELL_BUCKET       *bucket;
+  int32_t           cell;
+
+
+  if (store->file_start == NULL) return;
+
+  for ( ; store->marked <= file && store->marked <= store->num_files ; store->marked++)
+    {
+      for (cell = 0 ; cell < CELL_COUNT ; cell++)
+        {
+          bucket = &store->bucket[cell];
+          store->file_start[(size_t) store->marked * CELL_COUNT + cell] = bucket->spilled + bucket->count;
+        }
+    }
+}
+
+
+
+/*  Copy the segment records for a cell that came from the input files flagged in inputs (num_files flags, NULL for
+    all of them) into a new buffer (the caller frees it).  The store isn't changed so the cell can be selected again
+    for another output.  Like cell_store_load this can be called from several threads at once.  Returns NULL if there
+    are no records.  */
+
+int32_t *cell_store_select (CELL_STORE *store, int32_t cell, const uint8_t *inputs, size_t *count)
+{
+  CELL_BUCKET       *bucket = &store->bucket[cell];
+  const size_t      *start = store->file_start;
+  int32_t           *data;
+  size_t            total = bucket->spilled + bucket->count, pos, first, end;
+  int32_t           f;
+
+
+  *count = 0;
+
+  if (!total) return (NULL);
+
+  if ((data = (int32_t *) malloc (total * sizeof (int32_t))) == NULL)
+    {
+      perror ("Allocating cell bucket memory");
+      exit (-1);
+    }
+
+  if (bucket->spilled)
+    {
+      read_spilled (store, bucket, data);
+
+      pthread_mutex_lock (&store->mutex);
+      store->scratch_read += bucket->spilled * sizeof (int32_t);
+      pthread_mutex_unlock (&store->mutex);
+    }
+
+  if (bucket->count) memcpy (&data[bucket->spilled], bucket->data, bucket->count * sizeof (int32_t));
+
+
+  /*  The records of each file are all together (in input order) so just slide the ones we want down.  */
+
+  if (inputs != NULL)
+    {
+      for (f = 0, pos = 0 ; f < store->num_files ; f++)
+        {
+          first = start[(size_t) f * CELL_COUNT + cell];
+          end = start[(size_t) (f + 1) * CELL_COUNT + cell];
+
+          if (!inputs[f] || end == first) continue;
+
+          if (pos != first) memmove (&data[pos], &data[first], (end - first) * sizeof (int32_t));
+          pos += end - first;
+        }
+
+      total = pos;
+    }
+
+  if (!total)
+    {
+      free (data);
+      return (NULL);
+    }
+
+  *count = total;
+
+  return (data);
+}
+
+
+
+/*  Free the memory for a cell once it has been packed.  */
+
+void cell_store_release (CELL_STORE *store, int32_t cell)
+{
+  CELL_BUCKET       *bucket = &store->bucket[cell];
+
+
+  if (bucket->data != NULL)
+    {
+      free (bucket->data);
+
+      pthread_mutex_lock (&store->mutex);
+      store->bytes -= bucket->size * sizeof (int32_t);
+      pthread_mutex_unlock (&store->mutex);
+    }
+
+  bucket->data = NULL;
+  bucket->count = bucket->size = 0;
+}
+
+
+
+/*  Free everything and close (and thereby delete) the scratch file.  */
+
+void cell_store_free (CELL_STORE *store)
+{
+  int32_t           i;
+
+
+  for (i = 0 ; i < CELL_COUNT ; i++) cell_store_release (store, i);
+
+  free (store->bucket);
+  store->bucket = NULL;
+
+  free (store->dirty);
+  store->dirty = NULL;
+
+  if (store->chunk_next != NULL) free (store->chunk_next);
+  store->chunk_next = NULL;
+
+  if (store->scratch != NULL) fclose (store->scratch);
+  store->scratch = NULL;
+
+  if (store->file_start != NULL) free (store->file_start);
+  store->file_start = NULL;
+
+  pthread_mutex_destroy (&store->mutex);
+}
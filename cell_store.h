@@ -0,0 +1,99 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __CELL_STORE_H__
+#define __CELL_STORE_H__
+
+#include <pthread.h>
+
+#include "build_coast.h"
+
+
+/*  Size of the fixed size chunks that cell data is spilled to the scratch file in.  */
+
+#define         CHUNK_SIZE          32768
+#define         CHUNK_INTS          (CHUNK_SIZE / (int32_t) sizeof (int32_t))
+
+
+/*  Number of chunks we preallocate in the scratch file each time it needs to grow (64MB).  */
+
+#define         CHUNK_EXTENT        2048
+
+
+/*  Segments for one cell are kept as a flat array of 32 bit integers.  That is, the vertex count followed by count
+    pairs of lon/lat values, repeated for each segment in the cell.  If the store exceeds its memory budget the data is
+    moved to a chain of chunks in the scratch file (first_chunk -> ... -> last_chunk, linked through
+    CELL_STORE.chunk_next).  Anything still in memory always follows the spilled data in segment order.  */
+
+typedef struct
+{
+  int32_t       *data;                  /*  Segment records for this cell  */
+  size_t        count;                  /*  Number of int32_t values used in data  */
+  size_t        size;                   /*  Number of int32_t values allocated for data  */
+  int32_t       first_chunk;            /*  First scratch file chunk for this cell or -1  */
+  int32_t       last_chunk;             /*  Last scratch file chunk for this cell or -1  */
+  int32_t       last_used;              /*  Number of int32_t values used in the last chunk  */
+  size_t        spilled;                /*  Total number of int32_t values in the scratch file for this cell  */
+} CELL_BUCKET;
+
+
+typedef struct
+{
+  CELL_BUCKET   *bucket;                /*  CELL_COUNT buckets indexed by latdeg * CELL_COLS + londeg  */
+  size_t        bytes;                  /*  Bytes currently held in memory by all buckets  */
+  size_t        budget;                 /*  Maximum bytes to hold in memory before spilling to the scratch file  */
+  int32_t       spills;                 /*  Number of times we've had to spill to disk  */
+  int64_t       scratch_written;        /*  Bytes written to the scratch file (padding included)  */
+  int64_t       scratch_read;           /*  Bytes read back from the scratch file  */
+  int32_t       *dirty;                 /*  Indices of the buckets that have data in memory  */
+  int32_t       num_dirty;              /*  Number of entries in dirty  */
+  FILE          *scratch;               /*  Scratch file (NULL until the first spill)  */
+  int32_t       num_chunks;             /*  Number of chunks in use in the scratch file  */
+  int32_t       alloc_chunks;           /*  Number of chunks preallocated in the scratch file  */
+  int32_t       *chunk_next;            /*  Next chunk in the cell's chain (or -1) for each chunk  */
+  pthread_mutex_t mutex;                /*  Protects bytes and scratch_read (and the scratch file position on Windows) in
+                                            pass 2  */
+  const uint8_t *filter;                /*  If not NULL, only cells with a non-zero entry (CELL_COUNT) are kept  */
+  size_t        *file_start;            /*  (num_files + 1) * CELL_COUNT start of each input file's records in each cell
+                                            (spilled and in memory, in int32_t values) for --job, NULL otherwise  */
+  int32_t       num_files;
+  int32_t       marked;                 /*  Number of entries of file_start that have been filled in  */
+} CELL_STORE;
+
+
+void cell_store_init (CELL_STORE *store, size_t budget);
+void cell_store_add (CELL_STORE *store, int32_t londeg, int32_t latdeg, const int32_t *record);
+void cell_store_merge (CELL_STORE *store, CELL_STORE *src);
+void cell_store_empty (CELL_STORE *store);
+int32_t *cell_store_load (CELL_STORE *store, int32_t cell, size_t *count);
+/*  Pass 2 may call cell_store_load and cell_store_release from multiple threads as long as each cell is only handled by
+    one of them.  cell_store_add is only called from pass 1.  */
+
+void cell_store_release (CELL_STORE *store, int32_t cell);
+void cell_store_track_files (CELL_STORE *store, int32_t num_files);
+void cell_store_mark_file (CELL_STORE *store, int32_t file);
+int32_t *cell_store_select (CELL_STORE *store, int32_t cell, const uint8_t *inputs, size_t *count);
+void cell_store_free (CELL_STORE *store);
+
+
+#endif
@@ -0,0 +1,173 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __DELTA_SCAN_H__
+#define __DELTA_SCAN_H__
+
+#include "build_coast.h"
+
+#if defined (__AVX2__) || defined (__SSE4_1__)
+#include <immintrin.h>
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+
+/*  Number of bits used to store v (v >= 1) in the segment records.  This is the integer equivalent of the original
+    NINT (log10 (v) / log10 (2.0) + 1.0).  With k = floor (log2 (v)) that rounds up to k + 2 when the fractional part of
+    log2 (v) is at least 0.5, that is when v > 2**k * sqrt (2), or v * v > 2**(2k + 1) (they can never be equal).  The
+    result is the same as the floating point version for every 32 bit value so the output doesn't change.  */
+
+static inline int32_t bits_needed (uint32_t v)
+{
+  int32_t       k;
+
+#if defined (__GNUC__)
+  k = 31 - __builtin_clz (v);
+#else
+  uint32_t      t = v;
+
+  for (k = -1 ; t ; k++) t >>= 1;
+#endif
+
+  return (k + 1 + ((uint64_t) v * v > (1ULL << (2 * k + 1))));
+}
+
+
+
+/*  Find the minimum and maximum lon (diff_x) and lat (diff_y) deltas between consecutive vertices of a segment.  xy
+    holds count interleaved lon/lat pairs (the cell store record layout).  Since the values are interleaved, subtracting
+    the vector starting one pair later from the vector at xy gives lon deltas in the even lanes and lat deltas in the odd
+    lanes so we can scan both at once.  A single vertex segment leaves the
+    starting values (99999999/-99999999) in place just like the original loop did.  */
+
+static inline void delta_scan (const int32_t *xy, int32_t count, int32_t diff_x[2], int32_t diff_y[2])
+{
+  int32_t       i, n = 2 * (count - 1), dmin[2], dmax[2], d;
+
+
+  dmin[0] = dmin[1] = 99999999;
+  dmax[0] = dmax[1] = -99999999;
+
+  i = 0;
+
+#if defined (__AVX2__)
+  if (n >= 8)
+    {
+      __m256i vmin = _mm256_set1_epi32 (99999999), vmax = _mm256_set1_epi32 (-99999999), delta;
+      int32_t lanes_min[8], lanes_max[8], k;
+
+      for ( ; i + 8 <= n ; i += 8)
+        {
+          delta = _mm256_sub_epi32 (_mm256_loadu_si256 ((const __m256i *) &xy[i + 2]),
+                                    _mm256_loadu_si256 ((const __m256i *) &xy[i]));
+          vmin = _mm256_min_epi32 (vmin, delta);
+          vmax = _mm256_max_epi32 (vmax, delta);
+        }
+
+      _mm256_storeu_si256 ((__m256i *) lanes_min, vmin);
+      _mm256_storeu_si256 ((__m256i *) lanes_max, vmax);
+
+      for (k = 0 ; k < 8 ; k++)
+        {
+          dmin[k & 1] = MIN (dmin[k & 1], lanes_min[k]);
+          dmax[k & 1] = MAX (dmax[k & 1], lanes_max[k]);
+        }
+    }
+#elif defined (__SSE2__)
+  if (n >= 4)
+    {
+      __m128i vmin = _mm_set1_epi32 (99999999), vmax = _mm_set1_epi32 (-99999999), delta;
+      int32_t lanes_min[4], lanes_max[4], k;
+
+      for ( ; i + 4 <= n ; i += 4)
+        {
+          delta = _mm_sub_epi32 (_mm_loadu_si128 ((const __m128i *) &xy[i + 2]), _mm_loadu_si128 ((const __m128i *) &xy[i]));
+
+#if defined (__SSE4_1__)
+          vmin = _mm_min_epi32 (vmin, delta);
+          vmax = _mm_max_epi32 (vmax, delta);
+#else
+          /*  SSE2 has no 32 bit min/max so select with a compare mask.  */
+
+          __m128i lt = _mm_cmplt_epi32 (delta, vmin), gt = _mm_cmpgt_epi32 (delta, vmax);
+
+          vmin = _mm_or_si128 (_mm_and_si128 (lt, delta), _mm_andnot_si128 (lt, vmin));
+          vmax = _mm_or_si128 (_mm_and_si128 (gt, delta), _mm_andnot_si128 (gt, vmax));
+#endif
+        }
+
+      _mm_storeu_si128 ((__m128i *) lanes_min, vmin);
+      _mm_storeu_si128 ((__m128i *) lanes_max, vmax);
+
+      for (k = 0 ; k < 4 ; k++)
+        {
+          dmin[k & 1] = MIN (dmin[k & 1], lanes_min[k]);
+          dmax[k & 1] = MAX (dmax[k & 1], lanes_max[k]);
+        }
+    }
+#elif defined (__ARM_NEON)
+  if (n >= 4)
+    {
+      int32x4_t vmin = vdupq_n_s32 (99999999), vmax = vdupq_n_s32 (-99999999), delta;
+      int32_t lanes_min[4], lanes_max[4], k;
+
+      for ( ; i + 4 <= n ; i += 4)
+        {
+          delta = vsubq_s32 (vld1q_s32 (&xy[i + 2]), vld1q_s32 (&xy[i]));
+          vmin = vminq_s32 (vmin, delta);
+          vmax = vmaxq_s32 (vmax, delta);
+        }
+
+      vst1q_s32 (lanes_min, vmin);
+      vst1q_s32 (lanes_max, vmax);
+
+      for (k = 0 ; k < 4 ; k++)
+        {
+          dmin[k & 1] = MIN (dmin[k & 1], lanes_min[k]);
+          dmax[k & 1] = MAX (dmax[k & 1], lanes_max[k]);
+        }
+    }
+#endif
+
+
+  /*  Whatever is left over (or everything if we don't have SIMD).  i is always even here.  */
+
+  for ( ; i < n ; i++)
+    {
+      d = xy[i + 2] - xy[i];
+
+      dmin[i & 1] = MIN (dmin[i & 1], d);
+      dmax[i & 1] = MAX (dmax[i & 1], d);
+    }
+
+  diff_x[0] = dmin[0];
+  diff_x[1] = dmax[0];
+  diff_y[0] = dmin[1];
+  diff_y[1] = dmax[1];
+}
+
+
+#endif
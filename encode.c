@@ -0,0 +1,1176 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "encode.h"
+#include "bit_writer.h"
+#include "delta_scan.h"
+#include "simplify.h"
+#include "tile.h"
+#include "merge.h"
+#include "spool.h"
+#include "varint.h"
+#include "stats.h"
+#include "verify.h"
+
+#include <zlib.h>
+
+#ifdef NVWIN3X
+#include <windows.h>
+#endif
+
+
+/*  Shared state for the pass 2 encoder threads.  Threads grab the next unencoded cell in canonical order, pack it into
+    its CELL_OUTPUT, and signal the writer.  The cells that have been packed but not yet handed to the writer may hold
+    up to window bytes before the threads wait for the writer to catch up.  */
+
+typedef struct
+{
+  CELL_STORE        *store;
+  CELL_OUTPUT       *output;
+  OPTIONS           *options;
+  PREVIOUS_CCL      *previous;
+  int32_t           next_cell;
+  int32_t           written;                /*  Number of cells the writer has finished with  */
+  size_t            in_flight;              /*  Bytes held by packed cells that the writer hasn't gotten to  */
+  size_t            window;                 /*  Limit on in_flight  */
+  int64_t           waits;                  /*  Times a thread waited for the writer to catch up  */
+  SPOOL             spool;                  /*  Records held until the end of the file (writer thread only)  */
+  int32_t           joined;                 /*  Segments joined by --merge (all threads)  */
+  int32_t           dropped;                /*  Degenerate segments dropped by --merge (all threads)  */
+  STATS_WIDTHS_HISTOGRAM widths;            /*  Bit widths of the full resolution records (all threads, --stats)  */
+  pthread_mutex_t   mutex;
+  pthread_cond_t    cell_done;
+  pthread_cond_t    cell_written;
+} ENCODE_POOL;
+
+
+/*  Spool keys.  Records are level * CELL_COUNT + cell and the quadtrees follow the last level.  */
+
+#define         TILE_KEY(pool, cell) ((1 + (pool)->options->num_lod) * CELL_COUNT + (cell))
+
+
+/*  One entry in the extension directory (see ccl_format.h).  */
+
+typedef struct
+{
+  const char        *tag;
+  int32_t           address;
+  int32_t           size;
+  int32_t           param;
+} EXTENSION;
+
+
+
+/*  Number of processors available, used as the default number of encoder threads.  */
+
+int32_t default_thread_count ()
+{
+  int32_t           count;
+
+#ifdef NVWIN3X
+  SYSTEM_INFO       info;
+
+  GetSystemInfo (&info);
+  count = (int32_t) info.dwNumberOfProcessors;
+#else
+  count = (int32_t) sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+  if (count < 1) count = 1;
+
+  return (count);
+}
+
+
+
+/*  Make room for nbytes more (zeroed) bytes at the end of the cell's output buffer and return a pointer to them.  The
+    buffer grows geometrically so packing a cell only allocates a handful of times no matter how many segments it
+    has.  */
+
+static uint8_t *output_reserve (CELL_OUTPUT *out, size_t nbytes)
+{
+  uint8_t           *ptr;
+
+
+  if (out->size + nbytes > out->alloc)
+    {
+      size_t new_alloc = out->alloc ? out->alloc : 4096;
+
+      while (new_alloc < out->size + nbytes) new_alloc *= 2;
+
+      out->data = (uint8_t *) realloc (out->data, new_alloc);
+      if (out->data == NULL)
+        {
+          perror ("Allocating cell output memory");
+          exit (-1);
+        }
+
+      out->alloc = new_alloc;
+    }
+
+  ptr = &out->data[out->size];
+  memset (ptr, 0, nbytes);
+
+  out->size += nbytes;
+
+  return (ptr);
+}
+
+
+
+/*  Bit pack one segment (segCount interleaved lon/lat values in xy, xy[2 * k] is the lon and xy[2 * k + 1] is the lat
+    of vertex k) onto the end of a cell's output buffer (see the record format in main.c).  If widths is not NULL the
+    bit widths are counted in it.  */
+
+static void pack_segment (int32_t cell, const int32_t *xy, int32_t segCount, CELL_OUTPUT *out,
+                          STATS_WIDTHS_HISTOGRAM *widths)
+{
+  int32_t           k, diff_x[2], diff_y[2], range_x, range_y, count_bits, lon_offset_bits;
+  int32_t           lat_offset_bits, pair_bits, size, bias_x, bias_y, xoff, yoff;
+  BIT_WRITER        bw;
+
+
+  out->num_vertices += segCount;
+  out->num_segments++;
+
+#ifdef BUILD_COAST_TRACE
+  for (k = 0 ; k < segCount ; k++) TRACE ("%s %s %d - vertex %d %d %d\n", NVFFL, k, xy[2 * k], xy[2 * k + 1]);
+#endif
+
+  delta_scan (xy, segCount, diff_x, diff_y);
+
+
+  bias_x = -diff_x[0];
+  bias_y = -diff_y[0];
+
+  if (bias_x > MAX_BIAS || bias_x < -MAX_BIAS)
+    {
+      fprintf (stderr, "\n\nlon bias out of range, terminating!\n\n");
+      fprintf (stderr, "%d %d %d\n", cell / CELL_COLS, cell % CELL_COLS, bias_x);
+      exit (-1);
+    }
+
+
+  if (bias_y > MAX_BIAS || bias_y < -MAX_BIAS)
+    {
+      fprintf (stderr, "\n\nlat bias out of range, terminating!\n\n");
+      fprintf (stderr, "%d %d %d\n", cell / CELL_COLS, cell % CELL_COLS, bias_y);
+      exit (-1);
+    }
+
+
+  range_x = diff_x[1] - diff_x[0];
+  range_y = diff_y[1] - diff_y[0];
+
+
+  if (!range_x) range_x = 1;
+  if (!range_y) range_y = 1;
+
+
+  count_bits = bits_needed (segCount);
+  lon_offset_bits = bits_needed (range_x);
+  lat_offset_bits = bits_needed (range_y);
+
+  if (widths != NULL)
+    {
+      widths->count_bits[count_bits]++;
+      widths->lon_bits[lon_offset_bits]++;
+      widths->lat_bits[lat_offset_bits]++;
+    }
+
+
+  size = SEGMENT_RECORD_BYTES (count_bits, lon_offset_bits, lat_offset_bits, segCount);
+
+  bit_writer_init (&bw, output_reserve (out, size));
+
+  bit_writer_put (&bw, COUNT_BITS_WIDTH, count_bits);
+  bit_writer_put (&bw, OFFSET_BITS_WIDTH, lon_offset_bits);
+  bit_writer_put (&bw, OFFSET_BITS_WIDTH, lat_offset_bits);
+  bit_writer_put (&bw, count_bits, segCount);
+  bit_writer_put (&bw, BIAS_WIDTH, bias_x + MAX_BIAS);
+  bit_writer_put (&bw, BIAS_WIDTH, bias_y + MAX_BIAS);
+  bit_writer_put (&bw, START_LON_WIDTH, xy[0]);
+  bit_writer_put (&bw, START_LAT_WIDTH, xy[1]);
+
+
+  /*  When the lon and lat offsets fit in one 32 bit field together (almost always) we write each pair with a
+      single call.  */
+
+  pair_bits = lon_offset_bits + lat_offset_bits;
+
+  if (pair_bits <= 32)
+    {
+      for (k = 1 ; k < segCount ; k++)
+        {
+          xoff = (xy[2 * k] - xy[2 * k - 2]) + bias_x;
+          yoff = (xy[2 * k + 1] - xy[2 * k - 1]) + bias_y;
+
+          bit_writer_put (&bw, pair_bits, ((uint32_t) xoff << lat_offset_bits) | (uint32_t) yoff);
+        }
+    }
+  else
+    {
+      for (k = 1 ; k < segCount ; k++)
+        {
+          xoff = (xy[2 * k] - xy[2 * k - 2]) + bias_x;
+          yoff = (xy[2 * k + 1] - xy[2 * k - 1]) + bias_y;
+
+          bit_writer_put (&bw, lon_offset_bits, xoff);
+          bit_writer_put (&bw, lat_offset_bits, yoff);
+        }
+    }
+
+  bit_writer_flush (&bw);
+}
+
+
+
+/*  Write one segment as a compact (V2.0) record (see ccl_format.h) on the end of a cell's output buffer.  */
+
+static void pack_compact_segment (int32_t cell, const int32_t *xy, int32_t segCount, CELL_OUTPUT *out)
+{
+  uint8_t           *ptr;
+  size_t            n, reserved;
+  int32_t           k;
+
+
+  out->num_vertices += segCount;
+  out->num_segments++;
+
+#ifdef BUILD_COAST_TRACE
+  for (k = 0 ; k < segCount ; k++) TRACE ("%s %s %d - vertex %d %d %d\n", NVFFL, k, xy[2 * k], xy[2 * k + 1]);
+#endif
+
+  reserved = VARINT_MAX_BYTES * (1 + 2 * (size_t) segCount);
+  ptr = output_reserve (out, reserved);
+
+  n = varint_put (ptr, (uint32_t) segCount);
+  n += varint_put (&ptr[n], zigzag_encode (xy[0] - (cell % CELL_COLS) * CELL_SPAN));
+  n += varint_put (&ptr[n], zigzag_encode (xy[1] - (cell / CELL_COLS) * CELL_SPAN));
+
+  for (k = 1 ; k < segCount ; k++)
+    {
+      n += varint_put (&ptr[n], zigzag_encode (xy[2 * k] - xy[2 * k - 2]));
+      n += varint_put (&ptr[n], zigzag_encode (xy[2 * k + 1] - xy[2 * k - 1]));
+    }
+
+  out->size -= reserved - n;
+}
+
+
+
+/*  Replace a cell's records with their size and a zlib stream of them (--zlib).  */
+
+static void compress_output (CELL_OUTPUT *out)
+{
+  uLongf            length = compressBound ((uLong) out->size);
+  uint8_t           *data;
+
+
+  if ((data = (uint8_t *) malloc (4 + length)) == NULL)
+    {
+      perror ("Allocating cell output memory");
+      exit (-1);
+    }
+
+  data[0] = (uint8_t) (out->size >> 24);
+  data[1] = (uint8_t) (out->size >> 16);
+  data[2] = (uint8_t) (out->size >> 8);
+  data[3] = (uint8_t) out->size;
+
+  if (compress2 (data + 4, &length, out->data, (uLong) out->size, Z_BEST_COMPRESSION) != Z_OK)
+    {
+      fprintf (stderr, "\n\nUnable to compress cell records, terminating!\n\n");
+      exit (-1);
+    }
+
+  free (out->data);
+
+  out->data = data;
+  out->size = out->alloc = 4 + length;
+}
+
+
+
+/*  Pack all of the segments for one cell.  The vertices are used straight out of the cell store records and each
+    segment is packed directly into the cell's output buffer, out[0].  If there are simplified levels of detail each
+    segment is also simplified (from the full resolution vertices) and packed into out[level * CELL_COUNT].  If the
+    full resolution cell ends up with more than options->tile_threshold vertices its quadtree is built from the segment
+    bounds saved along the way.  With --merge the segments are joined (see merge_segments) before any of this.  With
+    --compact the segments are written as compact records and with --zlib each level of the cell is compressed at the
+    end.  widths (NULL unless --stats) counts the bit widths of the full resolution records.  For --verify the packed
+    segments are hashed into options->check.  */
+
+static void encode_cell (CELL_STORE *store, const OPTIONS *options, int32_t cell, CELL_OUTPUT *out,
+                         SIMPLIFY_BUFFER *simplify, TILE_BUFFER *tile, MERGE_BUFFER *merge,
+                         STATS_WIDTHS_HISTOGRAM *widths)
+{
+  int32_t           level, segCount, count, *xy, *cell_data, *selected = NULL;
+  size_t            cell_count, rec, offset;
+  uint64_t          hash = VERIFY_HASH_START;
+
+
+  /*  With --job the store is shared by all of the outputs so we work on a copy of the records from this output's
+      input files.  */
+
+  if (store->file_start != NULL)
+    {
+      if ((cell_data = selected = cell_store_select (store, cell, options->inputs, &cell_count)) == NULL) return;
+    }
+  else
+    {
+      if ((cell_data = cell_store_load (store, cell, &cell_count)) == NULL) return;
+    }
+
+  if (options->merge) cell_data = merge_segments (merge, cell_data, &cell_count);
+
+  tile->num_segments = 0;
+
+
+  for (rec = 0 ; rec < cell_count ; rec += 1 + 2 * (size_t) segCount)
+    {
+      segCount = cell_data[rec];
+
+      TRACE ("%s %s %d - cell %d segment with %d vertices\n", NVFFL, cell, segCount);
+
+
+      /*  Just in case we happened to write an empty segment between files ;-)  */
+
+      if (segCount)
+        {
+          if (rec + 1 + 2 * (size_t) segCount > cell_count)
+            {
+              fprintf (stderr, "Bad return in file %s, function %s at line %d.  This should never happen!", __FILE__, __FUNCTION__, __LINE__ - 2);
+              fflush (stderr);
+              exit (-1);
+            }
+
+          xy = &cell_data[rec + 1];
+
+          if (options->check != NULL) hash = verify_hash_segment (hash, xy, segCount);
+
+          offset = out->size;
+
+          if (options->compact)
+            {
+              pack_compact_segment (cell, xy, segCount, out);
+            }
+          else
+            {
+              pack_segment (cell, xy, segCount, out, widths);
+            }
+
+          if (options->tile_threshold) tile_add_segment (tile, xy, segCount, (int32_t) offset);
+
+          for (level = 1 ; level <= options->num_lod ; level++)
+            {
+              count = simplify_segment (simplify, xy, segCount, options->lod_tolerance[level - 1]);
+
+              if (options->compact)
+                {
+                  pack_compact_segment (cell, simplify->xy, count, &out[level * CELL_COUNT]);
+                }
+              else
+                {
+                  pack_segment (cell, simplify->xy, count, &out[level * CELL_COUNT], NULL);
+                }
+            }
+        }
+    }
+
+  if (selected != NULL)
+    {
+      free (selected);
+    }
+  else
+    {
+      cell_store_release (store, cell);
+    }
+
+  if (options->check != NULL)
+    {
+      options->check[cell].hash = hash;
+      options->check[cell].packed = NVTrue;
+    }
+
+
+  if (options->tile_threshold && out->num_vertices > options->tile_threshold)
+    out->tile = tile_build (tile, cell, options->tile_threshold, &out->tile_size);
+
+  if (options->compress)
+    {
+      for (level = 0 ; level <= options->num_lod ; level++)
+        if (out[level * CELL_COUNT].size) compress_output (&out[level * CELL_COUNT]);
+    }
+}
+
+
+
+/*  Memory held by the packed outputs of a cell (every level and the quadtree).  */
+
+static size_t cell_memory (ENCODE_POOL *pool, int32_t cell)
+{
+  size_t            bytes = pool->output[cell].tile_size;
+  int32_t           level;
+
+
+  for (level = 0 ; level <= pool->options->num_lod ; level++) bytes += pool->output[level * CELL_COUNT + cell].alloc;
+
+  return (bytes);
+}
+
+
+
+static void *encode_thread (void *arg)
+{
+  ENCODE_POOL       *pool = (ENCODE_POOL *) arg;
+  SIMPLIFY_BUFFER   simplify;
+  TILE_BUFFER       tile;
+  MERGE_BUFFER      merge;
+  STATS_WIDTHS_HISTOGRAM widths, *widths_ptr = NULL;
+  int32_t           cell, i;
+  double            start;
+
+
+  if (run_stats.enabled)
+    {
+      memset (&widths, 0, sizeof (widths));
+      widths_ptr = &widths;
+    }
+
+  simplify_buffer_init (&simplify);
+  tile_buffer_init (&tile);
+  merge_buffer_init (&merge);
+
+  while (NVTrue)
+    {
+      /*  Don't get too far ahead of the writer.  The cell the writer is waiting for has always been taken already.  */
+
+      pthread_mutex_lock (&pool->mutex);
+
+      if (pool->in_flight > pool->window && pool->next_cell > pool->written)
+        {
+          pool->waits++;
+          while (pool->in_flight > pool->window && pool->next_cell > pool->written)
+            pthread_cond_wait (&pool->cell_written, &pool->mutex);
+        }
+
+      cell = pool->next_cell++;
+      pthread_mutex_unlock (&pool->mutex);
+
+      if (cell >= CELL_COUNT) break;
+
+
+      /*  Cells outside of --bbox are always empty.  */
+
+      if ((pool->options->region == NULL || pool->options->region[cell]) &&
+          (pool->previous == NULL || pool->previous->reencode[cell]))
+        {
+          if (run_stats.enabled)
+            {
+              start = stats_clock ();
+
+              encode_cell (pool->store, pool->options, cell, &pool->output[cell], &simplify, &tile, &merge, widths_ptr);
+
+              run_stats.cell_seconds[cell] = (float) (stats_clock () - start);
+            }
+          else
+            {
+              encode_cell (pool->store, pool->options, cell, &pool->output[cell], &simplify, &tile, &merge, NULL);
+            }
+        }
+
+
+      pthread_mutex_lock (&pool->mutex);
+      pool->output[cell].done = NVTrue;
+      pool->in_flight += cell_memory (pool, cell);
+      pthread_cond_broadcast (&pool->cell_done);
+      pthread_mutex_unlock (&pool->mutex);
+    }
+
+  pthread_mutex_lock (&pool->mutex);
+  pool->joined += merge.joined;
+  pool->dropped += merge.dropped;
+
+  if (widths_ptr != NULL)
+    {
+      for (i = 0 ; i < STATS_WIDTHS ; i++)
+        {
+          pool->widths.count_bits[i] += widths.count_bits[i];
+          pool->widths.lon_bits[i] += widths.lon_bits[i];
+          pool->widths.lat_bits[i] += widths.lat_bits[i];
+        }
+    }
+  pthread_mutex_unlock (&pool->mutex);
+
+  simplify_buffer_free (&simplify);
+  tile_buffer_free (&tile);
+  merge_buffer_free (&merge);
+
+  return (NULL);
+}
+
+
+
+/*  The size, number of segments, and number of vertices of a cell at one level of detail, either from the encoder or
+    (incremental builds) from the previous file.  */
+
+static void cell_entry (ENCODE_POOL *pool, int32_t level, int32_t cell, size_t *size, int32_t *num_segments,
+                        int32_t *num_vertices)
+{
+  const CCL_LEVEL   *lv;
+  CELL_OUTPUT       *out;
+
+
+  if (pool->previous != NULL && !pool->previous->reencode[cell])
+    {
+      lv = &pool->previous->ccl->level[level];
+
+      *size = (size_t) lv->cell_size[cell];
+      *num_segments = lv->num_segments[cell];
+      *num_vertices = lv->num_vertices[cell];
+
+      return;
+    }
+
+  out = &pool->output[level * CELL_COUNT + cell];
+
+  *size = out->size;
+  *num_segments = out->num_segments;
+  *num_vertices = out->num_vertices;
+}
+
+
+
+/*  The packed records for a cell at one level of detail, either from the encoder, from the spool (if the writer has
+    already moved them there), or (incremental builds) straight out of the previous file.  */
+
+static const uint8_t *cell_records (ENCODE_POOL *pool, int32_t level, int32_t cell, size_t *size, int32_t *num_segments,
+                                    int32_t *num_vertices)
+{
+  const CCL_LEVEL   *lv;
+  CELL_OUTPUT       *out;
+
+
+  cell_entry (pool, level, cell, size, num_segments, num_vertices);
+
+  if (pool->previous != NULL && !pool->previous->reencode[cell])
+    {
+      lv = &pool->previous->ccl->level[level];
+
+      return (pool->previous->ccl->data + lv->address[cell]);
+    }
+
+  out = &pool->output[level * CELL_COUNT + cell];
+
+  if (out->data == NULL && out->size) return (spool_get (&pool->spool, level * CELL_COUNT + cell, size));
+
+  return (out->data);
+}
+
+
+
+/*  The spool may hold whatever the cell store and the cells packed ahead of the writer aren't using.  */
+
+static size_t spool_limit (ENCODE_POOL *pool)
+{
+  size_t            used;
+
+
+  pthread_mutex_lock (&pool->store->mutex);
+  used = pool->store->bytes;
+  pthread_mutex_unlock (&pool->store->mutex);
+
+  pthread_mutex_lock (&pool->mutex);
+  used += pool->in_flight;
+  pthread_mutex_unlock (&pool->mutex);
+
+  return (pool->options->max_memory > used ? pool->options->max_memory - used : 0);
+}
+
+
+
+/*  Move a packed output (of level * CELL_COUNT + cell) that has to wait for the end of the file into the spool.  The
+    size and counts stay in the output.  */
+
+static void spool_output (ENCODE_POOL *pool, int32_t key, CELL_OUTPUT *out)
+{
+  if (!out->size)
+    {
+      free (out->data);
+      out->data = NULL;
+      out->alloc = 0;
+      return;
+    }
+
+
+  /*  The output buffers grow in steps so give back the slack before holding on to them.  */
+
+  if (out->alloc > out->size) out->data = (uint8_t *) realloc (out->data, out->size);
+
+  spool_put (&pool->spool, key, out->data, out->size, spool_limit (pool));
+
+  out->data = NULL;
+  out->alloc = 0;
+}
+
+
+
+/*  Save the address, number of segments, and number of vertices of a cell in a header table.  */
+
+static void header_entry (uint8_t *header, int32_t cell, int32_t address, int32_t num_segments, int32_t num_vertices)
+{
+  int32_t           k = 8 * sizeof (int32_t), pos = cell * HEADER_ENTRY_SIZE * 8;
+
+
+  bit_pack (header, pos, k, address); pos += k;
+  bit_pack (header, pos, k, num_segments); pos += k;
+  bit_pack (header, pos, k, num_vertices);
+}
+
+
+
+static void write_records (FILE *ofp, const uint8_t *data, size_t size)
+{
+  if (size && fwrite (data, size, 1, ofp) != 1)
+    {
+      perror ("Writing cell records");
+      exit (-1);
+    }
+}
+
+
+
+static void free_output (ENCODE_POOL *pool, int32_t key)
+{
+  CELL_OUTPUT       *out = &pool->output[key];
+
+
+  if (out->data == NULL && out->size) spool_release (&pool->spool, key);
+
+  free (out->data);
+  out->data = NULL;
+  out->size = out->alloc = 0;
+}
+
+
+
+/*  Write one simplified level of detail block (header followed by the cell records) at address.  These are always
+    held (in memory or in the spool) until pass 2 is done so we know the sizes before we write the header.  Returns the address of the
+    end of the block.  */
+
+static int32_t write_level (ENCODE_POOL *pool, FILE *ofp, int32_t level, int32_t address, uint8_t *header)
+{
+  const uint8_t     *data;
+  size_t            size;
+  int32_t           cell, num_segments, num_vertices, cell_address;
+
+
+  memset (header, 0, HEADER_SIZE);
+
+  cell_address = address + HEADER_SIZE;
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      cell_entry (pool, level, cell, &size, &num_segments, &num_vertices);
+
+      if (size)
+        {
+          header_entry (header, cell, cell_address, num_segments, num_vertices);
+          cell_address += (int32_t) size;
+        }
+    }
+
+  if (fwrite (header, HEADER_SIZE, 1, ofp) != 1)
+    {
+      perror ("Writing level of detail header");
+      exit (-1);
+    }
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      data = cell_records (pool, level, cell, &size, &num_segments, &num_vertices);
+
+      write_records (ofp, data, size);
+
+      free_output (pool, level * CELL_COUNT + cell);
+    }
+
+  return (cell_address);
+}
+
+
+
+/*  The quadtree for a full resolution cell, either from the encoder or (incremental builds) straight out of the
+    previous file.  Returns NULL (with size 0) if the cell isn't tiled.  */
+
+static const uint8_t *cell_tile (ENCODE_POOL *pool, int32_t cell, size_t *size)
+{
+  const CCL_FILE    *ccl;
+
+
+  if (pool->previous != NULL && !pool->previous->reencode[cell])
+    {
+      ccl = pool->previous->ccl;
+
+      if (ccl->tile_address == NULL || !ccl->tile_size[cell])
+        {
+          *size = 0;
+          return (NULL);
+        }
+
+      *size = (size_t) ccl->tile_size[cell];
+
+      return (ccl->data + ccl->tile_address[cell]);
+    }
+
+  *size = pool->output[cell].tile_size;
+
+  if (pool->output[cell].tile == NULL && *size) return (spool_get (&pool->spool, TILE_KEY (pool, cell), size));
+
+  return (pool->output[cell].tile);
+}
+
+
+
+/*  Size of the quadtree of a full resolution cell (0 if it isn't tiled).  */
+
+static size_t cell_tile_size (ENCODE_POOL *pool, int32_t cell)
+{
+  const CCL_FILE    *ccl;
+
+
+  if (pool->previous != NULL && !pool->previous->reencode[cell])
+    {
+      ccl = pool->previous->ccl;
+
+      return (ccl->tile_address == NULL ? 0 : (size_t) ccl->tile_size[cell]);
+    }
+
+  return (pool->output[cell].tile_size);
+}
+
+
+
+/*  Write the CCL_TAG_TILE block (see ccl_format.h) at address.  Returns the address of the end of the block.  */
+
+static int32_t write_tiles (ENCODE_POOL *pool, FILE *ofp, int32_t address)
+{
+  uint8_t           *table;
+  const uint8_t     *tree;
+  size_t            size;
+  int32_t           cell, num, pos, offset, k = 8 * sizeof (int32_t);
+
+
+  for (cell = 0, num = 0 ; cell < CELL_COUNT ; cell++) if (cell_tile_size (pool, cell)) num++;
+
+  if ((table = (uint8_t *) calloc (1, 4 + 12 * (size_t) num)) == NULL)
+    {
+      perror ("Allocating tile memory");
+      exit (-1);
+    }
+
+  bit_pack (table, 0, k, num);
+
+  pos = k;
+  offset = 4 + 12 * num;
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      size = cell_tile_size (pool, cell);
+
+      if (size)
+        {
+          bit_pack (table, pos, k, cell); pos += k;
+          bit_pack (table, pos, k, offset); pos += k;
+          bit_pack (table, pos, k, (int32_t) size); pos += k;
+
+          offset += (int32_t) size;
+        }
+    }
+
+  if (fwrite (table, 4 + 12 * (size_t) num, 1, ofp) != 1)
+    {
+      perror ("Writing tile table");
+      exit (-1);
+    }
+
+  free (table);
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      tree = cell_tile (pool, cell, &size);
+
+      write_records (ofp, tree, size);
+
+      if (pool->output[cell].tile == NULL && pool->output[cell].tile_size)
+        spool_release (&pool->spool, TILE_KEY (pool, cell));
+
+      free (pool->output[cell].tile);
+      pool->output[cell].tile = NULL;
+      pool->output[cell].tile_size = 0;
+    }
+
+  return (address + offset);
+}
+
+
+
+/*  Write the extension directory and trailer (see ccl_format.h) at address.  */
+
+static void write_extensions (FILE *ofp, int32_t address, const EXTENSION *ext, int32_t num)
+{
+  uint8_t           dir[(2 + CCL_MAX_LOD) * CCL_DIR_ENTRY_SIZE + CCL_TRAILER_SIZE];
+  int32_t           i, pos, k = 8 * sizeof (int32_t);
+
+
+  memset (dir, 0, sizeof (dir));
+
+  for (i = 0 ; i < num ; i++)
+    {
+      memcpy (&dir[i * CCL_DIR_ENTRY_SIZE], ext[i].tag, 4);
+
+      pos = i * CCL_DIR_ENTRY_SIZE * 8 + 32;
+      bit_pack (dir, pos, k, ext[i].address); pos += k;
+      bit_pack (dir, pos, k, ext[i].size); pos += k;
+      bit_pack (dir, pos, k, ext[i].param);
+    }
+
+  pos = num * CCL_DIR_ENTRY_SIZE * 8;
+  bit_pack (dir, pos, k, address); pos += k;
+  bit_pack (dir, pos, k, num);
+  memcpy (&dir[num * CCL_DIR_ENTRY_SIZE + 8], CCL_TRAILER_MAGIC, 4);
+
+  if (fwrite (dir, num * CCL_DIR_ENTRY_SIZE + CCL_TRAILER_SIZE, 1, ofp) != 1)
+    {
+      perror ("Writing extension directory");
+      exit (-1);
+    }
+}
+
+
+
+/*  Pack every cell in the store and write the header and cell records to ofp (the version block must already have
+    been written).  The cells are packed by options->num_threads encoder threads while this thread writes the results in
+    canonical cell order so that the output is identical no matter how many threads are used.  The header table is
+    built in memory as the cells are written.  We reserve space for it with one write up front and fill it in with one
+    seek and one write at the end.  If options->streaming is set (ofp is a pipe) we can't seek, so the packed cells are
+    spooled until they have all been encoded, then the header and the cells are written strictly in order.  If
+    previous is not NULL (incremental build, never streaming) only the cells flagged in previous->reencode are packed,
+    the others are copied from the previous file.  If there are simplified levels of detail (--lod) or quadtrees for
+    dense cells (--subdivide) they are written after the full resolution cells followed by the extension directory
+    (see ccl_format.h).  The encoder threads stay within 1/MEMORY_WINDOW_SHARE of options->max_memory of the writer
+    and the spool spills to its scratch file when the store, the packed cells, and the spool add up to more than
+    options->max_memory.  Returns the total number of points packed.  */
+
+int32_t encode_cells (CELL_STORE *store, FILE *ofp, OPTIONS *options, PREVIOUS_CCL *previous)
+{
+  ENCODE_POOL       pool;
+  pthread_t         *threads;
+  const uint8_t     *data;
+  size_t            size;
+  int32_t           i, j, level, cell, address, base_end, total, percent, old_percent, num_segments, num_vertices;
+  int32_t           num_threads = MAX (options->num_threads, 1), num_ext, span;
+  size_t            memory;
+  uint8_t           *header;
+  EXTENSION         ext[2 + CCL_MAX_LOD];
+
+
+  header = (uint8_t *) calloc (1, HEADER_SIZE);
+  if (header == NULL)
+    {
+      perror ("Allocating header memory");
+      exit (-1);
+    }
+
+
+  /*  Empty cells have all zero header entries so we just write the blank header now to reserve the space.  */
+
+  if (!options->streaming && fwrite (header, HEADER_SIZE, 1, ofp) != 1)
+    {
+      perror ("Writing header");
+      exit (-1);
+    }
+
+
+  /*  One set of outputs per level of detail, level 0 (full resolution) first.  */
+
+  pool.store = store;
+  pool.options = options;
+  pool.previous = previous;
+  pool.next_cell = 0;
+  pool.written = 0;
+  pool.in_flight = 0;
+  pool.window = options->max_memory / MEMORY_WINDOW_SHARE;
+  pool.waits = 0;
+  pool.joined = pool.dropped = 0;
+  memset (&pool.widths, 0, sizeof (pool.widths));
+  pool.output = (CELL_OUTPUT *) calloc ((size_t) CELL_COUNT * (1 + options->num_lod), sizeof (CELL_OUTPUT));
+  if (pool.output == NULL)
+    {
+      perror ("Allocating cell output memory");
+      exit (-1);
+    }
+
+  spool_init (&pool.spool, (2 + options->num_lod) * CELL_COUNT);
+
+  pthread_mutex_init (&pool.mutex, NULL);
+  pthread_cond_init (&pool.cell_done, NULL);
+  pthread_cond_init (&pool.cell_written, NULL);
+
+
+  threads = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+  if (threads == NULL)
+    {
+      perror ("Allocating thread memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < num_threads ; i++)
+    {
+      if (pthread_create (&threads[i], NULL, encode_thread, &pool))
+        {
+          perror ("Creating encoder thread");
+          exit (-1);
+        }
+    }
+
+
+  total = 0;
+  percent = 0;
+  old_percent = -1;
+  address = VERSION_SIZE + HEADER_SIZE;
+
+  for (i = 0 ; i < CELL_ROWS ; i++)
+    {
+      for (j = 0 ; j < CELL_COLS ; j++)
+        {
+          cell = i * CELL_COLS + j;
+
+
+          /*  Wait for the encoder threads to get to this cell.  */
+
+          pthread_mutex_lock (&pool.mutex);
+          while (!pool.output[cell].done) pthread_cond_wait (&pool.cell_done, &pool.mutex);
+          pthread_mutex_unlock (&pool.mutex);
+
+
+          data = cell_records (&pool, 0, cell, &size, &num_segments, &num_vertices);
+
+          if (size)
+            {
+              if (!options->streaming) write_records (ofp, data, size);
+
+              total += num_vertices;
+
+              run_stats.output_segments += num_segments;
+              run_stats.output_vertices += num_vertices;
+              run_stats.output_bytes += (int64_t) size;
+
+              if (run_stats.enabled)
+                {
+                  run_stats.cell_segments[cell] = num_segments;
+                  run_stats.cell_vertices[cell] = num_vertices;
+                  run_stats.cell_bytes[cell] = (int32_t) size;
+                }
+
+
+              /*  Save the address, number of segments, and number of vertices in the header  */
+
+              header_entry (header, cell, address, num_segments, num_vertices);
+
+              if (options->check != NULL)
+                {
+                  options->check[cell].address = address;
+                  options->check[cell].num_segments = num_segments;
+                  options->check[cell].num_vertices = num_vertices;
+                  options->check[cell].size = (int32_t) size;
+                }
+
+              address += (int32_t) size;
+            }
+
+
+          /*  When streaming we keep the packed cell until the header has been written.  The levels of detail and the
+              quadtree are always kept until the end of the file.  Anything kept goes to the spool so that the packed
+              cells only hold memory until the writer gets to them.  */
+
+          memory = cell_memory (&pool, cell);
+
+          if (options->streaming)
+            {
+              spool_output (&pool, cell, &pool.output[cell]);
+            }
+          else
+            {
+              free_output (&pool, cell);
+            }
+
+          for (level = 1 ; level <= options->num_lod ; level++)
+            spool_output (&pool, level * CELL_COUNT + cell, &pool.output[level * CELL_COUNT + cell]);
+
+          if (pool.output[cell].tile != NULL)
+            {
+              spool_put (&pool.spool, TILE_KEY (&pool, cell), pool.output[cell].tile, pool.output[cell].tile_size,
+                         spool_limit (&pool));
+              pool.output[cell].tile = NULL;
+            }
+
+          pthread_mutex_lock (&pool.mutex);
+          pool.in_flight -= memory;
+          pool.written = cell + 1;
+          pthread_cond_broadcast (&pool.cell_written);
+          pthread_mutex_unlock (&pool.mutex);
+
+          run_stats.cells_written = cell + 1;
+        }
+
+      stats_poll ();
+
+      percent = (int32_t) (((float) i / (CELL_ROWS + 1.0)) * 100.0);
+      if (percent != old_percent)
+        {
+          PROGRESS ("%03d%% packed\r", percent);
+          old_percent = percent;
+        }
+    }
+
+
+  for (i = 0 ; i < num_threads ; i++) pthread_join (threads[i], NULL);
+
+  run_stats.widths = pool.widths;
+
+  base_end = address;
+
+  if (options->merge)
+    PROGRESS ("Joined %d segments and dropped %d degenerate segments\n\n", pool.joined, pool.dropped);
+
+
+  if (options->streaming)
+    {
+      /*  Now that we know every address write the header followed by the spooled cells.  */
+
+      if (fwrite (header, HEADER_SIZE, 1, ofp) != 1)
+        {
+          perror ("Writing header");
+          exit (-1);
+        }
+
+      for (cell = 0 ; cell < CELL_COUNT ; cell++)
+        {
+          data = cell_records (&pool, 0, cell, &size, &num_segments, &num_vertices);
+
+          write_records (ofp, data, size);
+
+          free_output (&pool, cell);
+        }
+    }
+
+
+  /*  The simplified levels, the quadtrees, and the extension directory go after the full resolution cells so a V1.0
+      reader never sees them.  The level 0 header has to survive write_level so the level headers use their own
+      buffer.  */
+
+  num_ext = 0;
+
+  if (options->num_lod || options->tile_threshold)
+    {
+      ext[num_ext].tag = CCL_TAG_BASE;
+      ext[num_ext].address = 0;
+      ext[num_ext].size = base_end;
+      ext[num_ext++].param = 0;
+    }
+
+  if (options->num_lod)
+    {
+      uint8_t *lod_header = (uint8_t *) malloc (HEADER_SIZE);
+      if (lod_header == NULL)
+        {
+          perror ("Allocating header memory");
+          exit (-1);
+        }
+
+      span = stats_span_begin ("levels of detail", NULL);
+
+      for (level = 1 ; level <= options->num_lod ; level++)
+        {
+          ext[num_ext].tag = CCL_TAG_LOD;
+          ext[num_ext].address = address;
+          ext[num_ext].param = options->lod_tolerance[level - 1];
+
+          address = write_level (&pool, ofp, level, address, lod_header);
+
+          ext[num_ext].size = address - ext[num_ext].address;
+          num_ext++;
+        }
+
+      free (lod_header);
+
+      stats_span_end (span);
+    }
+
+  if (options->tile_threshold)
+    {
+      ext[num_ext].tag = CCL_TAG_TILE;
+      ext[num_ext].address = address;
+      ext[num_ext].param = options->tile_threshold;
+
+      span = stats_span_begin ("quadtrees", NULL);
+
+      address = write_tiles (&pool, ofp, address);
+
+      stats_span_end (span);
+
+      ext[num_ext].size = address - ext[num_ext].address;
+      num_ext++;
+    }
+
+  if (num_ext) write_extensions (ofp, address, ext, num_ext);
+
+
+  if (!options->streaming)
+    {
+      /*  Fill in the header.  */
+
+      if (fseek (ofp, VERSION_SIZE, SEEK_SET) || fwrite (header, HEADER_SIZE, 1, ofp) != 1)
+        {
+          perror ("Writing header");
+          exit (-1);
+        }
+    }
+
+  if (pool.spool.spills) PROGRESS ("Spooled %d times to stay inside of the memory limit\n\n", pool.spool.spills);
+
+  run_stats.memory_waits += pool.waits;
+
+  free (header);
+  free (threads);
+  free (pool.output);
+  spool_free (&pool.spool);
+
+  pthread_mutex_destroy (&pool.mutex);
+  pthread_cond_destroy (&pool.cell_done);
+  pthread_cond_destroy (&pool.cell_written);
+
+  return (total);
+}
@@ -0,0 +1,64 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __ENCODE_H__
+#define __ENCODE_H__
+
+#include <pthread.h>
+
+#include "build_coast.h"
+#include "cell_store.h"
+#include "ccl_reader.h"
+
+
+/*  The packed segments for one cell.  The encoder threads fill these in and the writer emits them in canonical cell
+    order.  */
+
+typedef struct
+{
+  uint8_t       *data;                  /*  Bit packed segment records  */
+  size_t        size;                   /*  Number of bytes used in data  */
+  size_t        alloc;                  /*  Number of bytes allocated for data  */
+  int32_t       num_segments;           /*  Number of segments in the cell  */
+  int32_t       num_vertices;           /*  Number of vertices in the cell  */
+  uint8_t       *tile;                  /*  Quadtree for a dense cell (see CCL_TAG_TILE) or NULL  */
+  size_t        tile_size;              /*  Number of bytes in tile  */
+  uint8_t       done;                   /*  NVTrue when the cell has been encoded  */
+} CELL_OUTPUT;
+
+
+/*  The previous version of the output file for an incremental build.  Cells that don't need to be packed again are
+    copied straight from it (every level of detail).  */
+
+typedef struct
+{
+  CCL_FILE      *ccl;                   /*  Previous .ccl file (opened with ccl_open)  */
+  const uint8_t *reencode;              /*  CELL_COUNT flags, NVTrue for the cells that are packed from the store  */
+} PREVIOUS_CCL;
+
+
+int32_t encode_cells (CELL_STORE *store, FILE *ofp, OPTIONS *options, PREVIOUS_CCL *previous);
+int32_t default_thread_count ();
+
+
+#endif
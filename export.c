@@ -0,0 +1,585 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#include "export.h"
+#include "ccl_reader.h"
+
+#include <pthread.h>
+
+#ifdef NVWIN3X
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+
+/*  The exported segments of one row of cells.  GeoJSON and WKB are formatted straight into data, shapefile segments are
+    kept as shapelib objects since only the writer can hand them to SHPWriteObject.  */
+
+typedef struct
+{
+  uint8_t       *data;                  /*  Formatted GeoJSON features or WKB line strings  */
+  size_t        size;                   /*  Number of bytes used in data  */
+  size_t        alloc;                  /*  Number of bytes allocated for data  */
+  SHPObject     **shape;                /*  One SHPT_ARC object per segment  */
+  int32_t       *shape_cell;            /*  Cell and segment number of each shape (for the .dbf)  */
+  int32_t       *shape_segment;
+  int32_t       num_shapes;
+  int32_t       shape_alloc;
+  int64_t       vertices;               /*  Number of vertices in the row (as stored, before any duplication)  */
+  uint8_t       done;                   /*  NVTrue when the row is ready to write  */
+} EXPORT_ROW;
+
+
+/*  Shared state for the export threads.  Threads take the next row, decode and format its cells into the row's own
+    buffer, and signal the writer, which writes the rows in order.  No thread gets more than window rows ahead of the
+    writer.  */
+
+typedef struct
+{
+  const CCL_FILE    *ccl;
+  const OPTIONS     *options;
+  int32_t           level;
+  int32_t           format;
+  EXPORT_ROW        row[CELL_ROWS];
+  int32_t           max_segments;
+  int32_t           max_vertices;
+  int32_t           next_row;
+  int32_t           written;                /*  Number of rows written  */
+  int32_t           window;
+  pthread_mutex_t   mutex;
+  pthread_cond_t    row_done;
+  pthread_cond_t    row_written;
+} EXPORT_POOL;
+
+
+
+/*  Map a --export argument to one of the EXPORT_ formats.  Returns 0 if it isn't one of them.  */
+
+int32_t export_format (const char *name)
+{
+  if (!strcmp (name, "geojson")) return (EXPORT_GEOJSON);
+  if (!strcmp (name, "wkb")) return (EXPORT_WKB);
+  if (!strcmp (name, "shp")) return (EXPORT_SHAPEFILE);
+
+  return (0);
+}
+
+
+
+static uint8_t *row_reserve (EXPORT_ROW *row, size_t nbytes)
+{
+  if (row->size + nbytes > row->alloc)
+    {
+      size_t new_alloc = row->alloc ? row->alloc : 65536;
+
+      while (new_alloc < row->size + nbytes) new_alloc *= 2;
+
+      row->data = (uint8_t *) realloc (row->data, new_alloc);
+      if (row->data == NULL)
+        {
+          perror ("Allocating export memory");
+          exit (-1);
+        }
+
+      row->alloc = new_alloc;
+    }
+
+  return (&row->data[row->size]);
+}
+
+
+
+/*  Print a fixed point position (POSITION_SCALE units, already unbiased) in degrees with exactly the CCL_SCALE
+    decimals that are stored.  This is a lot quicker than printf and there is no rounding to worry about.  Returns the
+    number of characters written.  */
+
+static int32_t put_degrees (char *ptr, int32_t value)
+{
+  char              digits[12];
+  int32_t           n = 0, len = 0, whole, frac, i;
+
+
+  if (value < 0)
+    {
+      ptr[len++] = '-';
+      value = -value;
+    }
+
+  whole = value / (int32_t) POSITION_SCALE;
+  frac = value % (int32_t) POSITION_SCALE;
+
+  do
+    {
+      digits[n++] = (char) ('0' + whole % 10);
+      whole /= 10;
+    } while (whole);
+
+  while (n) ptr[len++] = digits[--n];
+
+  ptr[len++] = '.';
+
+  for (i = CCL_SCALE - 1 ; i >= 0 ; i--)
+    {
+      ptr[len + i] = (char) ('0' + frac % 10);
+      frac /= 10;
+    }
+
+  return (len + CCL_SCALE);
+}
+
+
+
+/*  One GeoJSON LineString feature, preceded by the separator from the previous feature.  */
+
+static void put_geojson (EXPORT_ROW *row, int32_t cell, int32_t level, int32_t segment, const int32_t *xy, int32_t count)
+{
+  char              *ptr;
+  int32_t           k, n, len;
+
+
+  n = MAX (count, 2);
+  ptr = (char *) row_reserve (row, 160 + 32 * (size_t) n);
+
+  len = sprintf (ptr, ",\n{\"type\": \"Feature\", \"properties\": {\"cell\": %d, \"level\": %d, \"segment\": %d}, "
+                 "\"geometry\": {\"type\": \"LineString\", \"coordinates\": [", cell, level, segment);
+
+  for (k = 0 ; k < n ; k++)
+    {
+      const int32_t *v = &xy[2 * MIN (k, count - 1)];
+
+      if (k) ptr[len++] = ',';
+      ptr[len++] = '[';
+      len += put_degrees (&ptr[len], v[0] - 180 * (int32_t) POSITION_SCALE);
+      ptr[len++] = ',';
+      len += put_degrees (&ptr[len], v[1] - 90 * (int32_t) POSITION_SCALE);
+      ptr[len++] = ']';
+    }
+
+  len += sprintf (&ptr[len], "]}}");
+
+  row->size += len;
+}
+
+
+
+static void put_u32_le (uint8_t *ptr, uint32_t value)
+{
+  ptr[0] = (uint8_t) value;
+  ptr[1] = (uint8_t) (value >> 8);
+  ptr[2] = (uint8_t) (value >> 16);
+  ptr[3] = (uint8_t) (value >> 24);
+}
+
+
+
+static void put_f64_le (uint8_t *ptr, double value)
+{
+  uint64_t          bits;
+  int32_t           i;
+
+
+  memcpy (&bits, &value, sizeof (bits));
+
+  for (i = 0 ; i < 8 ; i++) ptr[i] = (uint8_t) (bits >> (8 * i));
+}
+
+
+
+/*  One little endian WKB LineString (part of the MultiLineString written by export_file).  */
+
+static void put_wkb (EXPORT_ROW *row, const int32_t *xy, int32_t count)
+{
+  uint8_t           *ptr;
+  int32_t           k, n;
+
+
+  n = MAX (count, 2);
+  ptr = row_reserve (row, 9 + 16 * (size_t) n);
+
+  ptr[0] = 1;
+  put_u32_le (&ptr[1], 2);
+  put_u32_le (&ptr[5], (uint32_t) n);
+
+  for (k = 0 ; k < n ; k++)
+    {
+      const int32_t *v = &xy[2 * MIN (k, count - 1)];
+
+      put_f64_le (&ptr[9 + 16 * k], (double) v[0] / POSITION_SCALE - 180.0);
+      put_f64_le (&ptr[17 + 16 * k], (double) v[1] / POSITION_SCALE - 90.0);
+    }
+
+  row->size += 9 + 16 * (size_t) n;
+}
+
+
+
+/*  One SHPT_ARC object for the shapefile writer.  lon and lat are work space for at least count + 1 vertices.  */
+
+static void put_shape (EXPORT_ROW *row, int32_t cell, int32_t segment, const int32_t *xy, int32_t count, double *lon,
+                       double *lat)
+{
+  int32_t           k, n;
+
+
+  if (row->num_shapes == row->shape_alloc)
+    {
+      row->shape_alloc = row->shape_alloc ? row->shape_alloc * 2 : 1024;
+
+      row->shape = (SHPObject **) realloc (row->shape, row->shape_alloc * sizeof (SHPObject *));
+      row->shape_cell = (int32_t *) realloc (row->shape_cell, row->shape_alloc * sizeof (int32_t));
+      row->shape_segment = (int32_t *) realloc (row->shape_segment, row->shape_alloc * sizeof (int32_t));
+      if (row->shape == NULL || row->shape_cell == NULL || row->shape_segment == NULL)
+        {
+          perror ("Allocating export memory");
+          exit (-1);
+        }
+    }
+
+  n = MAX (count, 2);
+
+  for (k = 0 ; k < n ; k++)
+    {
+      lon[k] = (double) xy[2 * MIN (k, count - 1)] / POSITION_SCALE - 180.0;
+      lat[k] = (double) xy[2 * MIN (k, count - 1) + 1] / POSITION_SCALE - 90.0;
+    }
+
+  row->shape[row->num_shapes] = SHPCreateObject (SHPT_ARC, -1, 0, NULL, NULL, n, lon, lat, NULL, NULL);
+  row->shape_cell[row->num_shapes] = cell;
+  row->shape_segment[row->num_shapes] = segment;
+  row->num_shapes++;
+}
+
+
+
+static void *export_thread (void *arg)
+{
+  EXPORT_POOL       *pool = (EXPORT_POOL *) arg;
+  EXPORT_ROW        *row;
+  int32_t           r, j, i, cell, num, nv, *count, *xy;
+  double            *lon, *lat;
+
+
+  count = (int32_t *) malloc ((size_t) MAX (pool->max_segments, 1) * sizeof (int32_t));
+  xy = (int32_t *) malloc ((size_t) MAX (pool->max_vertices, 1) * 2 * sizeof (int32_t));
+  lon = (double *) malloc ((size_t) (pool->max_vertices + 2) * sizeof (double));
+  lat = (double *) malloc ((size_t) (pool->max_vertices + 2) * sizeof (double));
+  if (count == NULL || xy == NULL || lon == NULL || lat == NULL)
+    {
+      perror ("Allocating export memory");
+      exit (-1);
+    }
+
+  while (NVTrue)
+    {
+      pthread_mutex_lock (&pool->mutex);
+      while (pool->next_row < CELL_ROWS && pool->next_row >= pool->written + pool->window)
+        pthread_cond_wait (&pool->row_written, &pool->mutex);
+      r = pool->next_row++;
+      pthread_mutex_unlock (&pool->mutex);
+
+      if (r >= CELL_ROWS) break;
+
+
+      row = &pool->row[r];
+
+      for (j = 0 ; j < CELL_COLS ; j++)
+        {
+          cell = r * CELL_COLS + j;
+
+          if (pool->options->region != NULL && !pool->options->region[cell]) continue;
+
+          if ((num = ccl_decode_cell_fixed (pool->ccl, pool->level, cell, count, pool->max_segments, xy,
+                                            pool->max_vertices)) < 0)
+            {
+              fprintf (stderr, "\n\nUnable to decode cell %d, the file is corrupt!\n\n", cell);
+              exit (-1);
+            }
+
+          for (i = 0, nv = 0 ; i < num ; i++)
+            {
+              switch (pool->format)
+                {
+                case EXPORT_GEOJSON:
+                  put_geojson (row, cell, pool->level, i, &xy[2 * nv], count[i]);
+                  break;
+
+                case EXPORT_WKB:
+                  put_wkb (row, &xy[2 * nv], count[i]);
+                  break;
+
+                case EXPORT_SHAPEFILE:
+                  put_shape (row, cell, i, &xy[2 * nv], count[i], lon, lat);
+                  break;
+                }
+
+              nv += count[i];
+            }
+
+          row->vertices += nv;
+        }
+
+
+      pthread_mutex_lock (&pool->mutex);
+      row->done = NVTrue;
+      pthread_cond_broadcast (&pool->row_done);
+      pthread_mutex_unlock (&pool->mutex);
+    }
+
+  free (count);
+  free (xy);
+  free (lon);
+  free (lat);
+
+  return (NULL);
+}
+
+
+
+static void write_bytes (FILE *fp, const void *data, size_t size, const char *name)
+{
+  if (size && fwrite (data, size, 1, fp) != 1)
+    {
+      perror (name);
+      exit (-1);
+    }
+}
+
+
+
+/*  --export.  Decode every cell of one level of detail (inside --bbox if it was given) of a .ccl file with
+    options->num_threads threads and write the segments, in cell order, to out_name as one of:
+
+        EXPORT_GEOJSON      A FeatureCollection with a LineString feature for each segment (the cell, level, and
+                            segment number within the cell are the properties).  Positions have the CCL_SCALE decimals
+                            that are stored.
+
+        EXPORT_WKB          One little endian WKB MultiLineString with a LineString for each segment.
+
+        EXPORT_SHAPEFILE    An SHPT_ARC shapefile with a shape for each segment and a .dbf with the CELL and SEGMENT
+                            number of each of them.
+
+    Segments with a single vertex (the piece of a line that just touches a cell) have that vertex repeated since a
+    line string needs two.  GeoJSON and WKB can be written to standard output by giving - as out_name.  */
+
+void export_file (const char *ccl_name, const char *out_name, int32_t format, int32_t level, const OPTIONS *options)
+{
+  EXPORT_POOL       pool;
+  EXPORT_ROW        *row;
+  CCL_FILE          *ccl;
+  FILE              *fp = NULL;
+  SHPHandle         shpHandle = NULL;
+  DBFHandle         dbfHandle = NULL;
+  pthread_t         *threads;
+  int32_t           i, r, cell, id, cell_field = 0, segment_field = 0, percent, old_percent;
+  int32_t           num_threads = MAX (options->num_threads, 1);
+  int64_t           segments, vertices;
+  uint8_t           header[9], first;
+
+
+  if ((ccl = ccl_open (ccl_name, 1)) == NULL)
+    {
+      fprintf (stderr, "\n\nUnable to open %s as a .ccl file\n\n", ccl_name);
+      exit (-1);
+    }
+
+  if (level < 0 || level >= ccl->num_levels)
+    {
+      fprintf (stderr, "\n\n%s only has %d levels of detail\n\n", ccl_name, ccl->num_levels);
+      exit (-1);
+    }
+
+
+  memset (&pool, 0, sizeof (EXPORT_POOL));
+  pool.ccl = ccl;
+  pool.options = options;
+  pool.level = level;
+  pool.format = format;
+  pool.window = EXPORT_WINDOW * num_threads;
+
+  segments = 0;
+
+  for (cell = 0 ; cell < CELL_COUNT ; cell++)
+    {
+      if (options->region != NULL && !options->region[cell]) continue;
+
+      pool.max_segments = MAX (pool.max_segments, ccl->level[level].num_segments[cell]);
+      pool.max_vertices = MAX (pool.max_vertices, ccl->level[level].num_vertices[cell]);
+      segments += ccl->level[level].num_segments[cell];
+    }
+
+
+  if (format == EXPORT_SHAPEFILE)
+    {
+      if ((shpHandle = SHPCreate (out_name, SHPT_ARC)) == NULL || (dbfHandle = DBFCreate (out_name)) == NULL)
+        {
+          perror (out_name);
+          exit (-1);
+        }
+
+      cell_field = DBFAddField (dbfHandle, "CELL", FTInteger, 6, 0);
+      segment_field = DBFAddField (dbfHandle, "SEGMENT", FTInteger, 9, 0);
+    }
+  else
+    {
+      if (!strcmp (out_name, "-"))
+        {
+          fp = stdout;
+
+#ifdef NVWIN3X
+          _setmode (_fileno (stdout), _O_BINARY);
+#endif
+        }
+      else if ((fp = fopen (out_name, "wb")) == NULL)
+        {
+          perror (out_name);
+          exit (-1);
+        }
+
+
+      /*  The number of line strings comes from the header so the WKB collection can be started right away.  */
+
+      if (format == EXPORT_GEOJSON)
+        {
+          fprintf (fp, "{\"type\": \"FeatureCollection\", \"features\": [");
+        }
+      else
+        {
+          header[0] = 1;
+          put_u32_le (&header[1], 5);
+          put_u32_le (&header[5], (uint32_t) segments);
+          write_bytes (fp, header, 9, out_name);
+        }
+    }
+
+
+  pthread_mutex_init (&pool.mutex, NULL);
+  pthread_cond_init (&pool.row_done, NULL);
+  pthread_cond_init (&pool.row_written, NULL);
+
+  threads = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+  if (threads == NULL)
+    {
+      perror ("Allocating thread memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < num_threads ; i++)
+    {
+      if (pthread_create (&threads[i], NULL, export_thread, &pool))
+        {
+          perror ("Creating export thread");
+          exit (-1);
+        }
+    }
+
+
+  /*  Write the rows in order as they finish.  */
+
+  first = NVTrue;
+  old_percent = -1;
+  vertices = 0;
+
+  for (r = 0 ; r < CELL_ROWS ; r++)
+    {
+      row = &pool.row[r];
+
+      pthread_mutex_lock (&pool.mutex);
+      while (!row->done) pthread_cond_wait (&pool.row_done, &pool.mutex);
+      pthread_mutex_unlock (&pool.mutex);
+
+      if (format == EXPORT_SHAPEFILE)
+        {
+          for (i = 0 ; i < row->num_shapes ; i++)
+            {
+              id = SHPWriteObject (shpHandle, -1, row->shape[i]);
+              DBFWriteIntegerAttribute (dbfHandle, id, cell_field, row->shape_cell[i]);
+              DBFWriteIntegerAttribute (dbfHandle, id, segment_field, row->shape_segment[i]);
+              SHPDestroyObject (row->shape[i]);
+            }
+
+          free (row->shape);
+          free (row->shape_cell);
+          free (row->shape_segment);
+        }
+      else if (row->size)
+        {
+          /*  Every GeoJSON feature starts with a separator, drop the very first one.  */
+
+          i = (format == EXPORT_GEOJSON && first) ? 1 : 0;
+
+          write_bytes (fp, row->data + i, row->size - i, out_name);
+
+          first = NVFalse;
+        }
+
+      vertices += row->vertices;
+      free (row->data);
+      row->data = NULL;
+      row->shape = NULL;
+
+
+      pthread_mutex_lock (&pool.mutex);
+      pool.written++;
+      pthread_cond_broadcast (&pool.row_written);
+      pthread_mutex_unlock (&pool.mutex);
+
+
+      percent = (int32_t) (((float) r / (CELL_ROWS - 1.0)) * 100.0);
+      if (percent != old_percent)
+        {
+          PROGRESS ("%03d%% exported\r", percent);
+          old_percent = percent;
+        }
+    }
+
+  for (i = 0 ; i < num_threads ; i++) pthread_join (threads[i], NULL);
+
+
+  if (format == EXPORT_SHAPEFILE)
+    {
+      SHPClose (shpHandle);
+      DBFClose (dbfHandle);
+    }
+  else
+    {
+      if (format == EXPORT_GEOJSON) fprintf (fp, "\n]}\n");
+
+      if (fp != stdout && fclose (fp))
+        {
+          perror (out_name);
+          exit (-1);
+        }
+      else if (fp == stdout)
+        {
+          fflush (fp);
+        }
+    }
+
+  PROGRESS ("\n\nExported %lld segments and %lld vertices from level %d of %s\n\n", (long long) segments,
+            (long long) vertices, level, ccl_name);
+
+  free (threads);
+  pthread_mutex_destroy (&pool.mutex);
+  pthread_cond_destroy (&pool.row_done);
+  pthread_cond_destroy (&pool.row_written);
+  ccl_close (ccl);
+}
@@ -0,0 +1,46 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#ifndef __EXPORT_H__
+#define __EXPORT_H__
+
+#include "build_coast.h"
+
+
+/*  --export formats.  */
+
+#define         EXPORT_GEOJSON      1
+#define         EXPORT_WKB          2
+#define         EXPORT_SHAPEFILE    3
+
+
+/*  Cells are decoded a row (CELL_COLS cells) at a time and each thread can be at most this many rows (times the
+    number of threads) ahead of the writer so the buffered output stays small.  */
+
+#define         EXPORT_WINDOW       4
+
+
+int32_t export_format (const char *name);
+void export_file (const char *ccl_name, const char *out_name, int32_t format, int32_t level, const OPTIONS *options);
+
+
+#endif
@@ -0,0 +1,146 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#include "index.h"
+#include "ccl_reader.h"
+
+
+
+/*  Write the sparse index (see ccl_format.h) of the finished .ccl file name.  The headers are read back from the file
+    with the reader (ignoring any old index) so this is the same for full and --incremental builds and the index can't
+    disagree with the file.  */
+
+void index_write (const char *name)
+{
+  CCL_FILE          *ccl;
+  CCL_LEVEL         *level;
+  FILE              *fp;
+  char              index_name[1024];
+  uint8_t           *buf, *map;
+  size_t            size, pos;
+  int32_t           i, cell, num, end;
+
+
+  if ((ccl = ccl_open_headers (name, 1)) == NULL)
+    {
+      fprintf (stderr, "Unable to open %s with the reader to index it\n", name);
+      exit (-1);
+    }
+
+
+  /*  Worst case is every cell populated in every level.  */
+
+  size = CCL_INDEX_HEADER_SIZE + (size_t) ccl->num_levels * (12 + CCL_INDEX_MAP_SIZE + (size_t) CELL_COUNT * 12);
+
+  if ((buf = (uint8_t *) calloc (1, size)) == NULL)
+    {
+      perror ("Allocating index memory");
+      exit (-1);
+    }
+
+  memcpy (buf, ccl->data, VERSION_SIZE);
+  memcpy (buf + VERSION_SIZE, CCL_INDEX_MAGIC, 4);
+
+  pos = (VERSION_SIZE + 4) * 8;
+  bit_pack (buf, pos, 32, CCL_INDEX_VERSION); pos += 32;
+  bit_pack (buf, pos, 32, (int32_t) ccl->size); pos += 32;
+  bit_pack (buf, pos, 32, ccl->num_levels); pos += 32;
+  bit_pack (buf, pos, 32, ccl->tile_block); pos += 32;
+  bit_pack (buf, pos, 32, ccl->tile_block_size); pos += 32;
+  bit_pack (buf, pos, 32, ccl->tile_threshold);
+
+  pos = CCL_INDEX_HEADER_SIZE;
+
+  for (i = 0 ; i < ccl->num_levels ; i++)
+    {
+      level = &ccl->level[i];
+
+
+      /*  The cells are back to back so the level ends where its last populated cell does.  */
+
+      num = end = 0;
+
+      for (cell = 0 ; cell < CELL_COUNT ; cell++)
+        {
+          if (level->address[cell])
+            {
+              num++;
+              end = level->address[cell] + level->cell_size[cell];
+            }
+        }
+
+      bit_pack (buf, (uint32_t) pos * 8, 32, level->tolerance);
+      bit_pack (buf, (uint32_t) (pos + 4) * 8, 32, end);
+      bit_pack (buf, (uint32_t) (pos + 8) * 8, 32, num);
+
+      map = buf + pos + 12;
+      pos += 12 + CCL_INDEX_MAP_SIZE;
+
+      for (cell = 0 ; cell < CELL_COUNT ; cell++)
+        {
+          if (!level->address[cell]) continue;
+
+          map[cell >> 3] |= 0x80 >> (cell & 7);
+
+          bit_pack (buf, (uint32_t) pos * 8, 32, level->address[cell]);
+          bit_pack (buf, (uint32_t) (pos + 4) * 8, 32, level->num_segments[cell]);
+          bit_pack (buf, (uint32_t) (pos + 8) * 8, 32, level->num_vertices[cell]);
+          pos += 12;
+        }
+    }
+
+  ccl_close (ccl);
+
+
+  ccl_index_name (name, index_name, sizeof (index_name));
+
+  if ((fp = fopen (index_name, "wb")) == NULL)
+    {
+      perror (index_name);
+      exit (-1);
+    }
+
+  if (fwrite (buf, pos, 1, fp) != 1 || fclose (fp))
+    {
+      perror (index_name);
+      exit (-1);
+    }
+
+  PROGRESS ("Wrote %s (%.1f KB)\n\n", index_name, (double) pos / 1024.0);
+
+  free (buf);
+}
+
+
+
+/*  Remove the index of name (if there is one) when name is rebuilt without --index, so that an old index can't be
+    mistaken for one of the new file.  */
+
+void index_remove (const char *name)
+{
+  char              index_name[1024];
+
+
+  ccl_index_name (name, index_name, sizeof (index_name));
+
+  remove (index_name);
+}
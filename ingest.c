@@ -0,0 +1,715 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "ingest.h"
+#include "prefetch.h"
+#include "stats.h"
+
+
+void segment_state_init (SEGMENT_STATE *state)
+{
+  state->seg = NULL;
+  state->segCount = 0;
+  state->seg_size = 0;
+  state->londeg[0] = -999;
+  state->londeg[1] = -999;
+  state->latdeg[0] = -999;
+  state->latdeg[1] = -999;
+  state->lon[0] = -999;
+  state->lon[1] = -999;
+  state->lat[0] = -999;
+  state->lat[1] = -999;
+  state->cell_lon = -999;
+  state->cell_lat = -999;
+  state->segments = 0;
+  state->crossings = 0;
+
+  quant_buffer_init (&state->quant);
+}
+
+
+
+void segment_state_free (SEGMENT_STATE *state)
+{
+  if (state->seg != NULL) free (state->seg);
+
+  state->seg = NULL;
+  state->seg_size = 0;
+
+  quant_buffer_free (&state->quant);
+}
+
+
+
+/*  Double the size of the segment buffer.  It is never shrunk, starting a new segment just resets the count, so after
+    the first few segments we don't allocate anything in the vertex loop.  */
+
+static void segment_grow (SEGMENT_STATE *state, int32_t **seg)
+{
+  state->seg_size = state->seg_size ? state->seg_size * 2 : 1024;
+
+  state->seg = (int32_t *) realloc (state->seg, (1 + 2 * (size_t) state->seg_size) * sizeof (int32_t));
+  if (state->seg == NULL)
+    {
+      perror ("Allocating segment memory");
+      exit (-1);
+    }
+
+  *seg = state->seg;
+}
+
+
+
+/*  Finish the segment record (store the count in front of the vertices) and add it to the store in one piece.  */
+
+static void segment_close (CELL_STORE *store, SEGMENT_STATE *state, int32_t *seg, int32_t segCount)
+{
+  if (!segCount) return;
+
+  seg[0] = segCount;
+
+  state->segments++;
+
+  cell_store_add (store, state->cell_lon, state->cell_lat, seg);
+}
+
+
+
+/*  Split all of the vertices of a shape (from shapelib or the memory mapped reader) into segments by one-degree cell and add the finished segments to the store.
+    The vertices are quantized to fixed point positions and cells and split at the antimeridian up front (see
+    quantize.c) so the splitter only deals with integers and never has to think about the edges of the grid.  The
+    segment that is in progress when we run out of vertices is carried over to the next shape in state.  */
+
+void ingest_shape (CELL_STORE *store, SEGMENT_STATE *state, const SHAPE_VIEW *shape)
+{
+  int32_t           j, numParts, segCount = state->segCount, *seg = state->seg;
+  int32_t           *londeg = state->londeg, *latdeg = state->latdeg;
+  int32_t           *lon = state->lon, *lat = state->lat;
+  QUANT_BUFFER      *quant = &state->quant;
+  uint8_t           start_segment;
+
+
+  /*  Get all vertices  */
+
+  if (shape->nVertices >= 2)
+    {
+      quantize_shape (shape, quant);
+
+      for (j = 0, numParts = 0 ; j < quant->count ; j++)
+        {
+          /*  Check for the start of a new segment, either the start of the shape or a new group of points inside it
+              (this would be a "Ring" point or the second half of an antimeridian crossing).  */
+
+          start_segment = NVFalse;
+
+          if (numParts < quant->num_parts && quant->part[numParts] == j)
+            {
+              start_segment = NVTrue;
+              numParts++;
+            }
+
+
+          /*  Positions are biased by 180/90 so that all points are positive and have already been wrapped and clamped
+              to the grid.  */
+
+          lon[1] = quant->lon[j];
+          lat[1] = quant->lat[j];
+          londeg[1] = quant->londeg[j];
+          latdeg[1] = quant->latdeg[j];
+
+
+          /*  Changed cells (but not first time through)  */
+
+          if (latdeg[0] > -999 && (latdeg[1] != latdeg[0] || londeg[1] != londeg[0]))
+            {
+              /*  Start a new segment in a new cell  */
+
+              if (start_segment)
+                {
+                  /*  Close last segment, don't add point, start new segment in new cell  */
+
+                  segment_close (store, state, seg, segCount);
+
+                  state->cell_lon = londeg[1];
+                  state->cell_lat = latdeg[1];
+
+                  segCount = 0;
+                }
+              else
+                {
+                  /*  Add point to last segment, close last segment, start new segment in new cell with last point 
+                      as first point in new segment  */
+
+                  state->crossings++;
+
+                  if (segCount == state->seg_size) segment_grow (state, &seg);
+
+                  seg[1 + 2 * segCount] = lon[0];
+                  seg[2 + 2 * segCount] = lat[0];
+
+                  segCount++; 
+
+                  segment_close (store, state, seg, segCount);
+
+                  state->cell_lon = londeg[1];
+                  state->cell_lat = latdeg[1];
+
+
+                  /*  Add last point to current segment  */
+
+                  segCount = 0;
+
+                  seg[1 + 2 * segCount] = lon[0];
+                  seg[2 + 2 * segCount] = lat[0];
+
+                  segCount++;
+                }
+            }
+          else
+            {
+              /*  Start a new segment but not in a new cell  */
+
+              if (start_segment)
+                {
+                  /*  First time through set the first cell  */
+
+                  if (latdeg[0] == -999)
+                    {
+                      state->cell_lon = londeg[1];
+                      state->cell_lat = latdeg[1];
+                    }
+                  else
+                    {
+                      /*  Close last segment, start new segment  */
+
+                      segment_close (store, state, seg, segCount);
+
+                      segCount = 0;
+                    }
+                }
+            }
+
+
+          if (segCount == state->seg_size) segment_grow (state, &seg);
+
+
+          /*  Add point to current segment  */
+
+          seg[1 + 2 * segCount] = lon[1];
+          seg[2 + 2 * segCount] = lat[1];
+
+          segCount++;
+
+
+          londeg[0] = londeg[1];
+          latdeg[0] = latdeg[1];
+          lon[0] = lon[1];
+          lat[0] = lat[1];
+        }
+    }
+
+  state->seg = seg;
+  state->segCount = segCount;
+}
+
+
+
+/*  Close the last segment at the end of an input file (or shape range).  */
+
+void ingest_finish (CELL_STORE *store, SEGMENT_STATE *state)
+{
+  segment_close (store, state, state->seg, state->segCount);
+
+
+  /*  Zero the count so that the first segment of the next file doesn't write it again and force it to start a new
+      segment.  */
+
+  state->segCount = 0;
+  state->latdeg[0] = -888;
+}
+
+
+
+/*  One contiguous range of shapes from one input file.  Each task is split into segments in its own cell store and the
+    stores are merged into the main store in task order, so the segment order in every cell is the same as if we had
+    read the files one shape at a time.  */
+
+typedef struct
+{
+  int32_t           file;               /*  Index of the input file  */
+  int32_t           first_shape;        /*  First shape in the range  */
+  int32_t           end_shape;          /*  One past the last shape in the range  */
+  int32_t           num_shapes;         /*  Number of shapes in the whole file  */
+  int32_t           total;              /*  Number of vertices read  */
+  int32_t           shapes;             /*  Number of shapes split  */
+  int32_t           skipped;            /*  Number of shapes skipped by --bbox  */
+  int64_t           segments;           /*  Segments and cell crossings (see SEGMENT_STATE)  */
+  int64_t           crossings;
+  int64_t           stalls;             /*  Times the splitter waited for the prefetch reader  */
+  CELL_STORE        store;              /*  Task local cell store  */
+  uint8_t           slice;              /*  NVTrue when the task is waiting for the part it has done to be merged  */
+  uint8_t           done;               /*  NVTrue when the task store is ready to merge  */
+} INGEST_TASK;
+
+
+typedef struct
+{
+  char              **files;
+  OPTIONS           *options;
+  const uint8_t     *filter;
+  INGEST_TASK       *task;
+  int32_t           num_tasks;
+  int32_t           next_task;
+  int32_t           merged;             /*  Number of tasks merged into the main store  */
+  size_t            pending;            /*  Bytes held by finished tasks that haven't been merged yet  */
+  size_t            window;             /*  Limit on pending before the threads wait for the merge  */
+  size_t            slice;              /*  Bytes a running task may hold before it hands them to the merge  */
+  int64_t           waits;              /*  Times a thread waited for the merge to catch up  */
+  pthread_mutex_t   mutex;
+  pthread_cond_t    task_done;
+  pthread_cond_t    task_merged;
+} INGEST_POOL;
+
+
+
+/*  Shape types that always have part starts.  Files of these types can be split into shape ranges since every shape
+    starts a new segment.  Any other type is read as a single task.  */
+
+static uint8_t splittable_type (int32_t type)
+{
+  switch (type)
+    {
+    case SHPT_ARC:
+    case SHPT_POLYGON:
+    case SHPT_ARCZ:
+    case SHPT_POLYGONZ:
+    case SHPT_ARCM:
+    case SHPT_POLYGONM:
+    case SHPT_MULTIPATCH:
+      return (NVTrue);
+    }
+
+  return (NVFalse);
+}
+
+
+
+/*  Check the bounds of a file or shape against the --bbox cells.  Any vertex that ends up in one of those cells has
+    to be inside the bounds, or inside them after the wrap by 360 that quantize.c does for longitudes past 180 or -180
+    (files that use 0 to 360).  */
+
+static uint8_t region_overlaps (const OPTIONS *options, double xmin, double ymin, double xmax, double ymax)
+{
+  const double      *bounds = options->region_bounds;
+
+
+  if (options->region == NULL) return (NVTrue);
+
+  if (ymax < bounds[1] || ymin > bounds[3]) return (NVFalse);
+
+  if (xmax >= bounds[0] && xmin <= bounds[2]) return (NVTrue);
+
+  if (xmax > 180.0 && xmax - 360.0 >= bounds[0] && xmin - 360.0 <= bounds[2]) return (NVTrue);
+
+  if (xmin < -180.0 && xmax + 360.0 >= bounds[0] && xmin + 360.0 <= bounds[2]) return (NVTrue);
+
+  return (NVFalse);
+}
+
+
+
+/*  A shape can only be skipped if it has parts.  Shapes without parts (multipoints) carry their last segment on to the
+    next shape so we have to split them even if none of their own vertices are kept.  */
+
+static uint8_t skip_shape (const OPTIONS *options, const SHAPE_VIEW *view)
+{
+  return (options->region != NULL && view->nParts > 0 &&
+          !region_overlaps (options, view->dfXMin, view->dfYMin, view->dfXMax, view->dfYMax));
+}
+
+
+
+/*  A running task has gone past its share of the memory window.  Hand what it has to the merge (which only takes it
+    when every task before this one has been merged, so the segment order doesn't change) and wait until the store
+    has been emptied.  The segment in progress is in the segment state, not the store, so nothing is split.  */
+
+static void hand_off (INGEST_POOL *pool, INGEST_TASK *task)
+{
+  pthread_mutex_lock (&pool->mutex);
+
+  task->slice = NVTrue;
+  pthread_cond_broadcast (&pool->task_done);
+
+  while (task->slice) pthread_cond_wait (&pool->task_merged, &pool->mutex);
+
+  pthread_mutex_unlock (&pool->mutex);
+}
+
+
+
+static void *ingest_thread (void *arg)
+{
+  INGEST_POOL       *pool = (INGEST_POOL *) arg;
+  INGEST_TASK       *task;
+  SEGMENT_STATE     state;
+  SHAPE_PREFETCH    prefetch;
+  SHPObject         *shape;
+  SHP_MAP           map;
+  SHAPE_VIEW        view;
+  int32_t           t, i;
+
+
+  while (NVTrue)
+    {
+      /*  Every finished task is held in memory until its turn to be merged, so don't get too far ahead of the merge.
+          The next task to be merged is never held up.  */
+
+      pthread_mutex_lock (&pool->mutex);
+
+      if (pool->pending > pool->window && pool->next_task > pool->merged)
+        {
+          pool->waits++;
+          while (pool->pending > pool->window && pool->next_task > pool->merged)
+            pthread_cond_wait (&pool->task_merged, &pool->mutex);
+        }
+
+      t = pool->next_task++;
+      pthread_mutex_unlock (&pool->mutex);
+
+      if (t >= pool->num_tasks) break;
+
+
+      task = &pool->task[t];
+
+
+      /*  The task store never spills on its own.  The memory budget is enforced when it is merged, and the task
+          hands its store to the merge in slices if it gets bigger than pool->slice.  */
+
+      cell_store_init (&task->store, (size_t) -1);
+      task->store.filter = pool->filter;
+      segment_state_init (&state);
+
+
+      /*  Walk the records in place if we can map the files.  */
+
+      if (pool->options->use_mmap && shp_map_open (&map, pool->files[task->file]))
+        {
+          for (i = task->first_shape ; i < task->end_shape ; i++)
+            {
+              if (pool->options->prefetch) shp_map_prefetch (&map, i);
+
+              if (!shp_map_shape (&map, i, &view)) continue;
+
+
+              /*  The bounds come from the record header so a shape outside of --bbox costs nothing.  */
+
+              if (skip_shape (pool->options, &view))
+                {
+                  task->skipped++;
+                  continue;
+                }
+
+              task->total += view.nVertices;
+              task->shapes++;
+
+              ingest_shape (&task->store, &state, &view);
+
+              if (task->store.bytes > pool->slice) hand_off (pool, task);
+            }
+
+          shp_map_close (&map);
+        }
+      else
+        {
+          /*  Shapelib handles can't be shared between threads so each task opens its own.  The shapes are read
+              and decoded on another thread (--prefetch) so that we aren't waiting on the disk and the allocations
+              while we split.  */
+
+          prefetch_open (&prefetch, pool->files[task->file], task->first_shape, task->end_shape,
+                         pool->options->prefetch);
+
+          while ((shape = prefetch_next (&prefetch)) != NULL)
+            {
+              shape_view_from_object (shape, &view);
+
+              if (skip_shape (pool->options, &view))
+                {
+                  task->skipped++;
+                  SHPDestroyObject (shape);
+                  continue;
+                }
+
+              task->total += shape->nVertices;
+              task->shapes++;
+
+              ingest_shape (&task->store, &state, &view);
+
+              SHPDestroyObject (shape);
+
+              if (task->store.bytes > pool->slice) hand_off (pool, task);
+            }
+
+          task->stalls = prefetch.stalls;
+
+          prefetch_close (&prefetch);
+        }
+
+      ingest_finish (&task->store, &state);
+
+      task->segments = state.segments;
+      task->crossings = state.crossings;
+
+      segment_state_free (&state);
+
+
+      pthread_mutex_lock (&pool->mutex);
+      task->done = NVTrue;
+      pool->pending += task->store.bytes;
+      pthread_cond_broadcast (&pool->task_done);
+      pthread_mutex_unlock (&pool->mutex);
+    }
+
+  return (NULL);
+}
+
+
+
+/*  Pass 1.  Read all of the input shape files and bucket their segments by cell in store.  Each file is split into
+    ranges of shapes that are read by options->num_threads threads, and the results are merged in file/shape order.
+    Only the cells allowed by store->filter (if set) are kept.  If file_cells is not NULL it must have num_files *
+    CELL_COUNT entries and the cells that each file added segments to are set to NVTrue.  Returns the total number of
+    points read.  */
+
+int32_t ingest_files (CELL_STORE *store, char **files, int32_t num_files, OPTIONS *options, uint8_t *file_cells)
+{
+  INGEST_POOL       pool;
+  INGEST_TASK       *task;
+  pthread_t         *threads;
+  SHPHandle         shpHandle;
+  int32_t           i, m, t, numShapes, type, tasks_per_file, shapes_per_task, total, percent, cell, span = -1;
+  uint8_t           done;
+  int32_t           num_threads = MAX (options->num_threads, 1);
+  double            minBounds[4], maxBounds[4];
+
+
+  /*  Build the task list.  */
+
+  pool.files = files;
+  pool.options = options;
+  pool.filter = store->filter;
+  pool.task = NULL;
+  pool.num_tasks = 0;
+  pool.next_task = 0;
+  pool.merged = 0;
+  pool.pending = 0;
+  pool.window = options->max_memory / MEMORY_WINDOW_SHARE / 2;
+  pool.waits = 0;
+
+  for (m = 0 ; m < num_files ; m++)
+    {
+      if ((shpHandle = SHPOpen (files[m], "rb")) == NULL)
+        {
+          perror (files[m]);
+          exit (-1);
+        }
+
+      SHPGetInfo (shpHandle, &numShapes, &type, minBounds, maxBounds);
+
+      SHPClose (shpHandle);
+
+
+      /*  Since every task starts with a clean segment state we can drop a whole file that is outside of --bbox.  */
+
+      if (!region_overlaps (options, minBounds[0], minBounds[1], maxBounds[0], maxBounds[1]))
+        {
+          PROGRESS ("\n\nSkipping %s, it is outside of the bounding box\n", files[m]);
+          continue;
+        }
+
+      run_stats.files++;
+
+
+      tasks_per_file = 1;
+
+      if (num_threads > 1 && splittable_type (type))
+        {
+          tasks_per_file = MIN (num_threads * 2, numShapes / MIN_TASK_SHAPES);
+          if (tasks_per_file < 1) tasks_per_file = 1;
+        }
+
+      shapes_per_task = (numShapes + tasks_per_file - 1) / tasks_per_file;
+      if (shapes_per_task < 1) shapes_per_task = 1;
+
+
+      pool.task = (INGEST_TASK *) realloc (pool.task, (pool.num_tasks + tasks_per_file) * sizeof (INGEST_TASK));
+      if (pool.task == NULL)
+        {
+          perror ("Allocating ingest task memory");
+          exit (-1);
+        }
+
+      for (t = 0 ; t < tasks_per_file ; t++)
+        {
+          task = &pool.task[pool.num_tasks++];
+
+          memset (task, 0, sizeof (INGEST_TASK));
+          task->file = m;
+          task->num_shapes = numShapes;
+          task->first_shape = MIN (t * shapes_per_task, numShapes);
+          task->end_shape = MIN ((t + 1) * shapes_per_task, numShapes);
+        }
+    }
+
+
+  pthread_mutex_init (&pool.mutex, NULL);
+  pthread_cond_init (&pool.task_done, NULL);
+  pthread_cond_init (&pool.task_merged, NULL);
+
+  num_threads = MIN (num_threads, pool.num_tasks);
+
+
+  /*  Half of the window is for the finished tasks waiting to be merged and the other half is shared by the running
+      tasks.  */
+
+  pool.slice = pool.window / MAX (num_threads, 1);
+
+  threads = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+  if (threads == NULL)
+    {
+      perror ("Allocating thread memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < num_threads ; i++)
+    {
+      if (pthread_create (&threads[i], NULL, ingest_thread, &pool))
+        {
+          perror ("Creating ingest thread");
+          exit (-1);
+        }
+    }
+
+
+  /*  Merge the task stores in order as they finish.  */
+
+  total = 0;
+
+  for (t = 0 ; t < pool.num_tasks ; t++)
+    {
+      task = &pool.task[t];
+
+      if (!t || task->file != pool.task[t - 1].file)
+        {
+          PROGRESS ("\n\nReading %s\n\n", files[task->file]);
+
+          cell_store_mark_file (store, task->file);
+
+          span = stats_span_begin ("read %s", files[task->file]);
+        }
+
+
+      /*  Take the slices the task hands over (see hand_off) until it is done.  The task's thread is waiting while we
+          look at its store.  */
+
+      while (NVTrue)
+        {
+          pthread_mutex_lock (&pool.mutex);
+          while (!task->done && !task->slice) pthread_cond_wait (&pool.task_done, &pool.mutex);
+          done = task->done;
+          pthread_mutex_unlock (&pool.mutex);
+
+
+          if (file_cells != NULL)
+            {
+              for (i = 0 ; i < task->store.num_dirty ; i++)
+                {
+                  cell = task->store.dirty[i];
+                  if (task->store.bucket[cell].count) file_cells[(size_t) task->file * CELL_COUNT + cell] = NVTrue;
+                }
+            }
+
+          cell_store_merge (store, &task->store);
+
+          if (done) break;
+
+
+          cell_store_empty (&task->store);
+
+          pthread_mutex_lock (&pool.mutex);
+          task->slice = NVFalse;
+          pthread_cond_broadcast (&pool.task_merged);
+          pthread_mutex_unlock (&pool.mutex);
+
+          stats_poll ();
+        }
+
+      pthread_mutex_lock (&pool.mutex);
+      pool.pending -= task->store.bytes;
+      pool.merged = t + 1;
+      pthread_cond_broadcast (&pool.task_merged);
+      pthread_mutex_unlock (&pool.mutex);
+
+      cell_store_free (&task->store);
+
+      total += task->total;
+
+      run_stats.shapes += task->shapes;
+      run_stats.shapes_skipped += task->skipped;
+      run_stats.vertices += task->total;
+      run_stats.segments += task->segments;
+      run_stats.crossings += task->crossings;
+      run_stats.prefetch_stalls += task->stalls;
+
+
+      if (t == pool.num_tasks - 1 || pool.task[t + 1].file != task->file)
+        {
+          PROGRESS ("100%% processed\n\n");
+          PROGRESS ("Total points processed = %d\n\n", total);
+
+          stats_span_end (span);
+        }
+      else
+        {
+          percent = (int32_t) (((float) task->end_shape / (float) task->num_shapes) * 100.0);
+          PROGRESS ("%03d%% processed\r", percent);
+        }
+
+      stats_poll ();
+    }
+
+
+  for (i = 0 ; i < num_threads ; i++) pthread_join (threads[i], NULL);
+
+  cell_store_mark_file (store, num_files);
+
+  run_stats.memory_waits += pool.waits;
+
+  free (threads);
+  free (pool.task);
+
+  pthread_mutex_destroy (&pool.mutex);
+  pthread_cond_destroy (&pool.task_done);
+  pthread_cond_destroy (&pool.task_merged);
+
+  return (total);
+}
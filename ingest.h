@@ -0,0 +1,66 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __INGEST_H__
+#define __INGEST_H__
+
+#include <pthread.h>
+
+#include "build_coast.h"
+#include "cell_store.h"
+#include "shp_map.h"
+#include "quantize.h"
+
+
+/*  Smallest number of shapes we'll put in one ingest task when splitting a file into shape ranges.  */
+
+#define         MIN_TASK_SHAPES     256
+
+
+/*  State carried from vertex to vertex (and shape to shape) while splitting polylines into one-degree cell segments.  */
+
+typedef struct
+{
+  int32_t       *seg;                   /*  Current segment record (count slot followed by lon/lat pairs)  */
+  int32_t       segCount;               /*  Number of vertices in the current segment  */
+  int32_t       seg_size;               /*  Number of vertices allocated in seg  */
+  int32_t       londeg[2];              /*  Cell of the previous [0] and current [1] vertex  */
+  int32_t       latdeg[2];
+  int32_t       lon[2];                 /*  Fixed point biased position of the previous [0] and current [1] vertex  */
+  int32_t       lat[2];
+  int32_t       cell_lon;               /*  Cell that the current segment belongs to  */
+  int32_t       cell_lat;
+  QUANT_BUFFER  quant;                  /*  Quantized vertices of the current shape  */
+  int64_t       segments;               /*  Number of segments closed (run statistics)  */
+  int64_t       crossings;              /*  Number of times a line crossed into another cell (run statistics)  */
+} SEGMENT_STATE;
+
+
+void segment_state_init (SEGMENT_STATE *state);
+void segment_state_free (SEGMENT_STATE *state);
+void ingest_shape (CELL_STORE *store, SEGMENT_STATE *state, const SHAPE_VIEW *shape);
+void ingest_finish (CELL_STORE *store, SEGMENT_STATE *state);
+int32_t ingest_files (CELL_STORE *store, char **files, int32_t num_files, OPTIONS *options, uint8_t *file_cells);
+
+
+#endif
@@ -0,0 +1,164 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "job.h"
+
+
+
+/*  Report a problem with line number line of the job file and give up.  */
+
+static void job_error (const char *name, int32_t line, const char *message, const char *text)
+{
+  fprintf (stderr, "%s line %d: %s (%s)\n\n", name, line, message, text);
+  exit (-1);
+}
+
+
+
+/*  Parse an inputs= list (1 based, comma separated) into num_inputs flags.  */
+
+static uint8_t *parse_inputs (const char *name, int32_t line, const char *text, int32_t num_inputs)
+{
+  uint8_t           *inputs;
+  const char        *ptr = text;
+  int32_t           input, n;
+
+
+  if ((inputs = (uint8_t *) calloc (num_inputs, 1)) == NULL)
+    {
+      perror ("Allocating job memory");
+      exit (-1);
+    }
+
+  while (NVTrue)
+    {
+      if (sscanf (ptr, "%d%n", &input, &n) != 1 || input < 1 || input > num_inputs)
+        job_error (name, line, "inputs must be input file numbers from 1 to the number of input files", text);
+
+      inputs[input - 1] = NVTrue;
+
+      ptr += n;
+      if (*ptr == 0) break;
+      if (*ptr++ != ',') job_error (name, line, "inputs must be a comma separated list", text);
+    }
+
+  return (inputs);
+}
+
+
+
+/*  Read the job file name (see job.h) for a build with num_inputs input files.  Returns the number of outputs, which
+    are put in a new array in jobs (free it with job_free).  Any problem with the file is fatal since there's no
+    sensible way to guess what was meant.  */
+
+int32_t job_read (const char *name, int32_t num_inputs, JOB **jobs)
+{
+  FILE              *fp;
+  JOB               *job, *list = NULL;
+  char              text[2048], *token;
+  int32_t           num_jobs = 0, line = 0, i, len;
+
+
+  if ((fp = fopen (name, "r")) == NULL)
+    {
+      perror (name);
+      exit (-1);
+    }
+
+  while (fgets (text, sizeof (text), fp) != NULL)
+    {
+      line++;
+
+      if ((token = strtok (text, " \t\r\n")) == NULL || token[0] == '#') continue;
+
+
+      if ((list = (JOB *) realloc (list, (num_jobs + 1) * sizeof (JOB))) == NULL)
+        {
+          perror ("Allocating job memory");
+          exit (-1);
+        }
+
+      job = &list[num_jobs];
+      memset (job, 0, sizeof (JOB));
+
+      if (!strcmp (token, "-")) job_error (name, line, "outputs can't be written to standard output", token);
+
+      len = strlen (token);
+      if (len + 5 > (int32_t) sizeof (job->name)) job_error (name, line, "output file name is too long", token);
+
+      strcpy (job->name, token);
+      if (len < 4 || strcmp (&job->name[len - 4], ".ccl")) strcat (job->name, ".ccl");
+
+      for (i = 0 ; i < num_jobs ; i++)
+        if (!strcmp (list[i].name, job->name)) job_error (name, line, "output is already in the job file", token);
+
+
+      while ((token = strtok (NULL, " \t\r\n")) != NULL)
+        {
+          if (!strncmp (token, "inputs=", 7) && job->inputs == NULL)
+            {
+              job->inputs = parse_inputs (name, line, &token[7], num_inputs);
+            }
+          else if (!strncmp (token, "bbox=", 5) && !job->use_bbox)
+            {
+              if (sscanf (&token[5], "%lf,%lf,%lf,%lf", &job->bbox[0], &job->bbox[1], &job->bbox[2], &job->bbox[3]) != 4 ||
+                  job->bbox[0] < -180.0 || job->bbox[2] > 180.0 || job->bbox[1] < -90.0 || job->bbox[3] > 90.0 ||
+                  job->bbox[0] >= job->bbox[2] || job->bbox[1] >= job->bbox[3])
+                job_error (name, line, "bbox must be west,south,east,north in degrees", token);
+
+              job->use_bbox = NVTrue;
+            }
+          else
+            {
+              job_error (name, line, "expected inputs=N,N,... or bbox=W,S,E,N (once each)", token);
+            }
+        }
+
+      num_jobs++;
+    }
+
+  fclose (fp);
+
+
+  if (!num_jobs)
+    {
+      fprintf (stderr, "%s doesn't list any outputs\n\n", name);
+      exit (-1);
+    }
+
+  *jobs = list;
+
+  return (num_jobs);
+}
+
+
+
+void job_free (JOB *jobs, int32_t num_jobs)
+{
+  int32_t           i;
+
+
+  for (i = 0 ; i < num_jobs ; i++) if (jobs[i].inputs != NULL) free (jobs[i].inputs);
+
+  free (jobs);
+}
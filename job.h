@@ -0,0 +1,50 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __JOB_H__
+#define __JOB_H__
+
+#include "build_coast.h"
+
+
+/*  One output of a --job build.  Each non-blank line of the job file that doesn't start with # is
+
+        OUTPUT_FILE [inputs=N,N,...] [bbox=W,S,E,N]
+
+    where the inputs are the positions (starting at 1) of the input files on the command line.  An output gets all of
+    the inputs if inputs= is left out and the --bbox box (or the whole world) if bbox= is left out.  */
+
+typedef struct
+{
+  char          name[512];              /*  Output file name (with the .ccl extension)  */
+  uint8_t       *inputs;                /*  Flags for each input file that goes into this output, NULL for all  */
+  uint8_t       use_bbox;               /*  NVTrue if bbox was given for this output  */
+  double        bbox[4];                /*  West, south, east, north  */
+} JOB;
+
+
+int32_t job_read (const char *name, int32_t num_inputs, JOB **jobs);
+void job_free (JOB *jobs, int32_t num_jobs);
+
+
+#endif
@@ -21,15 +21,25 @@
 
 *********************************************************************************************/
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <errno.h>
-#include <math.h>
-#include <string.h>
+#include "build_coast.h"
+#include "cell_store.h"
+#include "encode.h"
+#include "ingest.h"
+#include "manifest.h"
+#include "prefetch.h"
+#include "stats.h"
+#include "verify.h"
+#include "export.h"
+#include "index.h"
+#include "job.h"
+
+#include <getopt.h>
+
+#ifdef NVWIN3X
+#include <io.h>
+#include <fcntl.h>
+#endif
 
-#include "nvutility.h"
-
-#include "shapefil.h"
 #include "version.h"
 
 
@@ -72,7 +82,8 @@
                    west to east, south to north beginning at -90/-180.  That is, the first cell is -90/-180, the next is 
                    -90/-179, etc. until we reach -90/179 at which point we go to -89/-180 and so on.  We add 90 to all
                    latitudes and 180 to all longitudes so that we can work in positive numbers so, in essence we really
-                   go from 0/0 to 89/359.
+                   go from 0/0 to 89/359.  Points at exactly 180 longitude or 90 latitude (or -90) are stored in the
+                   last column (or the first and last rows), on the edge of the cell.
 
 
                Cell records:
@@ -112,6 +123,15 @@
                    savings in storage are pretty minimal anyway.
 
 
+               The layout constants are in ccl_format.h.  ccl_reader.c (with ccl_reader.h, ccl_format.h, and
+               bit_reader.h) is a stand alone random access reader for the format that can be used by other programs.
+
+               Everything above is the default profile.  build_coast (and the reader) can also be built for 0.5, 2, or
+               5 degree cells and for positions in 1e-4 or 1e-6 degrees (CCL_GRID and CCL_SCALE in ccl_format.h).
+               The layout is the same with CELL_ROWS X CELL_COLS header entries, start and bias fields wide enough
+               for the scale, and "(<cell degrees> <resolution>)" after the version number in the version block.
+
+
   Caveats:     Requires shapelib version 1.2.10 or newer (many thanks to Frank Warmerdam for the library).
 
 
@@ -119,585 +139,1106 @@
 
                    build_coast gshhs_land.shp gshhs_lake.shp gshhs_isle.shp gshhs_pond.shp gshhs_all.ccl
 
+               If the output file name is - the .ccl file is written to standard output so that it can be piped
+               straight into another program.  Since a pipe can't be rewound the packed cells are held in memory until
+               all of them are done and then the version, header, and cell records are written in order.  All messages
+               go to standard error in that case.
+
+
+  Options:     --max-memory MB     Maximum number of megabytes of segment and packed cell data to hold in memory
+                                   (default 1024).  The segments for each cell are bucketed in memory and only
+                                   spilled to a single scratch file (as chains of fixed size chunks for each cell) if
+                                   the store gets past 7/8 of this.  The other 1/8 is for the ingest tasks in pass 1
+                                   (half for the finished ones waiting to be merged, half split between the running
+                                   ones, which hand what they have to the merge in slices) and the cells packed ahead
+                                   of the writer in pass 2; the threads wait for the merge or the writer when they get
+                                   that far ahead.  The
+                                   levels of detail, the quadtrees, and (when writing to standard output) the full
+                                   resolution cells have to be held until the end of the file.  They are spooled to a
+                                   second scratch file whenever they, the store, and the packed cells add up to more
+                                   than this.  Setting it to 0 forces everything through the scratch files.  The
+                                   --prefetch batches (up to 8MB of decoded shapes each, for each thread) and the
+                                   buffers each thread works in are not counted.
+
+               --threads N         Number of threads used to read the input files in pass 1 and to pack the cells in
+                                   pass 2 (default is the number of processors).  Input files are split into ranges of
+                                   shapes and the cells are always written in the same order so the output file is
+                                   identical regardless of the number of threads.
+
+               --mmap              Read the .shp/.shx files by memory mapping them and walking the records in place
+                                   instead of reading (and allocating) every shape with shapelib.  Falls back to
+                                   shapelib if the files can't be mapped (or on Windows).
+
+               --prefetch N        Number of batches of shapes (256 shapes or 256K vertices each) that are read ahead
+                                   of the segment splitter (default 4).  Each ingest task reads and decodes its shapes
+                                   with shapelib on its own reader thread and hands them over through a ring of N
+                                   batches, so splitting overlaps the reads and the reader never gets more than N
+                                   batches ahead.  The kernel is also asked (posix_fadvise or, with --mmap, madvise) to
+                                   start reading the next 8MB of the .shp file before it is needed.  Setting it to 0
+                                   reads each shape when it is split, as before.  The output is the same either way.
+
+               --quiet             Don't print progress messages (errors are still printed).
+
+               --trace             Print a line for every segment and vertex as it is packed.  This is only available
+                                   if build_coast was built with BUILD_COAST_TRACE defined since the trace statements
+                                   are compiled out of normal builds.
+
+               --incremental       Keep a manifest (OUTPUT_FILE.ccl.manifest) with a hash of each input file and the
+                                   cells that it contributed to.  If the manifest matches the existing output file and
+                                   the same inputs are given in the same order, only the cells touched by the changed
+                                   inputs (old or new versions) are split and packed again.  Every other cell is copied
+                                   from the existing file, which is then replaced.  Inputs that don't share a cell with
+                                   a changed input aren't read at all.  Otherwise a full build is done and the manifest
+                                   is written for next time.  Not available when writing to standard output.
+
+               --bbox W,S,E,N      Only build the one-degree cells that overlap the west, south, east, north bounding
+                                   box (in degrees, not crossing the dateline).  Segments are clipped to those cells
+                                   and the header entries for all of the other cells are empty.  Input files and shapes
+                                   whose bounds don't overlap the cells are skipped without reading their vertices (in
+                                   the --mmap case the shape bounds are read in place from the record header).
+
+               --lod T1,T2,...     Add up to 8 simplified levels of detail for fast overview drawing.  Each segment is
+                                   simplified (Douglas-Peucker, from the full resolution vertices) with each tolerance
+                                   in turn (in degrees, increasing, at most 1).  The levels are written after the full
+                                   resolution cells, each as a header table followed by its cell records in exactly
+                                   the same record format, and found through an extension directory at the end of the
+                                   file (see ccl_format.h).  The version block gets two extra lines after the version
+                                   string so the full resolution data is unchanged and V1.0 readers still work.
+
+               --subdivide N       Build a quadtree for every cell with more than N vertices (fjords, Alaska, Chile...)
+                                   and write them in an extension block after the cells.  Quarters are split until the
+                                   segments touching them have N vertices or less (or are 1/32 of a degree on a side)
+                                   and each leaf lists the byte offsets of the segment records that touch it, so
+                                   ccl_decode_window only has to decode part of a dense cell for a small query.  The
+                                   cell records are not changed.
+
+               --merge             Before packing a cell, join the segments whose end points coincide (the pieces
+                                   of a line that wanders back and forth across a cell boundary, rings that were
+                                   split at their start point, and lines broken at the end of an input file) and drop
+                                   segments that don't have two different vertices.  Every segment costs about 107
+                                   bits of header so this makes the file smaller and faster to decode.  The segments
+                                   are in a different order than without --merge but the output is still the same
+                                   for any number of threads.
+
+               --compact           Write a V2.0 file (COMPACT_FILE_VERSION) with compact segment records instead of
+                                   the bit packed V1.0 records.  The start point is stored relative to the corner of
+                                   the cell and the count, start, and every lon/lat offset are zigzag varints, so there
+                                   are no bit width or bias fields and a typical offset takes one or two bytes (see
+                                   ccl_format.h).  The header and extensions are unchanged.  V1.0 readers can't read
+                                   these files (ccl_reader.c reads both).
+
+               --zlib              Same as --compact but the records of each cell (at every level of detail) are also
+                                   compressed as one zlib stream.  This is noted in the version block.
+
+               --stats FILE        Write run statistics to FILE as JSON when the build finishes: shapes, vertices, and
+                                   segments read, cell crossings, scratch file bytes written and read, output sizes,
+                                   histograms of the V1.0 record bit widths, the largest and slowest cells (with the
+                                   time spent packing each), peak resident memory, and trace spans for each input file
+                                   and pass in the Chrome trace event format (chrome://tracing or Perfetto can load the
+                                   file).  Sending SIGUSR1 to a running build writes a snapshot with what is known so
+                                   far ("status" is "running" instead of "complete").  The per cell timing is the only
+                                   part that isn't free so without --stats none of it is done.  With --job the
+                                   output, bit width, and largest and slowest cell sections are for the last output
+                                   in the job file (named in "file") and everything else is for the whole run.
+
+               --verify            When the file is finished, open it with ccl_reader.c and decode every cell at every
+                                   level of detail (using --threads threads).  The full resolution header entries
+                                   (address, number of segments and vertices, record size) must be the ones the
+                                   writer meant to write, every record has to decode and add up to the header counts,
+                                   the decoded vertices of each cell must hash to the same value as the segments that
+                                   were taken from the cell store and packed, and every quadtree must find all of the
+                                   segments in its cell.  Problems are reported for each cell and build_coast exits
+                                   with an error if there are any.  Cells copied from the previous file by
+                                   --incremental are decoded but have no input to compare with.  Not available when
+                                   writing to standard output.
+
+               --index             Also write a sparse index of the file (OUTPUT_FILE.cci, see ccl_format.h) with a
+                                   bit map of the populated cells and the header entries of just those cells for each
+                                   level, and the location of the quadtree table.  The reader (ccl_open) uses it when
+                                   it matches the file so a client only reads a few KB at startup instead of the
+                                   777,600 byte header of every level, and since the file is memory mapped only the
+                                   pages of the cells that are decoded are ever read.  The .ccl file is the same with
+                                   or without --index.  Building without --index removes an old index.  Not available
+                                   when writing to standard output.
+
+               --job FILE          Build several output files from one pass over the inputs.  FILE takes the place of
+                                   OUTPUT_FILE and lists one output per line as OUTPUT_FILE [inputs=N,N,...]
+                                   [bbox=W,S,E,N], where the inputs are the positions (from 1) of the input files on
+                                   the command line (default all of them) and the box defaults to --bbox (or the whole
+                                   world).  Blank lines and lines starting with # are ignored.  The inputs are read and
+                                   split into the cell store once (only keeping the cells inside the outputs' boxes if
+                                   they all have one), remembering where each file's segments start in every cell, and
+                                   then each output is packed in turn from the shared store with all of the --threads
+                                   threads.  The other options apply to every output and each output file is the same
+                                   as a separate build of the same inputs and box.  Not available with --incremental
+                                   and the outputs can't be written to standard output.
+
+               --export FORMAT     Instead of building a file, convert an existing one.  The arguments are the .ccl
+                                   file and the output file, and FORMAT is geojson (a FeatureCollection with a
+                                   LineString for each segment), wkb (one little endian WKB MultiLineString), or shp
+                                   (an arc shapefile with a .dbf holding the cell and segment number of each shape).
+                                   The cells are decoded by --threads threads, each formatting a row of cells into its
+                                   own buffer, and the rows are written in cell order so the output is the same for
+                                   any number of threads.  Only the cells overlapping --bbox are exported if it is
+                                   given.  Use - as the output file to write GeoJSON or WKB to standard output.
+
+               --level N           Level of detail to export (default 0, the full resolution data).
+
 */
 
 
-int32_t main (int32_t argc, char **argv)
+int32_t verbosity = VERBOSE_NORMAL;
+
+
+
+static void usage (char *name)
+{
+  fprintf (stderr, "Usage: %s [--max-memory MB] [--threads N] [--mmap] [--prefetch N] [--quiet | --trace] [--incremental] [--bbox W,S,E,N]\n       [--lod T1,T2,...] [--subdivide N] [--merge]\n       [--compact] [--zlib] [--stats FILE] [--verify] [--index] INPUT_FILE.shp [INPUT_FILE.shp ...] OUTPUT_FILE\n",
+           name);
+  fprintf (stderr, "       %s [options] --job FILE INPUT_FILE.shp [INPUT_FILE.shp ...]\n", name);
+  fprintf (stderr, "       %s --export geojson|wkb|shp [--level N] [--threads N] [--bbox W,S,E,N] INPUT_FILE.ccl OUTPUT_FILE\n",
+           name);
+  fprintf (stderr, "If the output file name does not have a .ccl extension it will be added.  Use - to write to standard output.\n");
+  fprintf (stderr, "--max-memory MB  maximum megabytes of cell data held in memory before using scratch files (default %d)\n",
+           DEFAULT_MAX_MEMORY);
+  fprintf (stderr, "--threads N      number of threads used to read shapes and pack cells (default is the number of processors)\n");
+  fprintf (stderr, "--mmap           read the shape files through memory mapping instead of shapelib\n");
+  fprintf (stderr, "--prefetch N     batches of shapes read ahead on a reader thread (default %d, 0 for none)\n",
+           DEFAULT_PREFETCH);
+  fprintf (stderr, "--quiet          don't print progress messages\n");
+  fprintf (stderr, "--trace          print every packed segment and vertex (requires a BUILD_COAST_TRACE build)\n");
+  fprintf (stderr, "--incremental    only pack the cells touched by inputs that changed since the last --incremental build\n");
+  fprintf (stderr, "--bbox W,S,E,N   only build the one-degree cells that overlap this area (degrees)\n");
+  fprintf (stderr, "--lod T1,T2,...  add up to %d simplified levels of detail with increasing tolerances (degrees)\n",
+           CCL_MAX_LOD);
+  fprintf (stderr, "--subdivide N    add a quadtree index to each cell with more than N vertices\n");
+  fprintf (stderr, "--merge          join segments in a cell whose end points coincide and drop degenerate segments\n");
+  fprintf (stderr, "--compact        write the smaller V2.0 varint segment records (needs a V2.0 reader)\n");
+  fprintf (stderr, "--zlib           --compact with the records of each cell compressed with zlib\n");
+  fprintf (stderr, "--stats FILE     write run statistics and trace spans to FILE as JSON (SIGUSR1 writes a snapshot)\n");
+  fprintf (stderr, "--verify         decode the finished file in parallel and check it against what was packed\n");
+  fprintf (stderr, "--index          also write OUTPUT_FILE.cci, a sparse index of the populated cells for fast opening\n");
+  fprintf (stderr, "--job FILE       build each OUTPUT_FILE [inputs=N,N,...] [bbox=W,S,E,N] line of FILE in one pass\n");
+  fprintf (stderr, "--export FORMAT  convert a .ccl file to GeoJSON, WKB, or a shapefile instead of building one\n");
+  fprintf (stderr, "--level N        level of detail to export (default 0)\n");
+  exit (-1);
+}
+
+
+
+/*  Add a line to the version block if it fits (leaving the last byte zero).  */
+
+static void version_line (char *version, const char *fmt, int32_t value)
+{
+  char              line[VERSION_SIZE];
+  int32_t           len = strlen (version);
+
+
+  snprintf (line, sizeof (line), fmt, value);
+
+  if (len + (int32_t) strlen (line) < VERSION_SIZE) strcpy (&version[len], line);
+}
+
+
+
+/*  Flag the cells that overlap bbox (west, south, east, north) and save the edges of those cells in
+    options.  A box edge that falls exactly on a cell boundary doesn't pull in the cell on the other side.  */
+
+static uint8_t *set_region (OPTIONS *options, double bbox[4])
 {
-  SHPHandle         shpHandle;
-  SHPObject         *shape = NULL;
-  FILE              *fp, *ofp;
-  int32_t           i, j, k, m, type, numShapes, numParts, total, londeg[2], latdeg[2], diff_x[2], diff_y[2], num_vertices;
-  int32_t           segCount, *segx, *segy, lastx, lasty, percent, old_percent, address, offset, xoff, yoff, num_segments;
-  int32_t           range_x, range_y, count_bits, lon_offset_bits, lat_offset_bits, size, bias_x, bias_y, pos, max_bias;
-  int32_t           input_file_count;
-  uint8_t           start_segment = NVFalse;
-  double            minBounds[4], maxBounds[4], lon[2], lat[2];
-  char              fname[512], version[128], outname[512];
-  uint8_t           *buffer, head_buf[12];
+  uint8_t           *region;
+  int32_t           lon0, lon1, lat0, lat1, i, j;
 
 
-  printf ("\n\n%s\n\n", VERSION);
+  lon0 = (int32_t) floor ((bbox[0] + 180.0) * CELLS_PER_DEGREE);
+  lon1 = (int32_t) ceil ((bbox[2] + 180.0) * CELLS_PER_DEGREE) - 1;
+  lat0 = (int32_t) floor ((bbox[1] + 90.0) * CELLS_PER_DEGREE);
+  lat1 = (int32_t) ceil ((bbox[3] + 90.0) * CELLS_PER_DEGREE) - 1;
 
+  lon0 = MAX (0, MIN (CELL_COLS - 1, lon0));
+  lon1 = MAX (lon0, MIN (CELL_COLS - 1, lon1));
+  lat0 = MAX (0, MIN (CELL_ROWS - 1, lat0));
+  lat1 = MAX (lat0, MIN (CELL_ROWS - 1, lat1));
 
-  if (argc < 3)
+
+  region = (uint8_t *) calloc (CELL_COUNT, 1);
+  if (region == NULL)
     {
-      fprintf (stderr, "Usage: %s INPUT_FILE.shp OUTPUT_FILE\n", argv[0]);
-      fprintf (stderr, "If the output file name does not have a .ccl extension it will be added.\n");
+      perror ("Allocating region memory");
       exit (-1);
     }
 
+  for (i = lat0 ; i <= lat1 ; i++)
+    for (j = lon0 ; j <= lon1 ; j++) region[i * CELL_COLS + j] = NVTrue;
 
-  input_file_count = argc - 2;
+  options->region = region;
+  options->region_bounds[0] = lon0 * CELL_DEGREES - 180.0;
+  options->region_bounds[1] = lat0 * CELL_DEGREES - 90.0;
+  options->region_bounds[2] = (lon1 + 1) * CELL_DEGREES - 180.0;
+  options->region_bounds[3] = (lat1 + 1) * CELL_DEGREES - 90.0;
 
+  PROGRESS ("Building cells %g to %g latitude, %g to %g longitude\n\n", options->region_bounds[1],
+            options->region_bounds[3] - CELL_DEGREES, options->region_bounds[0], options->region_bounds[2] - CELL_DEGREES);
 
-  /*  Initialize variables  */
+  return (region);
+}
 
-  total = 0;
-  segx = NULL;
-  segy = NULL;
-  fp = NULL;
-  londeg[0] = -999;
-  londeg[1] = -999;
-  latdeg[0] = -999;
-  latdeg[1] = -999;
-  lon[0] = -999.0;
-  lon[1] = -999.0;
-  lat[0] = -999.0;
-  lat[1] = -999.0;
 
 
-  /*  Make sure we don't have any old cell files hanging around since we're going to append to them  */
+/*  Parse the --lod tolerances (degrees, comma separated, increasing) into options and save a normalized copy of the
+    list in text (for the manifest).  Returns NVFalse if the list doesn't make sense.  */
 
-  for (i = 0 ; i < 180 ; i++)
+static uint8_t set_lod (OPTIONS *options, const char *arg, char *text)
+{
+  const char        *ptr = arg;
+  double            tolerance;
+  int32_t           n;
+
+
+  options->num_lod = 0;
+  text[0] = 0;
+
+  while (NVTrue)
     {
-      for (j = 0 ; j < 360 ; j++)
-        {
-          sprintf (fname, "cell_%03d_%03d", j, i);
-          remove (fname);
-        }
+      if (options->num_lod == CCL_MAX_LOD || sscanf (ptr, "%lf%n", &tolerance, &n) != 1 || tolerance <= 0.0 ||
+          tolerance > 1.0) return (NVFalse);
+
+      options->lod_tolerance[options->num_lod] = NINT (tolerance * POSITION_SCALE);
+
+      if (options->lod_tolerance[options->num_lod] < 1 ||
+          (options->num_lod && options->lod_tolerance[options->num_lod] <= options->lod_tolerance[options->num_lod - 1]))
+        return (NVFalse);
+
+      sprintf (&text[strlen (text)], "%s%d", options->num_lod ? "," : "", options->lod_tolerance[options->num_lod]);
+
+      options->num_lod++;
+
+      ptr += n;
+      if (*ptr == 0) break;
+      if (*ptr++ != ',') return (NVFalse);
     }
 
+  return (NVTrue);
+}
 
-  for (m = 0 ; m < input_file_count ; m++)
-    {
-      /*  Initialize loop variables  */
 
-      segCount = 0;
-      percent = 0;
-      old_percent = -1;
 
+/*  Pass 1 for an incremental build.  Only the cells touched by the changed inputs (in their old or new versions) need
+    to be packed again.  All of the other cells are copied from the previous file.  The changed inputs are read first
+    to find the cells they now touch.  If any unchanged input also touches one of those cells we have to read it too
+    (the segments in a cell are in input order) so we clear the store and read every input that matters, in order,
+    keeping only the affected cells.  The new cell list for each input is put in manifest.  Returns NVFalse if nothing
+    has changed.  */
 
-      /*  Open shape file  */
+static uint8_t incremental_ingest (CELL_STORE *store, char **files, MANIFEST *manifest, MANIFEST *old_manifest,
+                                   OPTIONS *options, uint8_t *reencode)
+{
+  char              **list;
+  uint8_t           *file_cells, needed;
+  int32_t           i, j, num_changed, num_needed, cell, affected;
 
-      shpHandle = SHPOpen (argv[m + 1], "rb");
 
-      if (shpHandle == NULL)
+  list = (char **) malloc (manifest->num_inputs * sizeof (char *));
+  file_cells = (uint8_t *) calloc ((size_t) manifest->num_inputs * CELL_COUNT, 1);
+  if (list == NULL || file_cells == NULL)
+    {
+      perror ("Allocating incremental build memory");
+      exit (-1);
+    }
+
+
+  for (i = 0, num_changed = 0 ; i < manifest->num_inputs ; i++)
+    {
+      if (manifest->input[i].hash != old_manifest->input[i].hash)
         {
-          perror (argv[m + 1]);
-          exit (-1);
+          PROGRESS ("%s has changed\n", files[i]);
+          list[num_changed++] = files[i];
         }
+      else
+        {
+          memcpy (manifest->input[i].cells, old_manifest->input[i].cells, CELL_COUNT);
+        }
+    }
 
+  if (!num_changed)
+    {
+      free (list);
+      free (file_cells);
+      return (NVFalse);
+    }
 
-      fprintf (stderr,"\n\nReading %s\n\n", argv[m + 1]);
-      fflush (stderr);
 
+  ingest_files (store, list, num_changed, options, file_cells);
 
-      /*  Get shape file header info  */
 
-      SHPGetInfo (shpHandle, &numShapes, &type, minBounds, maxBounds);
+  for (i = 0, j = 0 ; i < manifest->num_inputs ; i++)
+    {
+      if (manifest->input[i].hash != old_manifest->input[i].hash)
+        {
+          memcpy (manifest->input[i].cells, &file_cells[(size_t) j * CELL_COUNT], CELL_COUNT);
 
+          for (cell = 0 ; cell < CELL_COUNT ; cell++)
+            if (manifest->input[i].cells[cell] || old_manifest->input[i].cells[cell]) reencode[cell] = NVTrue;
 
-      /*  Read all shapes  */
+          j++;
+        }
+    }
 
-      for (i = 0 ; i < numShapes ; i++)
-        {
-          shape = SHPReadObject (shpHandle, i);
+  for (cell = 0, affected = 0 ; cell < CELL_COUNT ; cell++) affected += reencode[cell];
 
-          total += shape->nVertices;
+  PROGRESS ("\n\n%d of %d cells need to be packed again\n\n", affected, CELL_COUNT);
 
 
-          /*  Get all vertices  */
+  /*  Find the unchanged inputs that share any of those cells.  */
 
-          if (shape->nVertices >= 2)
-            {
-              for (j = 0, numParts = 1 ; j < shape->nVertices ; j++)
-                {
-		  start_segment = NVFalse;
+  for (i = 0, num_needed = 0 ; i < manifest->num_inputs ; i++)
+    {
+      needed = (manifest->input[i].hash != old_manifest->input[i].hash);
 
+      for (cell = 0 ; !needed && cell < CELL_COUNT ; cell++)
+        if (reencode[cell] && old_manifest->input[i].cells[cell]) needed = NVTrue;
 
-		  /*  Check for start of a new segment.  */
+      if (needed) list[num_needed++] = files[i];
+    }
 
-		  if (!j && shape->nParts > 0) start_segment = NVTrue;
 
+  /*  If only the changed files touch them, the store already has exactly what we need.  */
 
-		  /*  Check for the start of a new segment inside a larger group of points (this would be a "Ring" point).  */
+  if (num_needed > num_changed)
+    {
+      size_t budget = store->budget;
 
-		  if (numParts < shape->nParts && shape->panPartStart[numParts] == j)
-		    {
-		      start_segment = NVTrue;
-		      numParts++;
-		    }
+      run_stats.spills += store->spills;
+      run_stats.scratch_written += store->scratch_written;
 
+      cell_store_free (store);
+      cell_store_init (store, budget);
+      store->filter = reencode;
 
-                  /*  Bias lat and lon by 90 and 180 so that all points are positive  */
+      ingest_files (store, list, num_needed, options, NULL);
+    }
 
-                  lon[1] = shape->padfX[j] + 180.0;
-                  lat[1] = shape->padfY[j] + 90.0;
+  free (list);
+  free (file_cells);
 
+  return (NVTrue);
+}
 
-		  /*  Polygons are closed at the -180/180 boundary.  Since we're making a nice simple coastline we're going to discard points that 
-		      are at exactly 180.000 or -180.000.  */
 
-		  //if (shape->padfX[j] == -180.00000 || shape->padfX[j] == 180.00000) continue;
-		  
 
-                  /*  Damn boundary conditions!  */
+/*  Write the version.  The header and cell records (and the levels of detail) are written by encode_cells.  A V1.0
+    reader only looks at the first line so the extension lines don't bother it.  The first three lines always fit in
+    the version block.  The last two are only there for people looking at the file (the reader gets them from the
+    extension directory) so they are left out if there's no room for them.  */
 
-                  if (lon[1] == 360.0)
-		    {
-		      fprintf (stderr,"%s %s %d %d %.11f %.11f\n",NVFFL,j,shape->padfX[j],shape->padfY[j]);
-		      lon[1] = 180.0;
-		    }
+static void write_version (FILE *ofp, const OPTIONS *options, const char *file_version)
+{
+  char              version[VERSION_SIZE];
+
+
+  memset (version, 0, VERSION_SIZE);
+  sprintf (version, "%s\n", file_version);
+  if (options->compress) sprintf (&version[strlen (version)], "[CELL COMPRESSION] = %s\n", CCL_COMPRESSION_ZLIB);
+  if (options->num_lod || options->tile_threshold)
+    sprintf (&version[strlen (version)], "[EXTENSION VERSION] = %d\n", CCL_EXTENSION_VERSION);
+  if (options->num_lod) version_line (version, "[LOD LEVELS] = %d\n", options->num_lod);
+  if (options->tile_threshold) version_line (version, "[TILE THRESHOLD] = %d\n", options->tile_threshold);
+  PROGRESS ("%s\n", version);
+  fwrite (version, VERSION_SIZE, 1, ofp);
+}
 
 
-                  londeg[1] = (int32_t) lon[1];
-                  latdeg[1] = (int32_t) lat[1];
 
+/*  Build every output in the --job file job_name from one pass over the inputs.  The store keeps track of where each
+    input file's segments start in every cell so encode_cells can pick out the ones for each output (see
+    cell_store_select) without changing the store.  The outputs are packed one after the other, each with all of the
+    threads, since that is already as parallel as the packing gets and it keeps the memory use of pass 2 the same as
+    a single build.  bbox is the --bbox box (NULL if it wasn't given).  */
 
+static void build_jobs (char **files, int32_t num_files, OPTIONS *options, const char *job_name, double *bbox,
+                        uint8_t verify, const char *file_version, int32_t max_memory)
+{
+  CELL_STORE        store;
+  OPTIONS           job_options;
+  JOB               *jobs, *job;
+  FILE              *ofp;
+  double            area[4], *box;
+  uint8_t           all_boxed, *region = NULL, *job_region;
+  int32_t           num_jobs, i, span, total;
 
-                  /*  Changed cells (but not first time through)  */
 
-                  if (latdeg[0] > -999 && (latdeg[1] != latdeg[0] || londeg[1] != londeg[0]))
-                    {
-                      /*  Start a new segment in a new cell  */
+  num_jobs = job_read (job_name, num_files, &jobs);
 
-                      if (start_segment)
-                        {
-                          /*  Close last segment, don't add point, start new segment in new cell  */
 
-                          fwrite (&segCount, sizeof (int32_t), 1, fp);
+  /*  If every output has a box we only need to keep the cells inside the rectangle around all of them.  */
 
-                          for (k = 0 ; k < segCount ; k++)
-                            {
-                              fwrite (&segx[k], sizeof (int32_t), 1, fp);
-                              fwrite (&segy[k], sizeof (int32_t), 1, fp);
-                            }
+  all_boxed = NVTrue;
+  area[0] = area[1] = 999.0;
+  area[2] = area[3] = -999.0;
 
-                          fclose (fp);
+  for (i = 0 ; i < num_jobs ; i++)
+    {
+      if ((box = jobs[i].use_bbox ? jobs[i].bbox : bbox) == NULL)
+        {
+          all_boxed = NVFalse;
+          break;
+        }
 
-                          sprintf (fname, "cell_%03d_%03d", londeg[1], latdeg[1]);
+      area[0] = MIN (area[0], box[0]);
+      area[1] = MIN (area[1], box[1]);
+      area[2] = MAX (area[2], box[2]);
+      area[3] = MAX (area[3], box[3]);
+    }
 
-                          if ((fp = fopen (fname, "ab")) == NULL)
-                            {
-                              perror (fname);
-                              exit (-1);
-                            }
 
-                          segCount = 0;
-                        }
-                      else
-                        {
-                          /*  Add point to last segment, close last segment, start new segment in new cell with last point 
-                              as first point in new segment  */
+  cell_store_init (&store, options->max_memory - options->max_memory / MEMORY_WINDOW_SHARE);
+  cell_store_track_files (&store, num_files);
 
-                          segCount++; 
+  if (all_boxed)
+    {
+      region = set_region (options, area);
+      store.filter = region;
+    }
 
-                          fwrite (&segCount, sizeof (int32_t), 1, fp);
+  if (verify)
+    {
+      options->check = (CELL_CHECK *) calloc (CELL_COUNT, sizeof (CELL_CHECK));
+      if (options->check == NULL)
+        {
+          perror ("Allocating verify memory");
+          exit (-1);
+        }
+    }
 
-                          for (k = 0 ; k < segCount - 1 ; k++)
-                            {
-                              fwrite (&segx[k], sizeof (int32_t), 1, fp);
-                              fwrite (&segy[k], sizeof (int32_t), 1, fp);
-                            }
 
-                          lastx = NINT (lon[0] * 100000.0);
-                          lasty = NINT (lat[0] * 100000.0);
-                          fwrite (&lastx, sizeof (int32_t), 1, fp);
-                          fwrite (&lasty, sizeof (int32_t), 1, fp);
+  /*  Pass 1 - split all of the input shapes into segments by cell.  */
 
-                          fclose (fp);
+  span = stats_span_begin ("pass 1", NULL);
 
+  ingest_files (&store, files, num_files, options, NULL);
 
-                          sprintf (fname, "cell_%03d_%03d", londeg[1], latdeg[1]);
+  stats_span_end (span);
 
-                          if ((fp = fopen (fname, "ab")) == NULL)
-                            {
-                              perror (fname);
-                              exit (-1);
-                            }
+  run_stats.spills += store.spills;
+  run_stats.scratch_written += store.scratch_written;
 
+  if (store.spills)
+    {
+      PROGRESS ("Exceeded the %d MB memory limit, spilled %d times to %d scratch file chunks\n\n", max_memory, store.spills,
+                store.num_chunks);
+    }
 
-                          segCount = 0;
 
-                          segx = (int32_t *) realloc (segx, (segCount + 1) * sizeof (int32_t));
-                          if (segx == NULL)
-                            {
-                              perror ("Allocating segx memory");
-                              exit (-1);
-                            }
+  /*  Pass 2 - pack each output from the shared store.  */
 
-                          segy = (int32_t *) realloc (segy, (segCount + 1) * sizeof (int32_t));
-                          if (segy == NULL)
-                            {
-                              perror ("Allocating segy memory");
-                              exit (-1);
-                            }
+  for (i = 0 ; i < num_jobs ; i++)
+    {
+      job = &jobs[i];
 
+      job_options = *options;
+      job_options.inputs = job->inputs;
+      job_options.region = job_region = NULL;
 
-                          /*  Add last point to current segment  */
+      if ((box = job->use_bbox ? job->bbox : bbox) != NULL) job_region = set_region (&job_options, box);
 
-                          segx[segCount] = NINT (lon[0] * 100000.0);
-                          segy[segCount] = NINT (lat[0] * 100000.0);
+      if (verify) memset (options->check, 0, CELL_COUNT * sizeof (CELL_CHECK));
 
-                          segCount++;
-                        }
-                    }
-                  else
-                    {
-                      /*  Start a new segment but not in a new cell  */
-
-                      if (start_segment)
-                        {
-                          /*  First time through open the first file  */
-
-                          if (latdeg[0] == -999)
-                            {
-                              sprintf (fname, "cell_%03d_%03d", londeg[1], latdeg[1]);
-
-                              if ((fp = fopen (fname, "ab")) == NULL)
-                                {
-                                  perror (fname);
-                                  exit (-1);
-                                }
-                            }
-                          else
-                            {
-                              /*  Close last segment, start new segment  */
-
-                              fwrite (&segCount, sizeof (int32_t), 1, fp);
-
-                              for (k = 0 ; k < segCount ; k++)
-                                {
-                                  fwrite (&segx[k], sizeof (int32_t), 1, fp);
-                                  fwrite (&segy[k], sizeof (int32_t), 1, fp);
-                                }
-
-                              segCount = 0;
-                            }
-                        }
-                    }
 
+      if ((ofp = fopen (job->name, "wb")) == NULL)
+        {
+          perror (job->name);
+          exit (-1);
+        }
 
-                  segx = (int32_t *) realloc (segx, (segCount + 1) * sizeof (int32_t));
-                  if (segx == NULL)
-                    {
-                      perror ("Allocating segx memory");
-                      exit (-1);
-                    }
+      PROGRESS ("\n\n%s\n\n", job->name);
 
-                  segy = (int32_t *) realloc (segy, (segCount + 1) * sizeof (int32_t));
-                  if (segy == NULL)
-                    {
-                      perror ("Allocating segy memory");
-                      exit (-1);
-                    }
+      write_version (ofp, &job_options, file_version);
 
 
-                  /*  Add point to current segment  */
+      stats_reset_output (job->name);
 
-                  segx[segCount] = NINT (lon[1] * 100000.0);
-                  segy[segCount] = NINT (lat[1] * 100000.0);
+      span = stats_span_begin ("pass 2 %s", job->name);
 
-                  segCount++;
+      total = encode_cells (&store, ofp, &job_options, NULL);
 
+      stats_span_end (span);
 
-                  londeg[0] = londeg[1];
-                  latdeg[0] = latdeg[1];
-                  lon[0] = lon[1];
-                  lat[0] = lat[1];
-                }
-            }
+      if (fclose (ofp))
+        {
+          perror (job->name);
+          exit (-1);
+        }
+
+      PROGRESS ("100%% packed\n\n");
+      PROGRESS ("Total points packed = %d\n\n", total);
 
 
-          percent = (int32_t) (((float) i / (float) numShapes) * 100.0);
-          if (percent != old_percent)
+      if (options->index)
+        {
+          index_write (job->name);
+        }
+      else
+        {
+          index_remove (job->name);
+        }
+
+
+      if (verify)
+        {
+          span = stats_span_begin ("verify %s", job->name);
+
+          total = verify_file (job->name, file_version, &job_options);
+
+          stats_span_end (span);
+
+          if (total)
             {
-              fprintf (stderr, "%03d%% processed\r", percent);
-              fflush (stderr);
-              old_percent = percent;
+              fprintf (stderr, "Verification of %s failed!\n\n", job->name);
+              stats_write ("failed");
+              exit (-1);
             }
+        }
 
+      if (job_region != NULL) free (job_region);
+    }
 
-          SHPDestroyObject (shape);
-        }
 
+  run_stats.scratch_read = store.scratch_read;
+
+  cell_store_free (&store);
+
+  if (region != NULL) free (region);
+  if (options->check != NULL) free (options->check);
+  options->check = NULL;
+
+  job_free (jobs, num_jobs);
+}
 
-      /*  Close the last segment.  */
 
-      fwrite (&segCount, sizeof (int32_t), 1, fp);
 
-      for (k = 0 ; k < segCount ; k++)
+int32_t main (int32_t argc, char **argv)
+{
+  FILE              *ofp;
+  CELL_STORE        store;
+  OPTIONS           options;
+  MANIFEST          manifest, old_manifest;
+  PREVIOUS_CCL      previous, *previous_ptr;
+  int32_t           total, i, span;
+  int32_t           input_file_count, first_input, option_index, c, max_memory, export_type, export_level;
+  uint8_t           incremental, use_bbox, verify, *file_cells, *reencode = NULL, *region = NULL;
+  double            bbox[4];
+  const char        *file_version;
+  char              outname[512], write_name[520], manifest_name[530], lod[128];
+  char              *stats_name = NULL, *job_name = NULL;
+
+
+  max_memory = DEFAULT_MAX_MEMORY;
+  options.num_threads = default_thread_count ();
+  options.use_mmap = NVFalse;
+  options.prefetch = DEFAULT_PREFETCH;
+  options.streaming = NVFalse;
+  incremental = NVFalse;
+  use_bbox = NVFalse;
+  verify = NVFalse;
+  export_type = 0;
+  export_level = 0;
+  options.region = NULL;
+  options.num_lod = 0;
+  options.tile_threshold = 0;
+  options.merge = NVFalse;
+  options.compact = NVFalse;
+  options.compress = NVFalse;
+  options.check = NULL;
+  options.index = NVFalse;
+  options.inputs = NULL;
+  strcpy (lod, "none");
+
+  while (NVTrue) 
+    {
+      static struct option long_options[] = {{"max-memory", required_argument, 0, 0},
+                                             {"threads", required_argument, 0, 0},
+                                             {"mmap", no_argument, 0, 0},
+                                             {"quiet", no_argument, 0, 0},
+                                             {"trace", no_argument, 0, 0},
+                                             {"incremental", no_argument, 0, 0},
+                                             {"bbox", required_argument, 0, 0},
+                                             {"lod", required_argument, 0, 0},
+                                             {"subdivide", required_argument, 0, 0},
+                                             {"merge", no_argument, 0, 0},
+                                             {"compact", no_argument, 0, 0},
+                                             {"zlib", no_argument, 0, 0},
+                                             {"stats", required_argument, 0, 0},
+                                             {"verify", no_argument, 0, 0},
+                                             {"export", required_argument, 0, 0},
+                                             {"level", required_argument, 0, 0},
+                                             {"prefetch", required_argument, 0, 0},
+                                             {"index", no_argument, 0, 0},
+                                             {"job", required_argument, 0, 0},
+                                             {0, no_argument, 0, 0}};
+
+      c = getopt_long (argc, argv, "", long_options, &option_index);
+      if (c == -1) break;
+
+      switch (c) 
         {
-          fwrite (&segx[k], sizeof (int32_t), 1, fp);
-          fwrite (&segy[k], sizeof (int32_t), 1, fp);
+        case 0:
+
+          switch (option_index)
+            {
+            case 0:
+              if (sscanf (optarg, "%d", &max_memory) != 1 || max_memory < 0) usage (argv[0]);
+              break;
+
+            case 1:
+              if (sscanf (optarg, "%d", &options.num_threads) != 1 || options.num_threads < 1) usage (argv[0]);
+              break;
+
+            case 2:
+              options.use_mmap = NVTrue;
+              break;
+
+            case 3:
+              verbosity = VERBOSE_QUIET;
+              break;
+
+            case 4:
+              verbosity = VERBOSE_TRACE;
+              break;
+
+            case 5:
+              incremental = NVTrue;
+              break;
+
+            case 6:
+              if (sscanf (optarg, "%lf,%lf,%lf,%lf", &bbox[0], &bbox[1], &bbox[2], &bbox[3]) != 4 || bbox[0] < -180.0 ||
+                  bbox[2] > 180.0 || bbox[1] < -90.0 || bbox[3] > 90.0 || bbox[0] >= bbox[2] || bbox[1] >= bbox[3])
+                usage (argv[0]);
+              use_bbox = NVTrue;
+              break;
+
+            case 7:
+              if (!set_lod (&options, optarg, lod)) usage (argv[0]);
+              break;
+
+            case 8:
+              if (sscanf (optarg, "%d", &options.tile_threshold) != 1 || options.tile_threshold < 1) usage (argv[0]);
+              break;
+
+            case 9:
+              options.merge = NVTrue;
+              break;
+
+            case 10:
+              options.compact = NVTrue;
+              break;
+
+            case 11:
+              options.compact = options.compress = NVTrue;
+              break;
+
+            case 12:
+              stats_name = optarg;
+              break;
+
+            case 13:
+              verify = NVTrue;
+              break;
+
+            case 14:
+              if (!(export_type = export_format (optarg))) usage (argv[0]);
+              break;
+
+            case 15:
+              if (sscanf (optarg, "%d", &export_level) != 1 || export_level < 0 || export_level > CCL_MAX_LOD)
+                usage (argv[0]);
+              break;
+
+            case 16:
+              if (sscanf (optarg, "%d", &options.prefetch) != 1 || options.prefetch < 0) usage (argv[0]);
+              break;
+
+            case 17:
+              options.index = NVTrue;
+              break;
+
+            case 18:
+              job_name = optarg;
+              break;
+            }
+          break;
+
+        default:
+          usage (argv[0]);
+          break;
         }
+    }
 
 
-      fprintf (stderr, "100%% processed\n\n");
-      fprintf (stderr, "Total points processed = %d\n\n", total);
+  /*  Don't mix the banner in with the data if we're writing to standard output (with --job the last argument is an
+      input file).  */
+
+  if (job_name == NULL && optind < argc && !strcmp (argv[argc - 1], "-")) options.streaming = NVTrue;
+
+  if (verbosity >= VERBOSE_NORMAL) fprintf (options.streaming ? stderr : stdout, "\n\n%s\n\n", VERSION);
+
+
+#ifndef BUILD_COAST_TRACE
+  if (verbosity == VERBOSE_TRACE)
+    {
+      fprintf (stderr, "--trace is not available, rebuild with BUILD_COAST_TRACE defined to use it.\n\n");
       fflush (stderr);
+    }
+#endif
 
 
-      SHPClose (shpHandle);
+  if (argc - optind < (job_name != NULL ? 1 : 2)) usage (argv[0]);
 
 
-      /*  Force it to start a new segment.  */
+  /*  Converting an existing file doesn't need any of the build machinery.  */
 
-      latdeg[0] = -888;
-    }
+  if (export_type)
+    {
+      if (argc - optind != 2 || job_name != NULL || (options.streaming && export_type == EXPORT_SHAPEFILE)) usage (argv[0]);
 
-  fclose (fp);
+      if (use_bbox) region = set_region (&options, bbox);
 
-  if (segx != NULL) free (segx);
-  if (segy != NULL) free (segy);
+      export_file (argv[optind], argv[optind + 1], export_type, export_level, &options);
 
+      if (region != NULL) free (region);
 
-  percent = 0;
-  old_percent = -1;
-  total = 0;
+      return (0);
+    }
 
 
-  strcpy (outname, argv[argc - 1]);
-  if (strcmp (&outname[strlen (outname) - 4], ".ccl")) sprintf (outname, "%s.ccl", argv[argc - 1]);
+  first_input = optind;
+  input_file_count = argc - optind - 1;
 
 
-  fprintf (stderr,"\n\n%s\n\n", outname);
-  fflush (stderr);
+  options.max_memory = (size_t) max_memory * 1024 * 1024;
 
+  if (stats_name != NULL) stats_init (stats_name, &options);
 
-  if ((ofp = fopen (outname, "wb")) == NULL)
-    {
-      perror (outname);
-      exit (-1);
-    }
+  file_version = options.compact ? COMPACT_FILE_VERSION : FILE_VERSION;
 
 
-  /*  Write the header  */
+  if (job_name != NULL)
+    {
+      if (incremental)
+        {
+          fprintf (stderr, "--incremental can't be used with --job.\n\n");
+          exit (-1);
+        }
 
-  memset (version, 0, 128);
-  sprintf (version, "%s\n", FILE_VERSION);
-  fprintf(stderr,"%s\n",version);
-  fflush (stderr);
-  fwrite (version, 128, 1, ofp);
+      build_jobs (&argv[optind], argc - optind, &options, job_name, use_bbox ? bbox : NULL, verify, file_version,
+                  max_memory);
 
+      stats_write ("complete");
+      stats_free ();
+
+      return (0);
+    }
 
-  /*  Initialize the header area  */
 
-  for (i = 0 ; i < 180 ; i++)
+  if (options.streaming)
     {
-      for (j = 0 ; j < 360 ; j++)
+      if (incremental)
         {
-          offset = (i * 360 + j) * (3 * sizeof (int32_t)) + 128;
+          fprintf (stderr, "--incremental can't be used when writing to standard output.\n\n");
+          exit (-1);
+        }
 
-          address = 0;
-          num_segments = 0;
-          num_vertices = 0;
+      if (verify)
+        {
+          fprintf (stderr, "--verify can't be used when writing to standard output.\n\n");
+          exit (-1);
+        }
 
-          fseek (ofp, offset, SEEK_SET);
+      if (options.index)
+        {
+          fprintf (stderr, "--index can't be used when writing to standard output.\n\n");
+          exit (-1);
+        }
+
+      strcpy (outname, "standard output");
+    }
+  else
+    {
+      strcpy (outname, argv[argc - 1]);
+      if (strlen (outname) < 4 || strcmp (&outname[strlen (outname) - 4], ".ccl")) sprintf (outname, "%s.ccl", argv[argc - 1]);
+    }
+
+
+  cell_store_init (&store, options.max_memory - options.max_memory / MEMORY_WINDOW_SHARE);
 
-          pos = 0;
-          bit_pack (head_buf, pos, 8 * sizeof (int32_t), address); pos += (8 * sizeof (int32_t));
-          bit_pack (head_buf, pos, 8 * sizeof (int32_t), num_segments); pos += (8 * sizeof (int32_t));
-          bit_pack (head_buf, pos, 8 * sizeof (int32_t), num_vertices);
 
-          fwrite (head_buf, 3 * sizeof (int32_t), 1, ofp);
+  if (verify)
+    {
+      options.check = (CELL_CHECK *) calloc (CELL_COUNT, sizeof (CELL_CHECK));
+      if (options.check == NULL)
+        {
+          perror ("Allocating verify memory");
+          exit (-1);
         }
     }
 
 
-  max_bias = (int32_t) (pow (2.0, 17.0) - 1.0);
+  if (use_bbox)
+    {
+      region = set_region (&options, bbox);
+      store.filter = region;
+    }
+
+
+  /*  Pass 1 - split the input shapes into segments by cell.  */
+
+  span = stats_span_begin ("pass 1", NULL);
 
+  previous_ptr = NULL;
 
-  for (i = 0 ; i < 180 ; i++)
+  if (incremental)
     {
-      for (j = 0 ; j < 360 ; j++)
+      sprintf (manifest_name, "%s.manifest", outname);
+
+      manifest_init (&manifest, input_file_count);
+
+      for (i = 0 ; i < input_file_count ; i++)
         {
-          num_segments = 0;
-          num_vertices = 0;
+          strncpy (manifest.input[i].path, argv[first_input + i], sizeof (manifest.input[i].path) - 1);
+          manifest.input[i].hash = manifest_hash_input (argv[first_input + i]);
+        }
 
-          sprintf (fname, "cell_%03d_%03d", j, i);
+      if (use_bbox)
+        {
+          sprintf (manifest.bbox, "%.11g,%.11g,%.11g,%.11g", bbox[0], bbox[1], bbox[2], bbox[3]);
+        }
+      else
+        {
+          strcpy (manifest.bbox, "none");
+        }
 
-          if ((fp = fopen (fname, "rb")) != NULL)
+      strcpy (manifest.lod, lod);
+      manifest.merge = options.merge;
+
+      reencode = (uint8_t *) calloc (CELL_COUNT, 1);
+      if (reencode == NULL)
+        {
+          perror ("Allocating cell flags");
+          exit (-1);
+        }
+
+
+      /*  We can only reuse the old file if the manifest matches it and the same inputs are given in the same order
+          (the segment order in each cell depends on the input order).  */
+
+      if (manifest_read (&old_manifest, manifest_name))
+        {
+          if (old_manifest.num_inputs == input_file_count && !strcmp (old_manifest.file_version, file_version) &&
+              !strcmp (old_manifest.bbox, manifest.bbox) && !strcmp (old_manifest.lod, manifest.lod) &&
+              old_manifest.merge == manifest.merge)
             {
-              offset = (i * 360 + j) * (3 * sizeof (int32_t)) + 128;
-              address = ftell (ofp);
+              for (i = 0 ; i < input_file_count ; i++)
+                if (strcmp (old_manifest.input[i].path, manifest.input[i].path)) break;
 
-              while (fread (&segCount, sizeof (int32_t), 1, fp))
+              if (i == input_file_count &&
+                  previous_ccl_open (&previous, outname, file_version, old_manifest.ccl_size))
                 {
-		  fprintf (stderr,"%s %s %d %d\n",NVFFL,segCount);
-                  /*  Just in case we happened to write an empty segment between files ;-)  */
-
-                  if (segCount)
+                  if (previous.ccl->num_levels == 1 + options.num_lod &&
+                      previous.ccl->tile_threshold == options.tile_threshold &&
+                      previous.ccl->compressed == options.compress)
                     {
-                      num_vertices += segCount;
-                      num_segments++;
-                      total += segCount;
-
-                      segx = (int32_t *) calloc (segCount, sizeof (int32_t));
-                      if (segx == NULL)
-                        {
-                          perror ("Allocating segx memory");
-                          exit (-1);
-                        }
-
-                      segy = (int32_t *) calloc (segCount, sizeof (int32_t));
-                      if (segy == NULL)
-                        {
-                          perror ("Allocating segy memory");
-                          exit (-1);
-                        }
-
-                      diff_x[0] = 99999999;
-                      diff_x[1] = -99999999;
-                      diff_y[0] = 99999999;
-                      diff_y[1] = -99999999;
-
-                      for (k = 0 ; k < segCount ; k++)
-                        {
-                          if (!fread (&segx[k], sizeof (int32_t), 1, fp))
-			    {
-			      fprintf (stderr, "Bad return in file %s, function %s at line %d.  This should never happen!", __FILE__, __FUNCTION__, __LINE__ - 2);
-			      fflush (stderr);
-			      exit (-1);
-			    }
-                          if (!fread (&segy[k], sizeof (int32_t), 1, fp))
-			    {
-			      fprintf (stderr, "Bad return in file %s, function %s at line %d.  This should never happen!", __FILE__, __FUNCTION__, __LINE__ - 2);
-			      fflush (stderr);
-			      exit (-1);
-			    }
-			  fprintf (stderr,"%s %s %d %d %d %d\n",NVFFL,k, segx[k],segy[k]);
-
-                          if (k)
-                            {
-                              diff_x[0] = MIN (segx[k] - segx[k - 1], diff_x[0]);
-                              diff_x[1] = MAX (segx[k] - segx[k - 1], diff_x[1]);
-                              diff_y[0] = MIN (segy[k] - segy[k - 1], diff_y[0]);
-                              diff_y[1] = MAX (segy[k] - segy[k - 1], diff_y[1]);
-                            }
-                        }
-
-
-                      bias_x = -diff_x[0];
-                      bias_y = -diff_y[0];
-
-                      if (bias_x > max_bias || bias_x < -max_bias)
-                        {
-                          fprintf (stderr, "\n\nlon bias out of range, terminating!\n\n");
-                          fprintf (stderr, "%d %d %d\n", i,j,bias_x);
-                          exit (-1);
-                        }
-
-
-                      if (bias_y > max_bias || bias_y < -max_bias)
-                        {
-                          fprintf (stderr, "\n\nlat bias out of range, terminating!\n\n");
-                          fprintf (stderr, "%d %d %d\n", i,j,bias_y);
-                          exit (-1);
-                        }
-
-
-                      range_x = diff_x[1] - diff_x[0];
-                      range_y = diff_y[1] - diff_y[0];
-
-
-                      if (!range_x) range_x = 1;
-                      if (!range_y) range_y = 1;
-
-
-                      count_bits = NINT (log10 ((double) segCount) / log10 (2.0) + 1.0);
-                      lon_offset_bits = NINT (log10 ((double) range_x) / log10 (2.0) + 1.0);
-                      lat_offset_bits = NINT (log10 ((double) range_y) / log10 (2.0) + 1.0);
-
-
-                      size = 5 + 5 + 5 + count_bits + lon_offset_bits + lat_offset_bits + 18 + 18 + 26 + 25 + 
-                        (segCount - 1) * (lon_offset_bits + lat_offset_bits);
-
-                      size = size / 8 + 1;
-
-                      buffer = (uint8_t *) calloc (1, size);
-
-                      if (buffer == NULL)
-                        {
-                          perror ("Allocating buffer");
-                          exit (-1);
-                        }
-
-                      pos = 0;
-                      bit_pack (buffer, pos, 5, count_bits); pos += 5;
-                      bit_pack (buffer, pos, 5, lon_offset_bits); pos += 5;
-                      bit_pack (buffer, pos, 5, lat_offset_bits); pos +=5;
-                      bit_pack (buffer, pos, count_bits, segCount); pos += count_bits;
-                      bit_pack (buffer, pos, 18, bias_x + max_bias); pos += 18;
-                      bit_pack (buffer, pos, 18, bias_y + max_bias); pos += 18;
-                      bit_pack (buffer, pos, 26, segx[0]); pos += 26;
-                      bit_pack (buffer, pos, 25, segy[0]); pos += 25;
-
-
-                      for (k = 1 ; k < segCount ; k++)
-                        {
-                          xoff = (segx[k] - segx[k - 1]) + bias_x;
-                          yoff = (segy[k] - segy[k - 1]) + bias_y;
-
-                          bit_pack (buffer, pos, lon_offset_bits, xoff); pos += lon_offset_bits;
-                          bit_pack (buffer, pos, lat_offset_bits, yoff); pos += lat_offset_bits;
-                        }
-
-                      fwrite (buffer, size, 1, ofp);
-
-                      free (buffer);
-                      free (segx);
-                      free (segy);
+                      previous.reencode = reencode;
+                      previous_ptr = &previous;
+                    }
+                  else
+                    {
+                      previous_ccl_close (&previous);
                     }
                 }
+            }
+
+          if (previous_ptr == NULL)
+            {
+              PROGRESS ("%s doesn't match the inputs or %s, doing a full build\n\n", manifest_name, outname);
+            }
+          else if (!incremental_ingest (&store, &argv[first_input], &manifest, &old_manifest, &options, reencode))
+            {
+              PROGRESS ("None of the input files have changed, %s is up to date\n\n", outname);
+
+              if (options.index) index_write (outname);
+
+              stats_span_end (span);
+              stats_write ("complete");
+              stats_free ();
+
+              previous_ccl_close (&previous);
+              manifest_free (&old_manifest);
+              manifest_free (&manifest);
+              cell_store_free (&store);
+              free (reencode);
+              if (region != NULL) free (region);
+              if (options.check != NULL) free (options.check);
+
+              return (0);
+            }
+
+          manifest_free (&old_manifest);
+        }
+
+
+      if (previous_ptr == NULL)
+        {
+          file_cells = (uint8_t *) calloc ((size_t) input_file_count * CELL_COUNT, 1);
+          if (file_cells == NULL)
+            {
+              perror ("Allocating cell flags");
+              exit (-1);
+            }
+
+          ingest_files (&store, &argv[first_input], input_file_count, &options, file_cells);
+
+          for (i = 0 ; i < input_file_count ; i++)
+            memcpy (manifest.input[i].cells, &file_cells[(size_t) i * CELL_COUNT], CELL_COUNT);
+
+          free (file_cells);
+        }
+    }
+  else
+    {
+      ingest_files (&store, &argv[first_input], input_file_count, &options, NULL);
+    }
+
+
+  stats_span_end (span);
+
+  run_stats.spills += store.spills;
+  run_stats.scratch_written += store.scratch_written;
+
+  if (store.spills)
+    {
+      PROGRESS ("Exceeded the %d MB memory limit, spilled %d times to %d scratch file chunks\n\n", max_memory, store.spills,
+                store.num_chunks);
+    }
+
+
+  /*  When we're reusing the previous file we write to a temporary file and rename it at the end.  */
+
+  if (options.streaming)
+    {
+      ofp = stdout;
+
+#ifdef NVWIN3X
+      _setmode (_fileno (stdout), _O_BINARY);
+#endif
+    }
+  else
+    {
+      sprintf (write_name, previous_ptr != NULL ? "%s.tmp" : "%s", outname);
+
+      if ((ofp = fopen (write_name, "wb")) == NULL)
+        {
+          perror (write_name);
+          exit (-1);
+        }
+    }
+
+
+  PROGRESS ("\n\n%s\n\n", outname);
+
+
+  write_version (ofp, &options, file_version);
+
 
-              fclose (fp);
-              remove (fname);
+  span = stats_span_begin ("pass 2", NULL);
 
+  total = encode_cells (&store, ofp, &options, previous_ptr);
 
-              /*  Write the address, number of segments, and number of vertices in the header  */
+  stats_span_end (span);
 
-              fseek (ofp, offset, SEEK_SET);
+  run_stats.scratch_read = store.scratch_read;
 
-              k = 8 * sizeof (int32_t);
 
-              pos = 0;
-              bit_pack (head_buf, pos, k, address); pos += k;
-              bit_pack (head_buf, pos, k, num_segments); pos += k;
-              bit_pack (head_buf, pos, k, num_vertices);
+  /*  encode_cells leaves the file positioned after the header.  */
+
+  if (incremental)
+    {
+      fseek (ofp, 0, SEEK_END);
+      manifest.ccl_size = (int64_t) ftell (ofp);
+    }
+
+  if (fclose (ofp))
+    {
+      perror (outname);
+      exit (-1);
+    }
+
+  cell_store_free (&store);
 
-              fwrite (head_buf, 3 * sizeof (int32_t), 1, ofp);
 
-              fseek (ofp, 0, SEEK_END);
+  if (incremental)
+    {
+      if (previous_ptr != NULL)
+        {
+          previous_ccl_close (&previous);
+
+#ifdef NVWIN3X
+          remove (outname);
+#endif
+
+          if (rename (write_name, outname))
+            {
+              perror (outname);
+              exit (-1);
             }
         }
 
-      percent = (int32_t) (((float) i / 181.0) * 100.0);
-      if (percent != old_percent)
+      strcpy (manifest.file_version, file_version);
+      manifest_write (&manifest, manifest_name);
+
+      manifest_free (&manifest);
+      free (reencode);
+    }
+
+  if (region != NULL) free (region);
+
+  PROGRESS ("100%% packed\n\n");
+  PROGRESS ("Total points packed = %d\n\n", total);
+
+
+  /*  The index is written after the file is in place so that it is never older than the file.  */
+
+  if (!options.streaming)
+    {
+      if (options.index)
+        {
+          index_write (outname);
+        }
+      else
         {
-          fprintf (stderr, "%03d%% packed\r", percent);
-          fflush (stderr);
-          old_percent = percent;
+          index_remove (outname);
         }
     }
 
 
-  fclose (ofp);
+  if (verify)
+    {
+      span = stats_span_begin ("verify", NULL);
+
+      i = verify_file (outname, file_version, &options);
+
+      stats_span_end (span);
+
+      free (options.check);
+
+      if (i)
+        {
+          fprintf (stderr, "Verification of %s failed!\n\n", outname);
+          stats_write ("failed");
+          exit (-1);
+        }
+    }
 
-  fprintf (stderr, "100%% packed\n\n");
-  fprintf (stderr, "Total points packed = %d\n\n", total);
-  fflush (stderr);
+  stats_write ("complete");
+  stats_free ();
 
   return (0);
 }
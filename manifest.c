@@ -0,0 +1,342 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "manifest.h"
+
+
+/*  Bytes read at a time when hashing the input files.  */
+
+#define         HASH_BUFFER_SIZE    (1024 * 1024)
+
+
+/*  FNV-1a style hash of a file, eight bytes at a time.  This isn't the standard byte at a time FNV-1a (so don't
+    compare it to other tools), it just has to notice when a file changes and be fast enough to run on every input.  */
+
+static void hash_file (const char *name, uint64_t *hash, uint8_t *buffer)
+{
+  FILE              *fp;
+  size_t            n, i;
+  uint64_t          word, h = *hash;
+
+
+  if ((fp = fopen (name, "rb")) == NULL)
+    {
+      perror (name);
+      exit (-1);
+    }
+
+  while ((n = fread (buffer, 1, HASH_BUFFER_SIZE, fp)) > 0)
+    {
+      for (i = 0 ; i + 8 <= n ; i += 8)
+        {
+          memcpy (&word, &buffer[i], 8);
+          h = (h ^ word) * 0x100000001b3ULL;
+        }
+
+      for ( ; i < n ; i++) h = (h ^ buffer[i]) * 0x100000001b3ULL;
+    }
+
+  fclose (fp);
+
+  *hash = h;
+}
+
+
+
+/*  Hash the .shp and .shx files for an input file name (with or without the .shp extension).  The .dbf isn't used by
+    build_coast so it isn't included.  */
+
+uint64_t manifest_hash_input (const char *path)
+{
+  char              base[512], name[520], ext[2][5] = {".shp", ".shx"};
+  uint64_t          hash = 0xcbf29ce484222325ULL;
+  uint8_t           *buffer;
+  size_t            len;
+  int32_t           i;
+
+
+  strncpy (base, path, sizeof (base) - 1);
+  base[sizeof (base) - 1] = 0;
+
+  len = strlen (base);
+  if (len > 4 && (!strcmp (&base[len - 4], ".shp") || !strcmp (&base[len - 4], ".SHP")))
+    {
+      if (base[len - 3] == 'S') strcpy (ext[0], ".SHP"), strcpy (ext[1], ".SHX");
+      base[len - 4] = 0;
+    }
+
+  buffer = (uint8_t *) malloc (HASH_BUFFER_SIZE);
+  if (buffer == NULL)
+    {
+      perror ("Allocating hash buffer");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < 2 ; i++)
+    {
+      sprintf (name, "%s%s", base, ext[i]);
+      hash_file (name, &hash, buffer);
+    }
+
+  free (buffer);
+
+  return (hash);
+}
+
+
+
+void manifest_init (MANIFEST *manifest, int32_t num_inputs)
+{
+  int32_t           i;
+
+
+  memset (manifest, 0, sizeof (MANIFEST));
+
+  manifest->num_inputs = num_inputs;
+
+  manifest->input = (MANIFEST_INPUT *) calloc (MAX (num_inputs, 1), sizeof (MANIFEST_INPUT));
+  if (manifest->input == NULL)
+    {
+      perror ("Allocating manifest memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < num_inputs ; i++)
+    {
+      manifest->input[i].cells = (uint8_t *) calloc (CELL_COUNT, 1);
+      if (manifest->input[i].cells == NULL)
+        {
+          perror ("Allocating manifest memory");
+          exit (-1);
+        }
+    }
+}
+
+
+
+void manifest_free (MANIFEST *manifest)
+{
+  int32_t           i;
+
+
+  for (i = 0 ; i < manifest->num_inputs ; i++) free (manifest->input[i].cells);
+
+  free (manifest->input);
+  manifest->input = NULL;
+  manifest->num_inputs = 0;
+}
+
+
+
+/*  Read "[KEY] = value" from the next line of the manifest.  Returns NVFalse if the line doesn't start with key.  */
+
+static uint8_t read_value (FILE *fp, const char *key, char *value, size_t size)
+{
+  char              line[1024];
+  size_t            len = strlen (key);
+
+
+  if (fgets (line, sizeof (line), fp) == NULL) return (NVFalse);
+
+  if (strncmp (line, key, len) || strncmp (&line[len], " = ", 3)) return (NVFalse);
+
+  strncpy (value, &line[len + 3], size - 1);
+  value[size - 1] = 0;
+
+  len = strlen (value);
+  while (len && (value[len - 1] == '\n' || value[len - 1] == '\r')) value[--len] = 0;
+
+  return (NVTrue);
+}
+
+
+
+/*  Read a manifest.  Returns NVFalse (and leaves manifest empty) if the file doesn't exist or doesn't make sense, in
+    which case the caller just does a full build.  */
+
+uint8_t manifest_read (MANIFEST *manifest, const char *name)
+{
+  FILE              *fp;
+  char              value[1024], file_version[VERSION_SIZE], bbox[128], lod[128];
+  int32_t           i, j, num_inputs, version, count, cell, merge;
+  long long         ccl_size;
+  unsigned long long hash;
+
+
+  memset (manifest, 0, sizeof (MANIFEST));
+
+  if ((fp = fopen (name, "r")) == NULL) return (NVFalse);
+
+  if (!read_value (fp, "[MANIFEST VERSION]", value, sizeof (value)) || sscanf (value, "%d", &version) != 1 ||
+      version != MANIFEST_VERSION) goto bad;
+
+  if (!read_value (fp, "[FILE VERSION]", file_version, sizeof (file_version))) goto bad;
+
+  if (!read_value (fp, "[CCL SIZE]", value, sizeof (value)) || sscanf (value, "%lld", &ccl_size) != 1) goto bad;
+
+  if (!read_value (fp, "[BBOX]", bbox, sizeof (bbox))) goto bad;
+
+  if (!read_value (fp, "[LOD]", lod, sizeof (lod))) goto bad;
+
+  if (!read_value (fp, "[MERGE]", value, sizeof (value)) || sscanf (value, "%d", &merge) != 1) goto bad;
+
+  if (!read_value (fp, "[INPUTS]", value, sizeof (value)) || sscanf (value, "%d", &num_inputs) != 1 || num_inputs < 1)
+    goto bad;
+
+
+  manifest_init (manifest, num_inputs);
+  strcpy (manifest->file_version, file_version);
+  strcpy (manifest->bbox, bbox);
+  strcpy (manifest->lod, lod);
+  manifest->merge = (uint8_t) merge;
+  manifest->ccl_size = ccl_size;
+
+  for (i = 0 ; i < num_inputs ; i++)
+    {
+      if (!read_value (fp, "[INPUT]", manifest->input[i].path, sizeof (manifest->input[i].path))) goto bad;
+
+      if (!read_value (fp, "[HASH]", value, sizeof (value)) || sscanf (value, "%llx", &hash) != 1) goto bad;
+      manifest->input[i].hash = hash;
+
+      if (!read_value (fp, "[CELLS]", value, sizeof (value)) || sscanf (value, "%d", &count) != 1) goto bad;
+
+      for (j = 0 ; j < count ; j++)
+        {
+          if (fscanf (fp, "%d", &cell) != 1 || cell < 0 || cell >= CELL_COUNT) goto bad;
+          manifest->input[i].cells[cell] = NVTrue;
+        }
+
+      /*  Skip the end of the last line of cell numbers.  */
+
+      if (count && fgets (value, sizeof (value), fp) == NULL) goto bad;
+    }
+
+  fclose (fp);
+
+  return (NVTrue);
+
+
+ bad:
+  fclose (fp);
+  manifest_free (manifest);
+
+  return (NVFalse);
+}
+
+
+
+/*  Write the manifest to a temporary file and rename it into place so that we never leave a partial one behind.  */
+
+void manifest_write (MANIFEST *manifest, const char *name)
+{
+  FILE              *fp;
+  char              tmp_name[1024];
+  int32_t           i, j, count;
+
+
+  sprintf (tmp_name, "%s.tmp", name);
+
+  if ((fp = fopen (tmp_name, "w")) == NULL)
+    {
+      perror (tmp_name);
+      exit (-1);
+    }
+
+  fprintf (fp, "[MANIFEST VERSION] = %d\n", MANIFEST_VERSION);
+  fprintf (fp, "[FILE VERSION] = %s\n", manifest->file_version);
+  fprintf (fp, "[CCL SIZE] = %lld\n", (long long) manifest->ccl_size);
+  fprintf (fp, "[BBOX] = %s\n", manifest->bbox);
+  fprintf (fp, "[LOD] = %s\n", manifest->lod);
+  fprintf (fp, "[MERGE] = %d\n", manifest->merge);
+  fprintf (fp, "[INPUTS] = %d\n", manifest->num_inputs);
+
+  for (i = 0 ; i < manifest->num_inputs ; i++)
+    {
+      fprintf (fp, "[INPUT] = %s\n", manifest->input[i].path);
+      fprintf (fp, "[HASH] = %016llx\n", (unsigned long long) manifest->input[i].hash);
+
+      for (j = 0, count = 0 ; j < CELL_COUNT ; j++) if (manifest->input[i].cells[j]) count++;
+
+      fprintf (fp, "[CELLS] = %d\n", count);
+
+      for (j = 0, count = 0 ; j < CELL_COUNT ; j++)
+        {
+          if (manifest->input[i].cells[j])
+            {
+              fprintf (fp, (++count % 16) ? "%d " : "%d\n", j);
+            }
+        }
+
+      if (count % 16) fprintf (fp, "\n");
+    }
+
+  if (fclose (fp))
+    {
+      perror (tmp_name);
+      exit (-1);
+    }
+
+#ifdef NVWIN3X
+  remove (name);
+#endif
+
+  if (rename (tmp_name, name))
+    {
+      perror (name);
+      exit (-1);
+    }
+}
+
+
+
+/*  Open the previous version of the .ccl file (through the .ccl reader, which loads the headers of every level of
+    detail and works out the cell record sizes).  It has to have the expected version block and size (from the
+    manifest), otherwise we return NVFalse and the caller does a full build.  */
+
+uint8_t previous_ccl_open (PREVIOUS_CCL *previous, const char *name, const char *file_version, int64_t size)
+{
+  size_t            len = strlen (file_version);
+
+
+  memset (previous, 0, sizeof (PREVIOUS_CCL));
+
+  if ((previous->ccl = ccl_open (name, 1)) == NULL) return (NVFalse);
+
+  if ((int64_t) previous->ccl->size != size || strncmp (previous->ccl->version, file_version, len) ||
+      previous->ccl->version[len] != '\n')
+    {
+      previous_ccl_close (previous);
+      return (NVFalse);
+    }
+
+  return (NVTrue);
+}
+
+
+
+void previous_ccl_close (PREVIOUS_CCL *previous)
+{
+  if (previous->ccl != NULL) ccl_close (previous->ccl);
+
+  memset (previous, 0, sizeof (PREVIOUS_CCL));
+}
@@ -0,0 +1,71 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __MANIFEST_H__
+#define __MANIFEST_H__
+
+#include "build_coast.h"
+#include "encode.h"
+
+
+/*  Version of the manifest file layout (not the .ccl format).  */
+
+#define         MANIFEST_VERSION    3
+
+
+/*  What one input file looked like the last time the .ccl file was built.  */
+
+typedef struct
+{
+  char          path[512];              /*  Input file name as given on the command line  */
+  uint64_t      hash;                   /*  Hash of the .shp and .shx file contents  */
+  uint8_t       *cells;                 /*  CELL_COUNT flags, NVTrue for each cell the file added segments to  */
+} MANIFEST_INPUT;
+
+
+/*  The sidecar file (OUTPUT_FILE.ccl.manifest) that lets --incremental rebuild only the cells touched by changed
+    inputs.  The cell addresses and sizes aren't needed here since they can be recovered from the .ccl header (the
+    cells are written back to back in header order).  */
+
+typedef struct
+{
+  char          file_version[VERSION_SIZE]; /*  FILE_VERSION of the .ccl file  */
+  int64_t       ccl_size;               /*  Size of the .ccl file that this manifest describes  */
+  char          bbox[128];              /*  --bbox used to build the file (or "none")  */
+  char          lod[128];               /*  --lod tolerances used to build the file (or "none")  */
+  uint8_t       merge;                  /*  NVTrue if the file was built with --merge  */
+  int32_t       num_inputs;
+  MANIFEST_INPUT *input;
+} MANIFEST;
+
+
+uint64_t manifest_hash_input (const char *path);
+void manifest_init (MANIFEST *manifest, int32_t num_inputs);
+uint8_t manifest_read (MANIFEST *manifest, const char *name);
+void manifest_write (MANIFEST *manifest, const char *name);
+void manifest_free (MANIFEST *manifest);
+uint8_t previous_ccl_open (PREVIOUS_CCL *previous, const char *name, const char *file_version, int64_t size);
+void previous_ccl_close (PREVIOUS_CCL *previous);
+
+
+#endif
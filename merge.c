@@ -0,0 +1,255 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#include "merge.h"
+
+
+void merge_buffer_init (MERGE_BUFFER *buf)
+{
+  memset (buf, 0, sizeof (MERGE_BUFFER));
+}
+
+
+
+void merge_buffer_free (MERGE_BUFFER *buf)
+{
+  if (buf->data != NULL) free (buf->data);
+  if (buf->record != NULL) free (buf->record);
+  if (buf->next != NULL) free (buf->next);
+  if (buf->hash != NULL) free (buf->hash);
+
+  merge_buffer_init (buf);
+}
+
+
+
+static void merge_buffer_grow (MERGE_BUFFER *buf, int32_t num, size_t count)
+{
+  if (num > buf->alloc)
+    {
+      buf->alloc = buf->alloc ? buf->alloc : 1024;
+      while (buf->alloc < num) buf->alloc *= 2;
+
+      if (buf->record != NULL) free (buf->record);
+      if (buf->next != NULL) free (buf->next);
+
+      buf->record = (size_t *) malloc ((size_t) buf->alloc * sizeof (size_t));
+      buf->next = (int32_t *) malloc ((size_t) buf->alloc * (2 * sizeof (int32_t) + 1));
+      if (buf->record == NULL || buf->next == NULL)
+        {
+          perror ("Allocating segment merge memory");
+          exit (-1);
+        }
+
+      buf->prev = buf->next + buf->alloc;
+      buf->done = (uint8_t *) (buf->prev + buf->alloc);
+    }
+
+  if (2 * num > buf->hash_alloc)
+    {
+      buf->hash_alloc = buf->hash_alloc ? buf->hash_alloc : 2048;
+      while (buf->hash_alloc < 2 * num) buf->hash_alloc *= 2;
+
+      if (buf->hash != NULL) free (buf->hash);
+
+      if ((buf->hash = (int32_t *) malloc ((size_t) buf->hash_alloc * sizeof (int32_t))) == NULL)
+        {
+          perror ("Allocating segment merge memory");
+          exit (-1);
+        }
+    }
+
+  if (count > buf->data_alloc)
+    {
+      buf->data_alloc = buf->data_alloc ? buf->data_alloc : 65536;
+      while (buf->data_alloc < count) buf->data_alloc *= 2;
+
+      if (buf->data != NULL) free (buf->data);
+
+      if ((buf->data = (int32_t *) malloc (buf->data_alloc * sizeof (int32_t))) == NULL)
+        {
+          perror ("Allocating segment merge memory");
+          exit (-1);
+        }
+    }
+}
+
+
+
+static uint32_t point_hash (const int32_t *xy, int32_t mask)
+{
+  return ((((uint32_t) xy[0] * 0x9e3779b1u) ^ ((uint32_t) xy[1] * 0x85ebca77u)) >> 7) & (uint32_t) mask;
+}
+
+
+
+/*  A segment is degenerate if it doesn't have at least two different vertices.  */
+
+static uint8_t degenerate (const int32_t *xy, int32_t count)
+{
+  int32_t           k;
+
+
+  for (k = 1 ; k < count ; k++) if (xy[2 * k] != xy[0] || xy[2 * k + 1] != xy[1]) return (NVFalse);
+
+  return (NVTrue);
+}
+
+
+
+/*  Join the segments of a cell (cell store records, cell_count int32_t values) whose end points coincide and drop the
+    degenerate ones.  This undoes most of the splitting that pass 1 does when a line wanders back and forth across a
+    cell boundary or an input file ends, so far fewer segment headers get packed.  A segment is joined to the next one
+    in the cell if that one starts where it ends, otherwise to the first segment that starts there and hasn't been
+    joined to anything yet (this closes rings that were split at their start point).  Each joined run is written in
+    place of its first segment and the shared vertex is only stored once, so the output is the same no matter how the
+    cell was stored.  Returns the new records (in buf, with the new count in cell_count) or cell_data if nothing
+    changed.  */
+
+int32_t *merge_segments (MERGE_BUFFER *buf, int32_t *cell_data, size_t *cell_count)
+{
+  int32_t           i, j, k, n, num, dropped, joined, mask, head, count, *xy, *end;
+  size_t            rec, pos, count_pos;
+  uint32_t          h;
+
+
+  /*  Number of segments, so we only have to grow once.  */
+
+  for (rec = 0, num = 0 ; rec < *cell_count ; rec += 1 + 2 * (size_t) cell_data[rec]) num++;
+
+  merge_buffer_grow (buf, num, *cell_count);
+
+
+  dropped = 0;
+
+  for (rec = 0, n = 0 ; rec < *cell_count ; rec += 1 + 2 * (size_t) cell_data[rec])
+    {
+      if (!cell_data[rec]) continue;
+
+      if (degenerate (&cell_data[rec + 1], cell_data[rec]))
+        {
+          dropped++;
+          continue;
+        }
+
+      buf->record[n] = rec;
+      buf->next[n] = buf->prev[n] = -1;
+      buf->done[n] = NVFalse;
+      n++;
+    }
+
+
+  mask = buf->hash_alloc - 1;
+  for (i = 0 ; i <= mask ; i++) buf->hash[i] = -1;
+
+  for (i = 0 ; i < n ; i++)
+    {
+      h = point_hash (&cell_data[buf->record[i] + 1], mask);
+      while (buf->hash[h] >= 0) h = (h + 1) & mask;
+      buf->hash[h] = i;
+    }
+
+
+  joined = 0;
+
+  for (i = 0 ; i < n ; i++)
+    {
+      count = cell_data[buf->record[i]];
+      end = &cell_data[buf->record[i] + 1 + 2 * (size_t) (count - 1)];
+
+      j = -1;
+
+      if (i + 1 < n && buf->prev[i + 1] < 0 && cell_data[buf->record[i + 1] + 1] == end[0] &&
+          cell_data[buf->record[i + 1] + 2] == end[1])
+        {
+          j = i + 1;
+        }
+      else
+        {
+          for (h = point_hash (end, mask) ; buf->hash[h] >= 0 ; h = (h + 1) & mask)
+            {
+              k = buf->hash[h];
+              xy = &cell_data[buf->record[k] + 1];
+
+              if (k != i && buf->prev[k] < 0 && xy[0] == end[0] && xy[1] == end[1])
+                {
+                  if (j < 0 || k < j) j = k;
+                }
+            }
+        }
+
+      if (j >= 0)
+        {
+          buf->next[i] = j;
+          buf->prev[j] = i;
+          joined++;
+        }
+    }
+
+
+  if (!joined && !dropped) return (cell_data);
+
+
+  /*  Write each run when we get to its lowest numbered segment.  Runs that loop back on themselves are cut in front of
+      that segment.  */
+
+  pos = 0;
+
+  for (i = 0 ; i < n ; i++)
+    {
+      if (buf->done[i]) continue;
+
+      for (head = i ; buf->prev[head] >= 0 && buf->prev[head] != i ; head = buf->prev[head]);
+
+      if (buf->prev[head] == i)
+        {
+          buf->next[buf->prev[i]] = -1;
+          buf->prev[i] = -1;
+          head = i;
+          joined--;
+        }
+
+      count_pos = pos++;
+      count = 0;
+
+      for (k = head ; k >= 0 ; k = buf->next[k])
+        {
+          rec = buf->record[k];
+          j = count ? 1 : 0;
+
+          memcpy (&buf->data[pos], &cell_data[rec + 1 + 2 * j], 2 * (size_t) (cell_data[rec] - j) * sizeof (int32_t));
+          pos += 2 * (size_t) (cell_data[rec] - j);
+          count += cell_data[rec] - j;
+
+          buf->done[k] = NVTrue;
+        }
+
+      buf->data[count_pos] = count;
+    }
+
+  buf->joined += joined;
+  buf->dropped += dropped;
+
+  *cell_count = pos;
+
+  return (buf->data);
+}
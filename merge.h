@@ -0,0 +1,52 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#ifndef __MERGE_H__
+#define __MERGE_H__
+
+#include "build_coast.h"
+
+
+/*  Work space for joining the segments of a cell (--merge).  Each encoder thread has one and it only grows.  */
+
+typedef struct
+{
+  int32_t       *data;                  /*  Joined segment records (same layout as the cell store records)  */
+  size_t        data_alloc;             /*  Number of int32_t values allocated for data  */
+  size_t        *record;                /*  Position of each kept segment in the cell store records  */
+  int32_t       *next;                  /*  Segment joined to the end of each segment or -1  */
+  int32_t       *prev;                  /*  Segment joined to the start of each segment or -1  */
+  uint8_t       *done;                  /*  Segments that have been written to data  */
+  int32_t       alloc;                  /*  Number of segments allocated  */
+  int32_t       *hash;                  /*  Open addressing table of segments by start point  */
+  int32_t       hash_alloc;             /*  Number of hash slots (a power of 2)  */
+  int32_t       joined;                 /*  Total number of segments joined to another one  */
+  int32_t       dropped;                /*  Total number of degenerate segments dropped  */
+} MERGE_BUFFER;
+
+
+void merge_buffer_init (MERGE_BUFFER *buf);
+void merge_buffer_free (MERGE_BUFFER *buf);
+int32_t *merge_segments (MERGE_BUFFER *buf, int32_t *cell_data, size_t *cell_count);
+
+
+#endif
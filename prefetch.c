@@ -0,0 +1,287 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#include "prefetch.h"
+#include "shp_map.h"
+
+
+
+/*  Ask the kernel to start reading the .shp records of the next PREFETCH_WINDOW bytes past shape i so the reads
+    that SHPReadObject does are already in the page cache.  This is only a hint so errors are ignored.  We use our own
+    descriptor and the record offsets from the .shx file rather than anything inside the shapelib handle.  */
+
+static void advise_ahead (SHAPE_PREFETCH *pf, int32_t i)
+{
+#if !defined (NVWIN3X) && defined (POSIX_FADV_WILLNEED)
+  int64_t           offset;
+
+
+  if (pf->fd < 0 || pf->offset == NULL || i >= pf->end) return;
+
+  offset = pf->offset[i - pf->range_first];
+
+  if (offset + PREFETCH_WINDOW / 2 < pf->advised) return;
+
+  if (offset > pf->advised) pf->advised = offset;
+
+  posix_fadvise (pf->fd, (off_t) pf->advised, (off_t) PREFETCH_WINDOW, POSIX_FADV_WILLNEED);
+
+  pf->advised += PREFETCH_WINDOW;
+#endif
+}
+
+
+
+/*  Read the next shape in the range (skipping the records that shapelib can't read).  Returns NULL at the end.  */
+
+static SHPObject *read_shape (SHAPE_PREFETCH *pf)
+{
+  SHPObject         *shape;
+
+
+  while (pf->first < pf->end)
+    {
+      advise_ahead (pf, pf->first);
+
+      if ((shape = SHPReadObject (pf->handle, pf->first++)) != NULL) return (shape);
+    }
+
+  return (NULL);
+}
+
+
+
+static void *prefetch_thread (void *arg)
+{
+  SHAPE_PREFETCH    *pf = (SHAPE_PREFETCH *) arg;
+  PREFETCH_BATCH    *batch;
+  SHPObject         *shape;
+  int32_t           vertices;
+  uint8_t           stop, done;
+
+
+  while (NVTrue)
+    {
+      pthread_mutex_lock (&pf->mutex);
+      while (pf->filled == pf->depth && !pf->stop) pthread_cond_wait (&pf->not_full, &pf->mutex);
+      stop = pf->stop;
+      pthread_mutex_unlock (&pf->mutex);
+
+      if (stop) break;
+
+
+      /*  The splitter doesn't look at the tail batch until it's counted in filled so we can fill it unlocked.  */
+
+      batch = &pf->ring[pf->tail];
+      batch->count = batch->next = 0;
+      vertices = 0;
+
+      while (batch->count < PREFETCH_BATCH_SHAPES && vertices < PREFETCH_BATCH_VERTICES &&
+             (shape = read_shape (pf)) != NULL)
+        {
+          batch->shape[batch->count++] = shape;
+          vertices += shape->nVertices;
+        }
+
+      pthread_mutex_lock (&pf->mutex);
+
+      if (batch->count)
+        {
+          pf->tail = (pf->tail + 1) % pf->depth;
+          pf->filled++;
+        }
+
+      if (pf->first >= pf->end) pf->done = NVTrue;
+      done = pf->done;
+
+      pthread_cond_signal (&pf->not_empty);
+      pthread_mutex_unlock (&pf->mutex);
+
+      if (done) break;
+    }
+
+  return (NULL);
+}
+
+
+
+/*  Open name with shapelib and start reading shapes first to end - 1 on a background thread, keeping up to depth
+    batches of decoded shapes ready.  A depth of 0 reads each shape when prefetch_next asks for it.  */
+
+void prefetch_open (SHAPE_PREFETCH *pf, const char *name, int32_t first, int32_t end, int32_t depth)
+{
+  int32_t           i;
+
+
+  memset (pf, 0, sizeof (SHAPE_PREFETCH));
+
+  if ((pf->handle = SHPOpen (name, "rb")) == NULL)
+    {
+      perror (name);
+      exit (-1);
+    }
+
+  pf->first = pf->range_first = first;
+  pf->end = end;
+  pf->depth = depth;
+  pf->fd = -1;
+
+
+#if !defined (NVWIN3X) && defined (POSIX_FADV_SEQUENTIAL)
+
+  /*  We read the records in order so a bigger kernel read ahead helps either way.  */
+
+  if ((pf->fd = shp_map_open_file (name, "shp")) >= 0)
+    {
+      posix_fadvise (pf->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+      if (end > first)
+        {
+          if ((pf->offset = (int64_t *) malloc ((size_t) (end - first) * sizeof (int64_t))) == NULL)
+            {
+              perror ("Allocating prefetch memory");
+              exit (-1);
+            }
+
+          if (!shp_map_read_offsets (name, first, end, pf->offset))
+            {
+              free (pf->offset);
+              pf->offset = NULL;
+            }
+        }
+    }
+#endif
+
+
+  if (!depth || first >= end) return;
+
+
+  if ((pf->ring = (PREFETCH_BATCH *) calloc (depth, sizeof (PREFETCH_BATCH))) == NULL)
+    {
+      perror ("Allocating prefetch ring");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < depth ; i++)
+    {
+      if ((pf->ring[i].shape = (SHPObject **) malloc (PREFETCH_BATCH_SHAPES * sizeof (SHPObject *))) == NULL)
+        {
+          perror ("Allocating prefetch batch");
+          exit (-1);
+        }
+    }
+
+  pthread_mutex_init (&pf->mutex, NULL);
+  pthread_cond_init (&pf->not_full, NULL);
+  pthread_cond_init (&pf->not_empty, NULL);
+
+  if (pthread_create (&pf->thread, NULL, prefetch_thread, pf))
+    {
+      perror ("Creating prefetch thread");
+      exit (-1);
+    }
+}
+
+
+
+/*  Return the next shape (in record order) or NULL when there are no more.  The caller owns the shape and has to
+    SHPDestroyObject it.  */
+
+SHPObject *prefetch_next (SHAPE_PREFETCH *pf)
+{
+  PREFETCH_BATCH    *batch = pf->current;
+
+
+  if (pf->ring == NULL) return (read_shape (pf));
+
+  if (batch != NULL && batch->next < batch->count) return (batch->shape[batch->next++]);
+
+
+  /*  Give the batch we just finished back to the reader and wait for the next one.  */
+
+  pthread_mutex_lock (&pf->mutex);
+
+  if (batch != NULL)
+    {
+      pf->head = (pf->head + 1) % pf->depth;
+      pf->filled--;
+      pthread_cond_signal (&pf->not_full);
+    }
+
+  if (!pf->filled && !pf->done)
+    {
+      pf->stalls++;
+      while (!pf->filled && !pf->done) pthread_cond_wait (&pf->not_empty, &pf->mutex);
+    }
+
+  batch = pf->current = pf->filled ? &pf->ring[pf->head] : NULL;
+
+  pthread_mutex_unlock (&pf->mutex);
+
+
+  if (batch == NULL) return (NULL);
+
+  return (batch->shape[batch->next++]);
+}
+
+
+
+/*  Stop the reader (if it's still going), free anything that wasn't handed out, and close the shapefile.  */
+
+void prefetch_close (SHAPE_PREFETCH *pf)
+{
+  PREFETCH_BATCH    *batch;
+  int32_t           i, j;
+
+
+  if (pf->ring != NULL)
+    {
+      pthread_mutex_lock (&pf->mutex);
+      pf->stop = NVTrue;
+      pthread_cond_signal (&pf->not_full);
+      pthread_mutex_unlock (&pf->mutex);
+
+      pthread_join (pf->thread, NULL);
+
+      for (i = 0 ; i < pf->filled ; i++)
+        {
+          batch = &pf->ring[(pf->head + i) % pf->depth];
+          for (j = batch->next ; j < batch->count ; j++) SHPDestroyObject (batch->shape[j]);
+        }
+
+      for (i = 0 ; i < pf->depth ; i++) free (pf->ring[i].shape);
+      free (pf->ring);
+
+      pthread_mutex_destroy (&pf->mutex);
+      pthread_cond_destroy (&pf->not_full);
+      pthread_cond_destroy (&pf->not_empty);
+    }
+
+  SHPClose (pf->handle);
+
+#ifndef NVWIN3X
+  if (pf->fd >= 0) close (pf->fd);
+#endif
+  if (pf->offset != NULL) free (pf->offset);
+
+  memset (pf, 0, sizeof (SHAPE_PREFETCH));
+}
@@ -0,0 +1,92 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#ifndef __PREFETCH_H__
+#define __PREFETCH_H__
+
+#include <pthread.h>
+
+#include "build_coast.h"
+
+
+/*  Default number of batches of shapes that the reader thread may get ahead of the segment splitter (--prefetch).  */
+
+#define         DEFAULT_PREFETCH    4
+
+
+/*  A batch is closed when it has this many shapes or this many vertices, whichever comes first.  */
+
+#define         PREFETCH_BATCH_SHAPES   256
+#define         PREFETCH_BATCH_VERTICES (1 << 18)
+
+
+/*  Bytes of the .shp file that we ask the kernel to read ahead of the reader thread.  */
+
+#define         PREFETCH_WINDOW     (8 << 20)
+
+
+/*  Decoded shapes waiting to be split.  */
+
+typedef struct
+{
+  SHPObject     **shape;                /*  PREFETCH_BATCH_SHAPES shapes (shapelib skips bad records so none are NULL)  */
+  int32_t       count;                  /*  Number of shapes in the batch  */
+  int32_t       next;                   /*  Next shape to hand out  */
+} PREFETCH_BATCH;
+
+
+/*  Reads a range of shapes from a shapefile with shapelib on a background thread and hands them over in batches
+    through a ring of depth batches.  The reader blocks when the ring is full and the splitter blocks when it's empty
+    so no more than depth batches are ever held in memory.  With a depth of 0 there is no thread and the shapes are
+    read as they are asked for.  */
+
+typedef struct
+{
+  SHPHandle     handle;
+  int32_t       first;                  /*  Next shape to read  */
+  int32_t       end;                    /*  One past the last shape to read  */
+  int32_t       depth;                  /*  Number of batches in the ring, 0 to read synchronously  */
+  PREFETCH_BATCH *ring;
+  PREFETCH_BATCH *current;              /*  Batch being handed out (the head of the ring), NULL before the first one  */
+  int32_t       head;                   /*  Oldest full batch  */
+  int32_t       tail;                   /*  Batch being filled by the reader  */
+  int32_t       filled;                 /*  Number of full batches in the ring  */
+  uint8_t       done;                   /*  The reader has read the last shape  */
+  uint8_t       stop;                   /*  Tell the reader to quit early (prefetch_close before the end)  */
+  int           fd;                     /*  Our own descriptor for the .shp file (for posix_fadvise), -1 if none  */
+  int32_t       range_first;            /*  First shape in the range  */
+  int64_t       *offset;                /*  .shp offsets of the shapes in the range (from the .shx file), or NULL  */
+  int64_t       advised;                /*  .shp offset up to which the kernel has been asked to read ahead  */
+  int64_t       stalls;                 /*  Number of times the splitter had to wait for the reader  */
+  pthread_t     thread;
+  pthread_mutex_t mutex;
+  pthread_cond_t not_full;
+  pthread_cond_t not_empty;
+} SHAPE_PREFETCH;
+
+
+void prefetch_open (SHAPE_PREFETCH *pf, const char *name, int32_t first, int32_t end, int32_t depth);
+SHPObject *prefetch_next (SHAPE_PREFETCH *pf);
+void prefetch_close (SHAPE_PREFETCH *pf);
+
+
+#endif
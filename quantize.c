@@ -0,0 +1,589 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "quantize.h"
+
+#if defined (__AVX__)
+#include <immintrin.h>
+#elif defined (__SSE2__)
+#include <emmintrin.h>
+#elif defined (__ARM_NEON) && defined (__aarch64__)
+#include <arm_neon.h>
+#endif
+
+
+/*  Converting the vertices of a whole shape at once lets the compiler (or the SIMD code below) do the bias, the cell
+    truncation, and the NINT scaling for several vertices per instruction.  Every vertex goes through the same steps:
+
+        lon = x + 180.0, wrapped once by 360 if it is above 360 or below 0 (files that use 0 to 360 longitudes)
+        lon and lat clamped to 0-360 and 0-180
+        londeg = (int32_t) (MIN (lon, LON_CELL_LIMIT) * CELLS_PER_DEGREE), the same for latdeg
+        fixed = NINT (lon * POSITION_SCALE)
+
+    The wraps and clamps are selects and min/max so there is no per vertex branch.  Points at exactly 180 keep their
+    position and land in the last cell column (they are on its east edge), and the poles land in the first and last
+    rows, so the grid edges always give the same cells no matter which way a shape approaches them.  Each step is done
+    in the same order, in double precision, with the same truncation in the scalar and vector versions.  NINT adds 0.5
+    (or -0.5 for negative values) and truncates, which is what the vector versions do with a sign mask.
+
+    Once a shape is quantized it is normalized (quantize_normalize).  A step of more than half the world in longitude
+    can only be a line crossing the antimeridian, so it is split there.  The two halves get an interpolated vertex on
+    their side of the 180 line and the second half starts a new segment.  A step that runs along the antimeridian or a
+    pole is just closing a polygon at the edge of the grid so the line is broken there instead (this replaces the old
+    idea of throwing away every point at exactly 180).  This is all done once per shape, the splitter in ingest.c
+    never looks at the boundary.  */
+
+
+/*  Anything from here up to the east edge (or the north pole) is in the last cell column (or row).  */
+
+#define         LON_CELL_LIMIT      (360.0 - 0.5 * CELL_DEGREES)
+#define         LAT_CELL_LIMIT      (180.0 - 0.5 * CELL_DEGREES)
+
+
+#define         HALF_WORLD          (180 * (int32_t) POSITION_SCALE)
+#define         FULL_WORLD          (360 * (int32_t) POSITION_SCALE)
+#define         NORTH_POLE          (180 * (int32_t) POSITION_SCALE)
+
+
+/*  Kinds of boundary step (see boundary_step).  */
+
+#define         STEP_CROSSES        1
+#define         STEP_ON_EDGE        2
+
+
+static int32_t *quant_block (int32_t size)
+{
+  int32_t       *block;
+
+
+  block = (int32_t *) malloc (4 * (size_t) size * sizeof (int32_t));
+  if (block == NULL)
+    {
+      perror ("Allocating quantization memory");
+      exit (-1);
+    }
+
+  return (block);
+}
+
+
+
+void quant_buffer_init (QUANT_BUFFER *quant)
+{
+  quant->lon = quant->lat = quant->londeg = quant->latdeg = NULL;
+  quant->size = quant->count = 0;
+  quant->part = quant->spare = NULL;
+  quant->num_parts = quant->part_size = 0;
+}
+
+
+
+void quant_buffer_free (QUANT_BUFFER *quant)
+{
+  if (quant->lon != NULL) free (quant->lon);
+  if (quant->spare != NULL) free (quant->spare);
+  if (quant->part != NULL) free (quant->part);
+
+  quant_buffer_init (quant);
+}
+
+
+
+/*  All four arrays are carved out of a single allocation that is doubled whenever a shape has more vertices than we've
+    seen before.  The first keep vertices are copied to the new arrays.  */
+
+static void quant_buffer_grow (QUANT_BUFFER *quant, int32_t count, int32_t keep)
+{
+  int32_t       size = quant->size ? quant->size : 1024, *block;
+
+
+  while (size < count) size *= 2;
+
+  block = quant_block (size);
+
+  if (keep)
+    {
+      memcpy (block, quant->lon, keep * sizeof (int32_t));
+      memcpy (block + size, quant->lat, keep * sizeof (int32_t));
+      memcpy (block + 2 * size, quant->londeg, keep * sizeof (int32_t));
+      memcpy (block + 3 * size, quant->latdeg, keep * sizeof (int32_t));
+    }
+
+  if (quant->lon != NULL) free (quant->lon);
+  if (quant->spare != NULL) free (quant->spare);
+  quant->spare = NULL;
+
+  quant->lon = block;
+  quant->lat = quant->lon + size;
+  quant->londeg = quant->lat + size;
+  quant->latdeg = quant->londeg + size;
+  quant->size = size;
+}
+
+
+
+static void quant_part_grow (QUANT_BUFFER *quant, int32_t count)
+{
+  int32_t       size = quant->part_size ? quant->part_size : 256;
+
+
+  while (size < count) size *= 2;
+
+  quant->part = (int32_t *) realloc (quant->part, size * sizeof (int32_t));
+  if (quant->part == NULL)
+    {
+      perror ("Allocating part memory");
+      exit (-1);
+    }
+
+  quant->part_size = size;
+}
+
+
+
+static inline void quantize_vertex (double x, double y, QUANT_BUFFER *quant, int32_t j)
+{
+  double        lon, lat, a, b;
+
+
+  /*  Bias lat and lon by 90 and 180 so that all points are positive  */
+
+  lon = x + 180.0;
+  lat = y + 90.0;
+
+
+  /*  Wrap and clamp to the grid.  Written as selects so that the compiler doesn't have to branch.  */
+
+  lon = (lon > 360.0) ? lon - 360.0 : lon;
+  lon = (lon < 0.0) ? lon + 360.0 : lon;
+  lon = (lon > 0.0) ? lon : 0.0;
+  lon = (lon < 360.0) ? lon : 360.0;
+  lat = (lat > 0.0) ? lat : 0.0;
+  lat = (lat < 180.0) ? lat : 180.0;
+
+
+  quant->londeg[j] = (int32_t) (((lon < LON_CELL_LIMIT) ? lon : LON_CELL_LIMIT) * CELLS_PER_DEGREE);
+  quant->latdeg[j] = (int32_t) (((lat < LAT_CELL_LIMIT) ? lat : LAT_CELL_LIMIT) * CELLS_PER_DEGREE);
+
+  a = lon * POSITION_SCALE;
+  b = lat * POSITION_SCALE;
+
+  quant->lon[j] = NINT (a);
+  quant->lat[j] = NINT (b);
+}
+
+
+
+#if defined (__AVX__)
+
+static inline void quantize_avx (__m256d x, __m256d y, QUANT_BUFFER *quant, int32_t j)
+{
+  const __m256d half = _mm256_set1_pd (0.5), neg_half = _mm256_set1_pd (-0.5), zero = _mm256_setzero_pd ();
+  const __m256d scale = _mm256_set1_pd (POSITION_SCALE), world = _mm256_set1_pd (360.0);
+  const __m256d cells = _mm256_set1_pd (CELLS_PER_DEGREE);
+  __m256d       lon, lat, a, b;
+
+
+  lon = _mm256_add_pd (x, _mm256_set1_pd (180.0));
+  lat = _mm256_add_pd (y, _mm256_set1_pd (90.0));
+
+  lon = _mm256_blendv_pd (lon, _mm256_sub_pd (lon, world), _mm256_cmp_pd (lon, world, _CMP_GT_OQ));
+  lon = _mm256_blendv_pd (lon, _mm256_add_pd (lon, world), _mm256_cmp_pd (lon, zero, _CMP_LT_OQ));
+  lon = _mm256_min_pd (_mm256_max_pd (lon, zero), world);
+  lat = _mm256_min_pd (_mm256_max_pd (lat, zero), _mm256_set1_pd (180.0));
+
+  a = _mm256_mul_pd (_mm256_min_pd (lon, _mm256_set1_pd (LON_CELL_LIMIT)), cells);
+  b = _mm256_mul_pd (_mm256_min_pd (lat, _mm256_set1_pd (LAT_CELL_LIMIT)), cells);
+
+  _mm_storeu_si128 ((__m128i *) &quant->londeg[j], _mm256_cvttpd_epi32 (a));
+  _mm_storeu_si128 ((__m128i *) &quant->latdeg[j], _mm256_cvttpd_epi32 (b));
+
+  a = _mm256_mul_pd (lon, scale);
+  b = _mm256_mul_pd (lat, scale);
+
+  a = _mm256_add_pd (a, _mm256_blendv_pd (half, neg_half, _mm256_cmp_pd (a, zero, _CMP_LT_OQ)));
+  b = _mm256_add_pd (b, _mm256_blendv_pd (half, neg_half, _mm256_cmp_pd (b, zero, _CMP_LT_OQ)));
+
+  _mm_storeu_si128 ((__m128i *) &quant->lon[j], _mm256_cvttpd_epi32 (a));
+  _mm_storeu_si128 ((__m128i *) &quant->lat[j], _mm256_cvttpd_epi32 (b));
+}
+
+#elif defined (__SSE2__)
+
+static inline __m128d select_pd (__m128d mask, __m128d a, __m128d b)
+{
+  return (_mm_or_pd (_mm_and_pd (mask, a), _mm_andnot_pd (mask, b)));
+}
+
+
+static inline void quantize_sse2 (__m128d x, __m128d y, QUANT_BUFFER *quant, int32_t j)
+{
+  const __m128d half = _mm_set1_pd (0.5), neg_half = _mm_set1_pd (-0.5), zero = _mm_setzero_pd ();
+  const __m128d scale = _mm_set1_pd (POSITION_SCALE), world = _mm_set1_pd (360.0);
+  const __m128d cells = _mm_set1_pd (CELLS_PER_DEGREE);
+  __m128d       lon, lat, a, b;
+
+
+  lon = _mm_add_pd (x, _mm_set1_pd (180.0));
+  lat = _mm_add_pd (y, _mm_set1_pd (90.0));
+
+  lon = select_pd (_mm_cmpgt_pd (lon, world), _mm_sub_pd (lon, world), lon);
+  lon = select_pd (_mm_cmplt_pd (lon, zero), _mm_add_pd (lon, world), lon);
+  lon = _mm_min_pd (_mm_max_pd (lon, zero), world);
+  lat = _mm_min_pd (_mm_max_pd (lat, zero), _mm_set1_pd (180.0));
+
+  a = _mm_mul_pd (_mm_min_pd (lon, _mm_set1_pd (LON_CELL_LIMIT)), cells);
+  b = _mm_mul_pd (_mm_min_pd (lat, _mm_set1_pd (LAT_CELL_LIMIT)), cells);
+
+  _mm_storel_epi64 ((__m128i *) &quant->londeg[j], _mm_cvttpd_epi32 (a));
+  _mm_storel_epi64 ((__m128i *) &quant->latdeg[j], _mm_cvttpd_epi32 (b));
+
+  a = _mm_mul_pd (lon, scale);
+  b = _mm_mul_pd (lat, scale);
+
+  a = _mm_add_pd (a, select_pd (_mm_cmplt_pd (a, zero), neg_half, half));
+  b = _mm_add_pd (b, select_pd (_mm_cmplt_pd (b, zero), neg_half, half));
+
+  _mm_storel_epi64 ((__m128i *) &quant->lon[j], _mm_cvttpd_epi32 (a));
+  _mm_storel_epi64 ((__m128i *) &quant->lat[j], _mm_cvttpd_epi32 (b));
+}
+
+#elif defined (__ARM_NEON) && defined (__aarch64__)
+
+static inline void quantize_neon (float64x2_t x, float64x2_t y, QUANT_BUFFER *quant, int32_t j)
+{
+  const float64x2_t half = vdupq_n_f64 (0.5), neg_half = vdupq_n_f64 (-0.5), zero = vdupq_n_f64 (0.0);
+  const float64x2_t scale = vdupq_n_f64 (POSITION_SCALE), world = vdupq_n_f64 (360.0);
+  const float64x2_t cells = vdupq_n_f64 (CELLS_PER_DEGREE);
+  float64x2_t   lon, lat, a, b;
+
+
+  lon = vaddq_f64 (x, vdupq_n_f64 (180.0));
+  lat = vaddq_f64 (y, vdupq_n_f64 (90.0));
+
+  lon = vbslq_f64 (vcgtq_f64 (lon, world), vsubq_f64 (lon, world), lon);
+  lon = vbslq_f64 (vcltq_f64 (lon, zero), vaddq_f64 (lon, world), lon);
+  lon = vminq_f64 (vmaxq_f64 (lon, zero), world);
+  lat = vminq_f64 (vmaxq_f64 (lat, zero), vdupq_n_f64 (180.0));
+
+  a = vmulq_f64 (vminq_f64 (lon, vdupq_n_f64 (LON_CELL_LIMIT)), cells);
+  b = vmulq_f64 (vminq_f64 (lat, vdupq_n_f64 (LAT_CELL_LIMIT)), cells);
+
+  vst1_s32 (&quant->londeg[j], vmovn_s64 (vcvtq_s64_f64 (a)));
+  vst1_s32 (&quant->latdeg[j], vmovn_s64 (vcvtq_s64_f64 (b)));
+
+  a = vmulq_f64 (lon, scale);
+  b = vmulq_f64 (lat, scale);
+
+  a = vaddq_f64 (a, vbslq_f64 (vcltq_f64 (a, zero), neg_half, half));
+  b = vaddq_f64 (b, vbslq_f64 (vcltq_f64 (b, zero), neg_half, half));
+
+  vst1_s32 (&quant->lon[j], vmovn_s64 (vcvtq_s64_f64 (a)));
+  vst1_s32 (&quant->lat[j], vmovn_s64 (vcvtq_s64_f64 (b)));
+}
+
+#endif
+
+
+
+static int32_t compare_parts (const void *a, const void *b)
+{
+  int32_t       pa = *(const int32_t *) a, pb = *(const int32_t *) b;
+
+  return ((pa > pb) - (pa < pb));
+}
+
+
+
+/*  Add one vertex (given as fixed point positions) to the arrays starting at block.  */
+
+static inline void put_vertex (int32_t *block, int32_t size, int32_t m, int32_t lon, int32_t lat)
+{
+  block[m] = lon;
+  block[size + m] = lat;
+  block[2 * size + m] = MIN (lon / CELL_SPAN, CELL_COLS - 1);
+  block[3 * size + m] = MIN (lat / CELL_SPAN, CELL_ROWS - 1);
+}
+
+
+
+/*  Start a new piece of line at vertex m of the new arrays, adding it to the breaks that have been added so far.  A
+    piece that only has one vertex can't be a segment (there is nothing to take the deltas of) so that vertex is dropped
+    instead and the piece's own start is used for the new one.  This only happens to vertices that sit between two
+    edge steps, like the corners of Antarctica.  */
+
+static inline void start_piece (int32_t *added, int32_t *breaks, int32_t *m, int32_t *piece)
+{
+  if (*m - *piece == 1)
+    {
+      (*m)--;
+    }
+  else
+    {
+      added[(*breaks)++] = *m;
+    }
+
+  *piece = *m;
+}
+
+
+
+/*  Check the step from vertex j - 1 to vertex j.  STEP_CROSSES is a step of more than half the world in longitude.
+    STEP_ON_EDGE is a step with both ends on the antimeridian or both on the same pole.  Those are the edges that close
+    polygons like Antarctica along the edge of the grid and they aren't coastline so the line is broken there.  This
+    is all bit operations so the counting loop doesn't branch.  */
+
+static inline int32_t boundary_step (const QUANT_BUFFER *quant, int32_t j)
+{
+  int32_t       lon0 = quant->lon[j - 1], lon1 = quant->lon[j], lat0 = quant->lat[j - 1], lat1 = quant->lat[j], edge;
+
+
+  edge = ((lon0 == 0) | (lon0 == FULL_WORLD)) & ((lon1 == 0) | (lon1 == FULL_WORLD));
+  edge |= ((lat0 == 0) & (lat1 == 0)) | ((lat0 == NORTH_POLE) & (lat1 == NORTH_POLE));
+
+  return ((edge * STEP_ON_EDGE) | ((edge ^ 1) & (abs (lon1 - lon0) > HALF_WORLD)));
+}
+
+
+
+/*  Split every antimeridian crossing and edge step (crossings is the number of them) of the n quantized vertices.  The
+    vertices are copied to the spare arrays with the edge vertices added and the two sets of arrays are swapped.  The existing
+    segment starts are renumbered and the starts of the new halves are added after them and sorted in.  */
+
+static void split_crossings (QUANT_BUFFER *quant, int32_t n, int32_t crossings)
+{
+  int32_t       j, m, p, num_parts = quant->num_parts, breaks = 0, size, step, edge0, edge1, span, dist, lat, *block;
+  int32_t       *added, piece = -1;
+  uint8_t       start;
+
+
+  if (n + 2 * crossings > quant->size) quant_buffer_grow (quant, n + 2 * crossings, n);
+  if (num_parts + crossings > quant->part_size) quant_part_grow (quant, num_parts + crossings);
+
+  size = quant->size;
+  if (quant->spare == NULL) quant->spare = quant_block (size);
+  block = quant->spare;
+  added = quant->part + num_parts;
+
+
+  /*  piece is where the current piece of line starts in the new arrays (-1 if it doesn't have a start of its own, the
+      first vertices of a multipoint shape).  */
+
+  for (j = 0, m = 0, p = 0 ; j < n ; j++)
+    {
+      start = (p < num_parts && quant->part[p] == j);
+      step = (start || !j) ? 0 : boundary_step (quant, j);
+
+      if (start)
+        {
+          quant->part[p++] = piece = m;
+        }
+      else if (step == STEP_ON_EDGE)
+        {
+          start_piece (added, &breaks, &m, &piece);
+        }
+      else if (step == STEP_CROSSES)
+        {
+          /*  Going east the previous vertex is near 360 and this one is near 0, going west it's the other way round.
+              Work out where the line crosses 180 as if this vertex were on the previous vertex's side.  */
+
+          if (quant->lon[j] < quant->lon[j - 1])
+            {
+              edge0 = FULL_WORLD;
+              edge1 = 0;
+              span = quant->lon[j] + FULL_WORLD - quant->lon[j - 1];
+              dist = FULL_WORLD - quant->lon[j - 1];
+            }
+          else
+            {
+              edge0 = 0;
+              edge1 = FULL_WORLD;
+              span = quant->lon[j - 1] + FULL_WORLD - quant->lon[j];
+              dist = quant->lon[j - 1];
+            }
+
+          lat = quant->lat[j - 1];
+          if (span) lat += NINT ((double) (quant->lat[j] - quant->lat[j - 1]) * (double) dist / (double) span);
+
+
+          /*  End the first half on its edge, then start the second half on the other edge (or at this vertex if it's
+              already on the edge).  */
+
+          if (edge0 != quant->lon[j - 1] || lat != quant->lat[j - 1]) put_vertex (block, size, m++, edge0, lat);
+
+          start_piece (added, &breaks, &m, &piece);
+
+          if (edge1 != quant->lon[j] || lat != quant->lat[j]) put_vertex (block, size, m++, edge1, lat);
+        }
+
+      block[m] = quant->lon[j];
+      block[size + m] = quant->lat[j];
+      block[2 * size + m] = quant->londeg[j];
+      block[3 * size + m] = quant->latdeg[j];
+      m++;
+    }
+
+
+  /*  The same goes for a lone vertex left at the end by one of our own breaks.  */
+
+  if (m - piece == 1 && breaks && added[breaks - 1] == piece)
+    {
+      m--;
+      breaks--;
+    }
+
+
+  quant->spare = quant->lon;
+
+  quant->lon = block;
+  quant->lat = quant->lon + size;
+  quant->londeg = quant->lat + size;
+  quant->latdeg = quant->londeg + size;
+
+  quant->count = m;
+
+
+  /*  The new starts are in order and so are the old ones, we just have to merge them.  */
+
+  quant->num_parts = num_parts + breaks;
+  if (breaks && num_parts) qsort (quant->part, quant->num_parts, sizeof (int32_t), compare_parts);
+}
+
+
+
+/*  Build the list of segment starts and split any antimeridian crossings and edge steps.  The first vertex of a shape with parts
+    always starts a segment.  Part starts that don't go forward can never be reached so they are dropped.  The crossing count is done without a branch
+    so that the normal case, a shape that doesn't cross, is just one pass over the longitudes.  */
+
+static void quantize_normalize (const SHAPE_VIEW *shape, QUANT_BUFFER *quant)
+{
+  int32_t       i, j, n = shape->nVertices, part, crossings = 0;
+
+
+  quant->count = n;
+  quant->num_parts = 0;
+
+  if (shape->nParts > 0)
+    {
+      if (shape->nParts > quant->part_size) quant_part_grow (quant, shape->nParts);
+
+      quant->part[quant->num_parts++] = 0;
+
+      for (i = 1 ; i < shape->nParts ; i++)
+        {
+          part = shape_view_part (shape, i);
+          if (part > quant->part[quant->num_parts - 1]) quant->part[quant->num_parts++] = part;
+        }
+    }
+
+
+  for (j = 1 ; j < n ; j++) crossings += (boundary_step (quant, j) != 0);
+
+  if (crossings) split_crossings (quant, n, crossings);
+}
+
+
+
+/*  Quantize and normalize all of the vertices of a shape into quant.  The vector loops handle the two layouts we actually
+    get, separate X and Y arrays (shapelib) and interleaved X/Y pairs (memory mapped .shp records).  Anything left
+    over is done one vertex at a time.  */
+
+void quantize_shape (const SHAPE_VIEW *shape, QUANT_BUFFER *quant)
+{
+  int32_t       j = 0, n = shape->nVertices;
+
+
+  if (n > quant->size) quant_buffer_grow (quant, n, 0);
+
+#if defined (__AVX__) || defined (__SSE2__) || (defined (__ARM_NEON) && defined (__aarch64__))
+  const uint8_t *px = shape->x, *py = shape->y;
+  uint8_t       separate = (shape->stride == sizeof (double));
+  uint8_t       interleaved = (shape->stride == 2 * sizeof (double) && py == px + sizeof (double));
+#endif
+
+#if defined (__AVX__)
+  if (separate)
+    {
+      for ( ; j + 4 <= n ; j += 4)
+        quantize_avx (_mm256_loadu_pd ((const double *) (px + (size_t) j * 8)),
+                      _mm256_loadu_pd ((const double *) (py + (size_t) j * 8)), quant, j);
+    }
+  else if (interleaved)
+    {
+      __m256d   a, b, lo, hi;
+
+      for ( ; j + 4 <= n ; j += 4)
+        {
+          a = _mm256_loadu_pd ((const double *) (px + (size_t) j * 16));
+          b = _mm256_loadu_pd ((const double *) (px + (size_t) j * 16 + 32));
+
+          lo = _mm256_permute2f128_pd (a, b, 0x20);
+          hi = _mm256_permute2f128_pd (a, b, 0x31);
+
+          quantize_avx (_mm256_unpacklo_pd (lo, hi), _mm256_unpackhi_pd (lo, hi), quant, j);
+        }
+    }
+#elif defined (__SSE2__)
+  if (separate)
+    {
+      for ( ; j + 2 <= n ; j += 2)
+        quantize_sse2 (_mm_loadu_pd ((const double *) (px + (size_t) j * 8)),
+                       _mm_loadu_pd ((const double *) (py + (size_t) j * 8)), quant, j);
+    }
+  else if (interleaved)
+    {
+      __m128d   a, b;
+
+      for ( ; j + 2 <= n ; j += 2)
+        {
+          a = _mm_loadu_pd ((const double *) (px + (size_t) j * 16));
+          b = _mm_loadu_pd ((const double *) (px + (size_t) j * 16 + 16));
+
+          quantize_sse2 (_mm_unpacklo_pd (a, b), _mm_unpackhi_pd (a, b), quant, j);
+        }
+    }
+#elif defined (__ARM_NEON) && defined (__aarch64__)
+  if (separate)
+    {
+      for ( ; j + 2 <= n ; j += 2)
+        quantize_neon (vreinterpretq_f64_u8 (vld1q_u8 (px + (size_t) j * 8)),
+                       vreinterpretq_f64_u8 (vld1q_u8 (py + (size_t) j * 8)), quant, j);
+    }
+  else if (interleaved)
+    {
+      float64x2_t a, b;
+
+      for ( ; j + 2 <= n ; j += 2)
+        {
+          a = vreinterpretq_f64_u8 (vld1q_u8 (px + (size_t) j * 16));
+          b = vreinterpretq_f64_u8 (vld1q_u8 (px + (size_t) j * 16 + 16));
+
+          quantize_neon (vuzp1q_f64 (a, b), vuzp2q_f64 (a, b), quant, j);
+        }
+    }
+#endif
+
+  for ( ; j < n ; j++) quantize_vertex (shape_view_x (shape, j), shape_view_y (shape, j), quant, j);
+
+  quantize_normalize (shape, quant);
+}
@@ -0,0 +1,56 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __QUANTIZE_H__
+#define __QUANTIZE_H__
+
+#include "build_coast.h"
+#include "shp_map.h"
+
+
+/*  The vertices of one shape converted to biased (0-360/0-180) fixed point positions and the one-degree cell of each
+    vertex.  The arrays are grown as needed and reused from shape to shape.  After quantize_shape the vertices have
+    been normalized to the grid (see quantize.c) so count may be larger than the number of vertices in the shape and
+    the segment starts are in part rather than in the shape.  */
+
+typedef struct
+{
+  int32_t       *lon;                   /*  NINT ((x + 180.0) * POSITION_SCALE), 0 to 360 degrees  */
+  int32_t       *lat;                   /*  NINT ((y + 90.0) * POSITION_SCALE), 0 to 180 degrees  */
+  int32_t       *londeg;                /*  (int32_t) ((x + 180.0) * CELLS_PER_DEGREE), 0 to CELL_COLS - 1  */
+  int32_t       *latdeg;                /*  (int32_t) ((y + 90.0) * CELLS_PER_DEGREE), 0 to CELL_ROWS - 1  */
+  int32_t       size;                   /*  Number of vertices allocated in each array  */
+  int32_t       count;                  /*  Number of vertices after normalization  */
+  int32_t       *part;                  /*  Vertices that start a new segment, in increasing order  */
+  int32_t       num_parts;
+  int32_t       part_size;              /*  Number of part entries allocated  */
+  int32_t       *spare;                 /*  Second set of size vertex arrays used when a shape crosses the antimeridian  */
+} QUANT_BUFFER;
+
+
+void quant_buffer_init (QUANT_BUFFER *quant);
+void quant_buffer_free (QUANT_BUFFER *quant);
+void quantize_shape (const SHAPE_VIEW *shape, QUANT_BUFFER *quant);
+
+
+#endif
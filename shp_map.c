@@ -0,0 +1,404 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "shp_map.h"
+#include "prefetch.h"
+
+#ifndef NVWIN3X
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+
+/*  Size of the main file header in both the .shp and .shx files.  */
+
+#define         SHP_HEADER_SIZE     100
+
+
+
+/*  Point a view at the vertices of a shapelib object.  */
+
+void shape_view_from_object (SHPObject *shape, SHAPE_VIEW *view)
+{
+  view->nVertices = shape->nVertices;
+  view->nParts = shape->nParts;
+  view->parts = (const uint8_t *) shape->panPartStart;
+  view->x = (const uint8_t *) shape->padfX;
+  view->y = (const uint8_t *) shape->padfY;
+  view->stride = sizeof (double);
+  view->dfXMin = shape->dfXMin;
+  view->dfYMin = shape->dfYMin;
+  view->dfXMax = shape->dfXMax;
+  view->dfYMax = shape->dfYMax;
+}
+
+
+
+static int32_t get_be32 (const uint8_t *ptr)
+{
+  return ((int32_t) ((uint32_t) ptr[0] << 24 | (uint32_t) ptr[1] << 16 | (uint32_t) ptr[2] << 8 | (uint32_t) ptr[3]));
+}
+
+
+
+static int32_t get_le32 (const uint8_t *ptr)
+{
+  return ((int32_t) ((uint32_t) ptr[3] << 24 | (uint32_t) ptr[2] << 16 | (uint32_t) ptr[1] << 8 | (uint32_t) ptr[0]));
+}
+
+
+
+/*  Open the file with the given extension (shp or shx) for shapefile name read-only, trying the extension in lower
+    and then upper case (the same as shapelib).  Returns -1 if neither can be opened (always on Windows).  */
+
+int shp_map_open_file (const char *name, const char *ext)
+{
+#ifdef NVWIN3X
+  return (-1);
+#else
+  char              fname[1024];
+  size_t            len = strlen (name);
+  int32_t           i;
+  int               fd;
+
+
+  if (len + 5 > sizeof (fname)) return (-1);
+
+  strcpy (fname, name);
+
+
+  /*  Strip a .shp or .shx extension.  */
+
+  if (len > 4 && fname[len - 4] == '.' && (fname[len - 3] == 's' || fname[len - 3] == 'S') &&
+      (fname[len - 2] == 'h' || fname[len - 2] == 'H')) fname[len - 4] = 0;
+
+  len = strlen (fname);
+
+  sprintf (&fname[len], ".%s", ext);
+
+  if ((fd = open (fname, O_RDONLY)) >= 0) return (fd);
+
+  for (i = 1 ; i < 4 ; i++) fname[len + i] = fname[len + i] - 'a' + 'A';
+
+  return (open (fname, O_RDONLY));
+#endif
+}
+
+
+
+/*  Read the .shp file offsets of records first to end - 1 from the .shx file of name into offset.  Returns NVFalse if
+    the .shx file can't be read.  */
+
+uint8_t shp_map_read_offsets (const char *name, int32_t first, int32_t end, int64_t *offset)
+{
+#ifdef NVWIN3X
+  return (NVFalse);
+#else
+  uint8_t           *buf;
+  size_t            size = (size_t) (end - first) * 8;
+  int32_t           i;
+  int               fd;
+  uint8_t           ok;
+
+
+  if (end <= first) return (NVTrue);
+
+  if ((fd = shp_map_open_file (name, "shx")) < 0) return (NVFalse);
+
+  if ((buf = (uint8_t *) malloc (size)) == NULL)
+    {
+      perror ("Allocating shape index memory");
+      exit (-1);
+    }
+
+  ok = (pread (fd, buf, size, (off_t) SHP_HEADER_SIZE + (off_t) first * 8) == (ssize_t) size);
+
+  close (fd);
+
+  if (ok) for (i = 0 ; i < end - first ; i++) offset[i] = (int64_t) get_be32 (buf + (size_t) i * 8) * 2;
+
+  free (buf);
+
+  return (ok);
+#endif
+}
+
+
+
+#ifndef NVWIN3X
+
+/*  Map a whole file read-only (and close fd).  */
+
+static const uint8_t *map_file (int fd, size_t *size)
+{
+  struct stat       st;
+  void              *ptr;
+
+
+  if (fd < 0) return (NULL);
+
+  if (fstat (fd, &st) || st.st_size < SHP_HEADER_SIZE)
+    {
+      close (fd);
+      return (NULL);
+    }
+
+  ptr = mmap (NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+  close (fd);
+
+  if (ptr == MAP_FAILED) return (NULL);
+
+
+  /*  We walk the records in order so let the kernel read ahead.  */
+
+  madvise (ptr, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+  *size = (size_t) st.st_size;
+
+  return ((const uint8_t *) ptr);
+}
+
+
+
+/*  Map the file with the given extension for shapefile name.  */
+
+static const uint8_t *map_shape_file (const char *name, const char *ext, size_t *size)
+{
+  return (map_file (shp_map_open_file (name, ext), size));
+}
+
+#endif
+
+
+
+/*  Memory map the .shp and .shx files for name.  Returns NVFalse (and the caller should fall back to shapelib) if mapping
+    isn't possible on this system, the files can't be mapped, or the shape type isn't one that we know how to walk.  */
+
+uint8_t shp_map_open (SHP_MAP *map, const char *name)
+{
+#ifdef NVWIN3X
+  memset (map, 0, sizeof (SHP_MAP));
+  return (NVFalse);
+#else
+  const uint16_t    endian_test = 1;
+
+
+  memset (map, 0, sizeof (SHP_MAP));
+
+
+  /*  The records are little endian doubles that we read in place.  */
+
+  if (*((const uint8_t *) &endian_test) != 1) return (NVFalse);
+
+
+  if ((map->shp = map_shape_file (name, "shp", &map->shp_size)) == NULL) return (NVFalse);
+
+  if ((map->shx = map_shape_file (name, "shx", &map->shx_size)) == NULL)
+    {
+      shp_map_close (map);
+      return (NVFalse);
+    }
+
+
+  map->type = get_le32 (map->shp + 32);
+  map->page = (size_t) sysconf (_SC_PAGESIZE);
+  map->num_shapes = (int32_t) ((map->shx_size - SHP_HEADER_SIZE) / 8);
+
+  switch (map->type)
+    {
+    case SHPT_POINT:
+    case SHPT_POINTZ:
+    case SHPT_POINTM:
+    case SHPT_MULTIPOINT:
+    case SHPT_MULTIPOINTZ:
+    case SHPT_MULTIPOINTM:
+    case SHPT_ARC:
+    case SHPT_ARCZ:
+    case SHPT_ARCM:
+    case SHPT_POLYGON:
+    case SHPT_POLYGONZ:
+    case SHPT_POLYGONM:
+    case SHPT_MULTIPATCH:
+      break;
+
+    default:
+      shp_map_close (map);
+      return (NVFalse);
+    }
+
+  return (NVTrue);
+#endif
+}
+
+
+
+/*  Fill in view for record i.  Only the 2D part of the record is looked at (Z and M values follow the X/Y pairs and are
+    ignored).  Returns NVFalse if the record is bad.  A null shape returns a view with no vertices.  */
+
+uint8_t shp_map_shape (SHP_MAP *map, int32_t i, SHAPE_VIEW *view)
+{
+  const uint8_t     *rec;
+  size_t            offset, length, need;
+  int32_t           type, num_parts, num_points, part_bytes;
+
+
+  memset (view, 0, sizeof (SHAPE_VIEW));
+
+  if (i < 0 || i >= map->num_shapes) return (NVFalse);
+
+
+  offset = (size_t) get_be32 (map->shx + SHP_HEADER_SIZE + (size_t) i * 8) * 2;
+  length = (size_t) get_be32 (map->shx + SHP_HEADER_SIZE + (size_t) i * 8 + 4) * 2;
+
+  if (offset < SHP_HEADER_SIZE || length < 4 || offset + 8 + length > map->shp_size) return (NVFalse);
+
+
+  /*  Skip the 8 byte big endian record header.  */
+
+  rec = map->shp + offset + 8;
+
+  type = get_le32 (rec);
+
+  switch (type)
+    {
+    case SHPT_NULL:
+      return (NVTrue);
+
+
+    case SHPT_POINT:
+    case SHPT_POINTZ:
+    case SHPT_POINTM:
+      if (length < 20) return (NVFalse);
+
+      view->nVertices = 1;
+      view->x = rec + 4;
+      view->y = rec + 12;
+      view->stride = 16;
+      view->dfXMin = view->dfXMax = shape_view_x (view, 0);
+      view->dfYMin = view->dfYMax = shape_view_y (view, 0);
+      return (NVTrue);
+
+
+    case SHPT_MULTIPOINT:
+    case SHPT_MULTIPOINTZ:
+    case SHPT_MULTIPOINTM:
+      if (length < 40) return (NVFalse);
+
+      num_points = get_le32 (rec + 36);
+
+      if (num_points < 0 || 40 + (size_t) num_points * 16 > length) return (NVFalse);
+
+      view->nVertices = num_points;
+      view->x = rec + 40;
+      view->y = rec + 48;
+      view->stride = 16;
+      break;
+
+
+    case SHPT_ARC:
+    case SHPT_ARCZ:
+    case SHPT_ARCM:
+    case SHPT_POLYGON:
+    case SHPT_POLYGONZ:
+    case SHPT_POLYGONM:
+    case SHPT_MULTIPATCH:
+      if (length < 44) return (NVFalse);
+
+      num_parts = get_le32 (rec + 36);
+      num_points = get_le32 (rec + 40);
+
+
+      /*  Multipatch records have a part type array following the part starts.  */
+
+      part_bytes = (type == SHPT_MULTIPATCH) ? 8 : 4;
+
+      if (num_parts < 0 || num_points < 0) return (NVFalse);
+
+      need = 44 + (size_t) num_parts * part_bytes + (size_t) num_points * 16;
+
+      if (need > length) return (NVFalse);
+
+      view->nVertices = num_points;
+      view->nParts = num_parts;
+      view->parts = rec + 44;
+      view->x = rec + 44 + (size_t) num_parts * part_bytes;
+      view->y = view->x + 8;
+      view->stride = 16;
+      break;
+
+
+    default:
+      return (NVFalse);
+    }
+
+
+  memcpy (&view->dfXMin, rec + 4, sizeof (double));
+  memcpy (&view->dfYMin, rec + 12, sizeof (double));
+  memcpy (&view->dfXMax, rec + 20, sizeof (double));
+  memcpy (&view->dfYMax, rec + 28, sizeof (double));
+
+  return (NVTrue);
+}
+
+
+
+/*  MADV_SEQUENTIAL only makes the kernel read ahead when we fault on a page.  Before walking record i, ask it to
+    start reading the next PREFETCH_WINDOW bytes so the faults in the segment splitter find the pages already there.
+    This is only a hint so errors are ignored.  */
+
+void shp_map_prefetch (SHP_MAP *map, int32_t i)
+{
+#ifndef NVWIN3X
+  size_t            offset, start;
+
+
+  if (i < 0 || i >= map->num_shapes) return;
+
+  offset = (size_t) get_be32 (map->shx + SHP_HEADER_SIZE + (size_t) i * 8) * 2;
+
+  if (offset + PREFETCH_WINDOW / 2 < map->advised || offset >= map->shp_size) return;
+
+  if (offset > map->advised) map->advised = offset;
+
+  start = map->advised & ~(map->page - 1);
+
+  if (start >= map->shp_size) return;
+
+  madvise ((void *) (map->shp + start), MIN ((size_t) PREFETCH_WINDOW, map->shp_size - start), MADV_WILLNEED);
+
+  map->advised = start + PREFETCH_WINDOW;
+#endif
+}
+
+
+
+void shp_map_close (SHP_MAP *map)
+{
+#ifndef NVWIN3X
+  if (map->shp != NULL) munmap ((void *) map->shp, map->shp_size);
+  if (map->shx != NULL) munmap ((void *) map->shx, map->shx_size);
+#endif
+
+  map->shp = map->shx = NULL;
+}
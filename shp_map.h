@@ -0,0 +1,98 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __SHP_MAP_H__
+#define __SHP_MAP_H__
+
+#include "build_coast.h"
+
+
+/*  A read-only view of the vertices of one shape.  This can point straight into a memory mapped .shp record (X and Y
+    interleaved little endian doubles) or at the padfX/padfY arrays of a shapelib SHPObject, so the segment splitter
+    doesn't care where the shape came from.  The part starts and coordinates may not be aligned so always use the
+    accessors below.  */
+
+typedef struct
+{
+  int32_t       nVertices;              /*  Number of vertices  */
+  int32_t       nParts;                 /*  Number of parts (0 for multipoint type shapes)  */
+  const uint8_t *parts;                 /*  nParts 32 bit part start indices  */
+  const uint8_t *x;                     /*  First X value  */
+  const uint8_t *y;                     /*  First Y value  */
+  int32_t       stride;                 /*  Bytes from one X (or Y) value to the next  */
+  double        dfXMin;                 /*  Bounds of the shape  */
+  double        dfYMin;
+  double        dfXMax;
+  double        dfYMax;
+} SHAPE_VIEW;
+
+
+static inline double shape_view_x (const SHAPE_VIEW *view, int32_t j)
+{
+  double value;
+  memcpy (&value, view->x + (size_t) j * view->stride, sizeof (double));
+  return (value);
+}
+
+
+static inline double shape_view_y (const SHAPE_VIEW *view, int32_t j)
+{
+  double value;
+  memcpy (&value, view->y + (size_t) j * view->stride, sizeof (double));
+  return (value);
+}
+
+
+static inline int32_t shape_view_part (const SHAPE_VIEW *view, int32_t i)
+{
+  int32_t value;
+  memcpy (&value, view->parts + (size_t) i * sizeof (int32_t), sizeof (int32_t));
+  return (value);
+}
+
+
+/*  A memory mapped .shp/.shx pair.  */
+
+typedef struct
+{
+  const uint8_t *shp;                   /*  Mapped .shp file  */
+  size_t        shp_size;
+  const uint8_t *shx;                   /*  Mapped .shx file  */
+  size_t        shx_size;
+  int32_t       num_shapes;             /*  Number of records in the .shx file  */
+  int32_t       type;                   /*  Shape type from the .shp header  */
+  size_t        advised;                /*  .shp offset up to which the kernel has been asked to read ahead  */
+  size_t        page;                   /*  System page size (for aligning the madvise calls)  */
+} SHP_MAP;
+
+
+void shape_view_from_object (SHPObject *shape, SHAPE_VIEW *view);
+int shp_map_open_file (const char *name, const char *ext);
+uint8_t shp_map_read_offsets (const char *name, int32_t first, int32_t end, int64_t *offset);
+uint8_t shp_map_open (SHP_MAP *map, const char *name);
+uint8_t shp_map_shape (SHP_MAP *map, int32_t i, SHAPE_VIEW *view);
+void shp_map_prefetch (SHP_MAP *map, int32_t i);
+void shp_map_close (SHP_MAP *map);
+
+
+#endif
@@ -0,0 +1,166 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#include "simplify.h"
+
+
+void simplify_buffer_init (SIMPLIFY_BUFFER *buf)
+{
+  buf->xy = buf->stack = NULL;
+  buf->keep = NULL;
+  buf->size = 0;
+}
+
+
+
+void simplify_buffer_free (SIMPLIFY_BUFFER *buf)
+{
+  if (buf->xy != NULL) free (buf->xy);
+  if (buf->stack != NULL) free (buf->stack);
+  if (buf->keep != NULL) free (buf->keep);
+
+  simplify_buffer_init (buf);
+}
+
+
+
+static void simplify_buffer_grow (SIMPLIFY_BUFFER *buf, int32_t count)
+{
+  int32_t           size = buf->size ? buf->size : 1024;
+
+
+  while (size < count) size *= 2;
+
+  simplify_buffer_free (buf);
+
+  buf->xy = (int32_t *) malloc (2 * (size_t) size * sizeof (int32_t));
+  buf->stack = (int32_t *) malloc (2 * (size_t) size * sizeof (int32_t));
+  buf->keep = (uint8_t *) malloc (size);
+  if (buf->xy == NULL || buf->stack == NULL || buf->keep == NULL)
+    {
+      perror ("Allocating simplification memory");
+      exit (-1);
+    }
+
+  buf->size = size;
+}
+
+
+
+/*  Douglas-Peucker simplification of one segment (count interleaved lon/lat fixed point vertices) with tolerance in the
+    same units.  The end points are always kept.  A span is only replaced by a straight line if every vertex in it is
+    within tolerance of the line and the line is no longer than CCL_MAX_LOD_STEP in lon or lat, so the deltas still fit
+    in the bias fields.  Since lon and lat are both in 1e-5 degree units the distance is in "degrees" and not meters,
+    which is fine for picking vertices to display at a given zoom.  The result is left in buf->xy and the new count is
+    returned.  */
+
+int32_t simplify_segment (SIMPLIFY_BUFFER *buf, const int32_t *xy, int32_t count, int32_t tolerance)
+{
+  int32_t           i, first, last, top, index, n;
+  double            ax, ay, dx, dy, px, py, cross, dist, max_dist, len2, tol2;
+
+
+  if (count > buf->size) simplify_buffer_grow (buf, count);
+
+  if (count <= 2)
+    {
+      memcpy (buf->xy, xy, 2 * (size_t) count * sizeof (int32_t));
+      return (count);
+    }
+
+
+  memset (buf->keep, 0, count);
+  buf->keep[0] = buf->keep[count - 1] = NVTrue;
+
+  tol2 = (double) tolerance * (double) tolerance;
+
+  top = 0;
+  buf->stack[top++] = 0;
+  buf->stack[top++] = count - 1;
+
+  while (top)
+    {
+      last = buf->stack[--top];
+      first = buf->stack[--top];
+
+      if (last - first < 2) continue;
+
+      ax = xy[2 * first];
+      ay = xy[2 * first + 1];
+      dx = xy[2 * last] - ax;
+      dy = xy[2 * last + 1] - ay;
+      len2 = dx * dx + dy * dy;
+
+
+      /*  Compare squared distances (scaled by the squared length of the line) so we don't need a square root.  If the
+          end points are the same (closed rings) use the distance from that point.  */
+
+      max_dist = -1.0;
+      index = first + 1;
+
+      for (i = first + 1 ; i < last ; i++)
+        {
+          px = xy[2 * i] - ax;
+          py = xy[2 * i + 1] - ay;
+
+          if (len2 > 0.0)
+            {
+              cross = dx * py - dy * px;
+              dist = cross * cross / len2;
+            }
+          else
+            {
+              dist = px * px + py * py;
+            }
+
+          if (dist > max_dist)
+            {
+              max_dist = dist;
+              index = i;
+            }
+        }
+
+      if (max_dist > tol2 || fabs (dx) > CCL_MAX_LOD_STEP || fabs (dy) > CCL_MAX_LOD_STEP)
+        {
+          buf->keep[index] = NVTrue;
+
+          buf->stack[top++] = first;
+          buf->stack[top++] = index;
+          buf->stack[top++] = index;
+          buf->stack[top++] = last;
+        }
+    }
+
+
+  for (i = 0, n = 0 ; i < count ; i++)
+    {
+      if (buf->keep[i])
+        {
+          buf->xy[2 * n] = xy[2 * i];
+          buf->xy[2 * n + 1] = xy[2 * i + 1];
+          n++;
+        }
+    }
+
+  return (n);
+}
@@ -0,0 +1,46 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+
+#ifndef __SIMPLIFY_H__
+#define __SIMPLIFY_H__
+
+#include "build_coast.h"
+
+
+/*  Work space for simplifying segments.  Each encoder thread has one and it only grows.  */
+
+typedef struct
+{
+  int32_t       *xy;                    /*  Simplified segment (interleaved lon/lat)  */
+  int32_t       *stack;                 /*  Pending first/last index pairs  */
+  uint8_t       *keep;                  /*  Vertices that survive  */
+  int32_t       size;                   /*  Number of vertices allocated  */
+} SIMPLIFY_BUFFER;
+
+
+void simplify_buffer_init (SIMPLIFY_BUFFER *buf);
+void simplify_buffer_free (SIMPLIFY_BUFFER *buf);
+int32_t simplify_segment (SIMPLIFY_BUFFER *buf, const int32_t *xy, int32_t count, int32_t tolerance);
+
+
+#endif
@@ -0,0 +1,197 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#include "spool.h"
+#include "stats.h"
+
+
+
+void spool_init (SPOOL *spool, int32_t num_keys)
+{
+  int32_t           i;
+
+
+  memset (spool, 0, sizeof (SPOOL));
+
+  spool->num_keys = num_keys;
+  spool->data = (uint8_t **) calloc (num_keys, sizeof (uint8_t *));
+  spool->size = (size_t *) calloc (num_keys, sizeof (size_t));
+  spool->offset = (int64_t *) malloc (num_keys * sizeof (int64_t));
+  spool->held = (int32_t *) malloc (num_keys * sizeof (int32_t));
+
+  if (spool->data == NULL || spool->size == NULL || spool->offset == NULL || spool->held == NULL)
+    {
+      perror ("Allocating spool memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < num_keys ; i++) spool->offset[i] = -1;
+}
+
+
+
+/*  Append every record in memory to the scratch file (in the order they were added) and free them.  */
+
+static void spool_spill (SPOOL *spool)
+{
+  int32_t           i, key;
+
+
+  if (spool->fp == NULL)
+    {
+      if ((spool->fp = tmpfile ()) == NULL)
+        {
+          perror ("Opening spool file");
+          exit (-1);
+        }
+    }
+
+#ifdef NVWIN3X
+  if (fseeko64 (spool->fp, spool->file_size, SEEK_SET))
+#else
+  if (fseeko (spool->fp, (off_t) spool->file_size, SEEK_SET))
+#endif
+    {
+      perror ("Seeking in spool file");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < spool->num_held ; i++)
+    {
+      key = spool->held[i];
+
+      if (spool->data[key] == NULL) continue;
+
+      if (fwrite (spool->data[key], spool->size[key], 1, spool->fp) != 1)
+        {
+          perror ("Writing spool file");
+          exit (-1);
+        }
+
+      spool->offset[key] = spool->file_size;
+      spool->file_size += (int64_t) spool->size[key];
+      run_stats.spool_written += (int64_t) spool->size[key];
+
+      free (spool->data[key]);
+      spool->data[key] = NULL;
+    }
+
+  spool->num_held = 0;
+  spool->bytes = 0;
+  spool->spills++;
+}
+
+
+
+/*  Add the size byte record data for key.  The spool takes over data (it must have come from malloc).  If the
+    records in memory add up to more than limit bytes they are all spilled to the scratch file.  */
+
+void spool_put (SPOOL *spool, int32_t key, uint8_t *data, size_t size, size_t limit)
+{
+  if (!size)
+    {
+      free (data);
+      return;
+    }
+
+  spool->data[key] = data;
+  spool->size[key] = size;
+  spool->held[spool->num_held++] = key;
+  spool->bytes += size;
+
+  if (spool->bytes > limit) spool_spill (spool);
+}
+
+
+
+/*  Get the record for key (NULL with size 0 if there isn't one).  A spilled record is read into the spool's buffer so
+    the pointer is only good until the next spool_get.  */
+
+const uint8_t *spool_get (SPOOL *spool, int32_t key, size_t *size)
+{
+  *size = spool->size[key];
+
+  if (!*size) return (NULL);
+
+  if (spool->data[key] != NULL) return (spool->data[key]);
+
+
+  if (spool->buffer_size < *size)
+    {
+      spool->buffer_size = *size;
+      if ((spool->buffer = (uint8_t *) realloc (spool->buffer, spool->buffer_size)) == NULL)
+        {
+          perror ("Allocating spool memory");
+          exit (-1);
+        }
+    }
+
+#ifdef NVWIN3X
+  if (fseeko64 (spool->fp, spool->offset[key], SEEK_SET) || fread (spool->buffer, *size, 1, spool->fp) != 1)
+#else
+  if (fseeko (spool->fp, (off_t) spool->offset[key], SEEK_SET) || fread (spool->buffer, *size, 1, spool->fp) != 1)
+#endif
+    {
+      perror ("Reading spool file");
+      exit (-1);
+    }
+
+  return (spool->buffer);
+}
+
+
+
+/*  Free the record for key once it has been written.  */
+
+void spool_release (SPOOL *spool, int32_t key)
+{
+  if (spool->data[key] != NULL)
+    {
+      free (spool->data[key]);
+      spool->data[key] = NULL;
+      spool->bytes -= spool->size[key];
+    }
+
+  spool->size[key] = 0;
+}
+
+
+
+/*  Free everything and close (and thereby delete) the scratch file.  */
+
+void spool_free (SPOOL *spool)
+{
+  int32_t           i;
+
+
+  for (i = 0 ; i < spool->num_keys ; i++) if (spool->data[i] != NULL) free (spool->data[i]);
+
+  if (spool->fp != NULL) fclose (spool->fp);
+
+  free (spool->data);
+  free (spool->size);
+  free (spool->offset);
+  free (spool->held);
+  free (spool->buffer);
+
+  memset (spool, 0, sizeof (SPOOL));
+}
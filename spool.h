@@ -0,0 +1,60 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#ifndef __SPOOL_H__
+#define __SPOOL_H__
+
+#include "build_coast.h"
+
+
+/*  Packed records that the pass 2 writer has to hold until the end of the file: the simplified levels of detail and
+    the quadtrees (which are written after all of the full resolution cells) and, when writing to standard output,
+    the full resolution cells themselves (which can't be written until the header is known).  Each record has a key
+    (level * CELL_COUNT + cell for example).  Records are kept in memory while they fit in the limit given to
+    spool_put, after that everything in memory is appended to a scratch file and read back one record at a time when
+    it's written.  Only the writer thread uses a spool.  */
+
+typedef struct
+{
+  int32_t       num_keys;
+  uint8_t       **data;                 /*  Record held in memory for each key (NULL if it was spilled or is empty)  */
+  size_t        *size;                  /*  Size of each record in bytes  */
+  int64_t       *offset;                /*  Offset of each spilled record in the scratch file (-1 if not spilled)  */
+  int32_t       *held;                  /*  Keys with a record in memory, in the order they were added  */
+  int32_t       num_held;
+  size_t        bytes;                  /*  Bytes held in memory  */
+  FILE          *fp;                    /*  Scratch file (NULL until the first spill)  */
+  int64_t       file_size;              /*  Bytes in the scratch file  */
+  uint8_t       *buffer;                /*  Read back buffer for spool_get  */
+  size_t        buffer_size;
+  int32_t       spills;                 /*  Number of times the records in memory were spilled  */
+} SPOOL;
+
+
+void spool_init (SPOOL *spool, int32_t num_keys);
+void spool_put (SPOOL *spool, int32_t key, uint8_t *data, size_t size, size_t limit);
+const uint8_t *spool_get (SPOOL *spool, int32_t key, size_t *size);
+void spool_release (SPOOL *spool, int32_t key);
+void spool_free (SPOOL *spool);
+
+
+#endif
@@ -0,0 +1,449 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#include "stats.h"
+#include "version.h"
+
+#include <signal.h>
+
+#ifdef NVWIN3X
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <time.h>
+#include <sys/resource.h>
+#endif
+
+
+RUN_STATS run_stats;
+
+
+/*  Set by SIGUSR1, checked by stats_poll.  */
+
+static volatile sig_atomic_t snapshot_requested = 0;
+
+
+#ifndef NVWIN3X
+static void snapshot_handler (int signum)
+{
+  (void) signum;
+
+  snapshot_requested = 1;
+}
+#endif
+
+
+
+/*  Seconds from an arbitrary start that never goes backwards.  */
+
+double stats_clock ()
+{
+#ifdef NVWIN3X
+  LARGE_INTEGER     freq, count;
+
+  QueryPerformanceFrequency (&freq);
+  QueryPerformanceCounter (&count);
+
+  return ((double) count.QuadPart / (double) freq.QuadPart);
+#else
+  struct timespec   ts;
+
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+
+  return ((double) ts.tv_sec + (double) ts.tv_nsec * 1.0e-9);
+#endif
+}
+
+
+
+/*  Turn on the statistics that cost something and arrange for SIGUSR1 to write a snapshot.  The always on counters may
+    already have been bumped so they are left alone.  */
+
+void stats_init (const char *name, const OPTIONS *options)
+{
+#ifndef NVWIN3X
+  struct sigaction  sa;
+#endif
+
+
+  run_stats.cell_seconds = (float *) calloc (CELL_COUNT, sizeof (float));
+  run_stats.cell_segments = (int32_t *) calloc (CELL_COUNT, sizeof (int32_t));
+  run_stats.cell_vertices = (int32_t *) calloc (CELL_COUNT, sizeof (int32_t));
+  run_stats.cell_bytes = (int32_t *) calloc (CELL_COUNT, sizeof (int32_t));
+  run_stats.name = strdup (name);
+
+  if (run_stats.cell_seconds == NULL || run_stats.cell_segments == NULL || run_stats.cell_vertices == NULL ||
+      run_stats.cell_bytes == NULL || run_stats.name == NULL)
+    {
+      perror ("Allocating statistics memory");
+      exit (-1);
+    }
+
+  run_stats.options = options;
+  run_stats.start = stats_clock ();
+  run_stats.num_spans = 0;
+  run_stats.enabled = NVTrue;
+
+#ifndef NVWIN3X
+  memset (&sa, 0, sizeof (sa));
+  sa.sa_handler = snapshot_handler;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset (&sa.sa_mask);
+  sigaction (SIGUSR1, &sa, NULL);
+#endif
+}
+
+
+
+/*  Clear the output counters and cell tables before the next --job output is packed, so that the output, bit width,
+    and largest and slowest cell sections all describe the same file (the last one packed).  The input, segment, and
+    scratch counters keep adding up over the whole run.  */
+
+void stats_reset_output (const char *output_name)
+{
+  run_stats.cells_written = 0;
+  run_stats.output_segments = 0;
+  run_stats.output_vertices = 0;
+  run_stats.output_bytes = 0;
+  memset (&run_stats.widths, 0, sizeof (STATS_WIDTHS_HISTOGRAM));
+
+  if (!run_stats.enabled) return;
+
+  if (run_stats.output_name != NULL) free (run_stats.output_name);
+
+  if ((run_stats.output_name = strdup (output_name)) == NULL)
+    {
+      perror ("Allocating statistics memory");
+      exit (-1);
+    }
+
+  memset (run_stats.cell_seconds, 0, CELL_COUNT * sizeof (float));
+  memset (run_stats.cell_segments, 0, CELL_COUNT * sizeof (int32_t));
+  memset (run_stats.cell_vertices, 0, CELL_COUNT * sizeof (int32_t));
+  memset (run_stats.cell_bytes, 0, CELL_COUNT * sizeof (int32_t));
+}
+
+
+
+/*  Start a trace span named fmt (with arg substituted for a %s).  Only called from the main thread.  Returns the span
+    to hand to stats_span_end, or -1 if statistics are off or we're out of spans.  */
+
+int32_t stats_span_begin (const char *fmt, const char *arg)
+{
+  STATS_SPAN        *span;
+  size_t            len;
+
+
+  if (!run_stats.enabled || run_stats.num_spans == STATS_MAX_SPANS) return (-1);
+
+  span = &run_stats.span[run_stats.num_spans];
+
+  len = strlen (fmt) + (arg != NULL ? strlen (arg) : 0) + 1;
+
+  if ((span->name = (char *) malloc (len)) == NULL)
+    {
+      perror ("Allocating statistics memory");
+      exit (-1);
+    }
+
+  snprintf (span->name, len, fmt, arg);
+
+  span->start = stats_clock () - run_stats.start;
+  span->end = -1.0;
+
+  return (run_stats.num_spans++);
+}
+
+
+
+void stats_span_end (int32_t span)
+{
+  if (span >= 0) run_stats.span[span].end = stats_clock () - run_stats.start;
+}
+
+
+
+/*  Called from the progress points in the main thread.  Writes a snapshot if SIGUSR1 came in since the last call.  */
+
+void stats_poll ()
+{
+  if (!run_stats.enabled || !snapshot_requested) return;
+
+  snapshot_requested = 0;
+
+  stats_write ("running");
+}
+
+
+
+/*  Peak resident set size in bytes, or -1 if we can't tell.  */
+
+static int64_t peak_rss ()
+{
+#ifdef NVWIN3X
+  PROCESS_MEMORY_COUNTERS pmc;
+
+  if (GetProcessMemoryInfo (GetCurrentProcess (), &pmc, sizeof (pmc))) return ((int64_t) pmc.PeakWorkingSetSize);
+
+  return (-1);
+#else
+  struct rusage     usage;
+
+  if (getrusage (RUSAGE_SELF, &usage)) return (-1);
+
+  return ((int64_t) usage.ru_maxrss * 1024);
+#endif
+}
+
+
+
+static void json_string (FILE *fp, const char *str)
+{
+  fputc ('"', fp);
+
+  for ( ; *str ; str++)
+    {
+      if (*str == '"' || *str == '\\')
+        {
+          fprintf (fp, "\\%c", *str);
+        }
+      else if ((uint8_t) *str < 0x20)
+        {
+          fprintf (fp, "\\u%04x", (uint8_t) *str);
+        }
+      else
+        {
+          fputc (*str, fp);
+        }
+    }
+
+  fputc ('"', fp);
+}
+
+
+
+static void json_histogram (FILE *fp, const char *name, const int64_t *hist, uint8_t last)
+{
+  int32_t           i;
+
+
+  fprintf (fp, "      \"%s\": [", name);
+
+  for (i = 0 ; i < STATS_WIDTHS ; i++) fprintf (fp, "%s%lld", i ? ", " : "", (long long) hist[i]);
+
+  fprintf (fp, "]%s\n", last ? "" : ",");
+}
+
+
+
+/*  Insert cell into a list of the top STATS_TOP_CELLS cells (largest key first).  */
+
+static void top_insert (int32_t *top, double *key, int32_t *num, int32_t cell, double value)
+{
+  int32_t           i;
+
+
+  if (value <= 0.0 || (*num == STATS_TOP_CELLS && value <= key[*num - 1])) return;
+
+  if (*num < STATS_TOP_CELLS) (*num)++;
+
+  for (i = *num - 1 ; i > 0 && key[i - 1] < value ; i--)
+    {
+      top[i] = top[i - 1];
+      key[i] = key[i - 1];
+    }
+
+  top[i] = cell;
+  key[i] = value;
+}
+
+
+
+static void json_cells (FILE *fp, const char *name, const int32_t *top, int32_t num, uint8_t last)
+{
+  int32_t           i, cell;
+
+
+  fprintf (fp, "  \"%s\": [", name);
+
+  for (i = 0 ; i < num ; i++)
+    {
+      cell = top[i];
+
+      fprintf (fp, "%s\n    {\"cell\": %d, \"lon\": %g, \"lat\": %g, \"segments\": %d, \"vertices\": %d, \"bytes\": %d, "
+               "\"seconds\": %.6f}", i ? "," : "", cell, (cell % CELL_COLS) * CELL_DEGREES - 180.0,
+               (cell / CELL_COLS) * CELL_DEGREES - 90.0,
+               run_stats.cell_segments[cell], run_stats.cell_vertices[cell], run_stats.cell_bytes[cell],
+               run_stats.cell_seconds[cell]);
+    }
+
+  fprintf (fp, "%s]%s\n", num ? "\n  " : "", last ? "" : ",");
+}
+
+
+
+/*  Write everything to the --stats file as JSON.  The spans are in the Chrome trace event format so the file can be
+    loaded straight into chrome://tracing or Perfetto as well as being read by scripts.  The file is written under a
+    temporary name and renamed so a reader never sees half of it.  status is "running" for a snapshot and "complete" at
+    the end.  Only the cells that have been written so far are in the cell tables.  */
+
+void stats_write (const char *status)
+{
+  FILE              *fp;
+  char              *tmp_name;
+  int32_t           i, cell, largest[STATS_TOP_CELLS], slowest[STATS_TOP_CELLS], num_largest = 0, num_slowest = 0;
+  double            largest_key[STATS_TOP_CELLS], slowest_key[STATS_TOP_CELLS], now, end, cell_seconds = 0.0;
+  const OPTIONS     *options = run_stats.options;
+
+
+  if (!run_stats.enabled) return;
+
+  now = stats_clock () - run_stats.start;
+
+  for (cell = 0 ; cell < run_stats.cells_written ; cell++)
+    {
+      top_insert (largest, largest_key, &num_largest, cell, (double) run_stats.cell_vertices[cell]);
+      top_insert (slowest, slowest_key, &num_slowest, cell, (double) run_stats.cell_seconds[cell]);
+      cell_seconds += run_stats.cell_seconds[cell];
+    }
+
+
+  if ((tmp_name = (char *) malloc (strlen (run_stats.name) + 5)) == NULL)
+    {
+      perror ("Allocating statistics memory");
+      exit (-1);
+    }
+
+  sprintf (tmp_name, "%s.tmp", run_stats.name);
+
+  if ((fp = fopen (tmp_name, "w")) == NULL)
+    {
+      perror (tmp_name);
+      free (tmp_name);
+      return;
+    }
+
+
+  fprintf (fp, "{\n");
+  fprintf (fp, "  \"program\": ");
+  json_string (fp, VERSION);
+  fprintf (fp, ",\n  \"status\": \"%s\",\n", status);
+  fprintf (fp, "  \"elapsed_seconds\": %.6f,\n", now);
+  fprintf (fp, "  \"peak_rss_bytes\": %lld,\n", (long long) peak_rss ());
+
+  fprintf (fp, "  \"options\": {\"threads\": %d, \"max_memory_bytes\": %llu, \"mmap\": %s, \"prefetch\": %d, "
+           "\"compact\": %s, \"zlib\": %s, \"merge\": %s, \"lod_levels\": %d, \"tile_threshold\": %d},\n",
+           options->num_threads, (unsigned long long) options->max_memory, options->use_mmap ? "true" : "false",
+           options->prefetch, options->compact ? "true" : "false", options->compress ? "true" : "false", options->merge ? "true" : "false",
+           options->num_lod, options->tile_threshold);
+
+  fprintf (fp, "  \"input\": {\"files\": %d, \"shapes\": %lld, \"shapes_skipped\": %lld, \"vertices\": %lld, "
+           "\"prefetch_stalls\": %lld},\n", run_stats.files, (long long) run_stats.shapes,
+           (long long) run_stats.shapes_skipped, (long long) run_stats.vertices, (long long) run_stats.prefetch_stalls);
+
+  fprintf (fp, "  \"segments\": {\"created\": %lld, \"cell_crossings\": %lld, \"per_crossing\": %.4f},\n",
+           (long long) run_stats.segments, (long long) run_stats.crossings,
+           run_stats.crossings ? (double) run_stats.segments / (double) run_stats.crossings : 0.0);
+
+  fprintf (fp, "  \"scratch\": {\"spills\": %d, \"bytes_written\": %lld, \"bytes_read\": %lld, "
+           "\"spool_bytes_written\": %lld, \"memory_waits\": %lld},\n", run_stats.spills,
+           (long long) run_stats.scratch_written, (long long) run_stats.scratch_read, (long long) run_stats.spool_written,
+           (long long) run_stats.memory_waits);
+
+  fprintf (fp, "  \"output\": {");
+
+  if (run_stats.output_name != NULL)
+    {
+      fprintf (fp, "\"file\": ");
+      json_string (fp, run_stats.output_name);
+      fprintf (fp, ", ");
+    }
+
+  fprintf (fp, "\"cells_written\": %d, \"segments\": %lld, \"vertices\": %lld, \"record_bytes\": %lld, "
+           "\"encode_cell_seconds\": %.6f},\n", run_stats.cells_written, (long long) run_stats.output_segments,
+           (long long) run_stats.output_vertices, (long long) run_stats.output_bytes, cell_seconds);
+
+  fprintf (fp, "  \"bit_widths\": {\n");
+  json_histogram (fp, "count", run_stats.widths.count_bits, NVFalse);
+  json_histogram (fp, "lon_offset", run_stats.widths.lon_bits, NVFalse);
+  json_histogram (fp, "lat_offset", run_stats.widths.lat_bits, NVTrue);
+  fprintf (fp, "  },\n");
+
+  json_cells (fp, "largest_cells", largest, num_largest, NVFalse);
+  json_cells (fp, "slowest_cells", slowest, num_slowest, NVFalse);
+
+
+  /*  Unfinished spans run to now.  */
+
+  fprintf (fp, "  \"traceEvents\": [");
+
+  for (i = 0 ; i < run_stats.num_spans ; i++)
+    {
+      end = run_stats.span[i].end < 0.0 ? now : run_stats.span[i].end;
+
+      fprintf (fp, "%s\n    {\"name\": ", i ? "," : "");
+      json_string (fp, run_stats.span[i].name);
+      fprintf (fp, ", \"ph\": \"X\", \"pid\": 1, \"tid\": 1, \"ts\": %.0f, \"dur\": %.0f}", run_stats.span[i].start * 1.0e6,
+               (end - run_stats.span[i].start) * 1.0e6);
+    }
+
+  fprintf (fp, "%s]\n}\n", run_stats.num_spans ? "\n  " : "");
+
+
+  if (fclose (fp))
+    {
+      perror (tmp_name);
+    }
+  else
+    {
+#ifdef NVWIN3X
+      remove (run_stats.name);
+#endif
+
+      if (rename (tmp_name, run_stats.name)) perror (run_stats.name);
+    }
+
+  free (tmp_name);
+}
+
+
+
+void stats_free ()
+{
+  int32_t           i;
+
+
+  if (!run_stats.enabled) return;
+
+  for (i = 0 ; i < run_stats.num_spans ; i++) free (run_stats.span[i].name);
+
+  free (run_stats.cell_seconds);
+  free (run_stats.cell_segments);
+  free (run_stats.cell_vertices);
+  free (run_stats.cell_bytes);
+  free (run_stats.name);
+  if (run_stats.output_name != NULL) free (run_stats.output_name);
+  run_stats.output_name = NULL;
+
+  run_stats.enabled = NVFalse;
+  run_stats.num_spans = 0;
+}
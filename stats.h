@@ -0,0 +1,118 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include "build_coast.h"
+
+
+/*  Run statistics (--stats FILE).  The counters that cost nothing (an add per shape, segment, or spill) are always
+    kept.  Anything that needs a clock or a per cell table is only done when run_stats.enabled is set, so a normal
+    build pays one branch per cell for them.  Counters are only updated by the thread that owns them (ingest tasks and
+    encoder threads keep their own and they are added up by the main thread) so no locking is needed here.  */
+
+
+/*  Bit widths can be 0 to 32.  */
+
+#define         STATS_WIDTHS        33
+
+
+/*  Number of cells listed in each of the largest and slowest cell tables.  */
+
+#define         STATS_TOP_CELLS     16
+
+
+/*  Maximum number of trace spans kept (one per input file plus a few for each pass).  */
+
+#define         STATS_MAX_SPANS     256
+
+
+/*  Histograms of the count and lon/lat offset bit widths of the V1.0 records.  */
+
+typedef struct
+{
+  int64_t       count_bits[STATS_WIDTHS];
+  int64_t       lon_bits[STATS_WIDTHS];
+  int64_t       lat_bits[STATS_WIDTHS];
+} STATS_WIDTHS_HISTOGRAM;
+
+
+typedef struct
+{
+  char          *name;
+  double        start;                  /*  Seconds since stats_init  */
+  double        end;                    /*  Negative until the span is finished  */
+} STATS_SPAN;
+
+
+typedef struct
+{
+  uint8_t       enabled;                /*  NVTrue if --stats was given  */
+  char          *name;                  /*  JSON output file  */
+  const OPTIONS *options;
+  double        start;                  /*  stats_clock at stats_init  */
+
+  int32_t       files;                  /*  Input files read (pass 1, inputs read twice for --incremental count twice)  */
+  int64_t       shapes;                 /*  Shapes split into segments  */
+  int64_t       shapes_skipped;         /*  Shapes skipped by --bbox  */
+  int64_t       vertices;               /*  Vertices read from the shapes that were split  */
+  int64_t       prefetch_stalls;        /*  Times an ingest task had to wait for its --prefetch reader thread  */
+  int64_t       segments;               /*  Segments added to the cell store  */
+  int64_t       crossings;              /*  Cell boundary crossings inside a line  */
+
+  int32_t       spills;                 /*  Number of times the cell store spilled to the scratch file  */
+  int64_t       scratch_written;        /*  Bytes written to the scratch file  */
+  int64_t       scratch_read;           /*  Bytes read back from the scratch file  */
+  int64_t       spool_written;          /*  Bytes of packed records spilled to the spool file in pass 2  */
+  int64_t       memory_waits;           /*  Times an ingest or encoder thread waited for memory (MEMORY_WINDOW_SHARE)  */
+
+  char          *output_name;           /*  --job output that the output counters below are for, NULL otherwise  */
+  int32_t       cells_written;          /*  Full resolution cells written so far (in cell order)  */
+  int64_t       output_segments;        /*  Full resolution segments written  */
+  int64_t       output_vertices;        /*  Full resolution vertices written  */
+  int64_t       output_bytes;           /*  Full resolution cell record bytes written  */
+  float         *cell_seconds;          /*  Time spent packing each cell (CELL_COUNT)  */
+  int32_t       *cell_segments;         /*  Segments in each written cell (CELL_COUNT)  */
+  int32_t       *cell_vertices;         /*  Vertices in each written cell (CELL_COUNT)  */
+  int32_t       *cell_bytes;            /*  Record bytes of each written cell (CELL_COUNT)  */
+  STATS_WIDTHS_HISTOGRAM widths;        /*  Only complete once pass 2 is done  */
+
+  STATS_SPAN    span[STATS_MAX_SPANS];
+  int32_t       num_spans;
+} RUN_STATS;
+
+
+extern RUN_STATS run_stats;
+
+
+void stats_init (const char *name, const OPTIONS *options);
+double stats_clock ();
+int32_t stats_span_begin (const char *fmt, const char *arg);
+void stats_span_end (int32_t span);
+void stats_reset_output (const char *output_name);
+void stats_poll ();
+void stats_write (const char *status);
+void stats_free ();
+
+
+#endif
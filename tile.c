@@ -0,0 +1,201 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#include "tile.h"
+
+
+void tile_buffer_init (TILE_BUFFER *buf)
+{
+  memset (buf, 0, sizeof (TILE_BUFFER));
+}
+
+
+
+void tile_buffer_free (TILE_BUFFER *buf)
+{
+  if (buf->box != NULL) free (buf->box);
+  if (buf->offset != NULL) free (buf->offset);
+  if (buf->vertices != NULL) free (buf->vertices);
+  if (buf->tree != NULL) free (buf->tree);
+
+  tile_buffer_init (buf);
+}
+
+
+
+/*  Save the bounds and record offset of one segment (count interleaved lon/lat fixed point vertices).  */
+
+void tile_add_segment (TILE_BUFFER *buf, const int32_t *xy, int32_t count, int32_t offset)
+{
+  int32_t           i, *box;
+
+
+  if (buf->num_segments == buf->alloc)
+    {
+      buf->alloc = buf->alloc ? buf->alloc * 2 : 1024;
+
+      buf->box = (int32_t *) realloc (buf->box, 4 * (size_t) buf->alloc * sizeof (int32_t));
+      buf->offset = (int32_t *) realloc (buf->offset, (size_t) buf->alloc * sizeof (int32_t));
+      buf->vertices = (int32_t *) realloc (buf->vertices, (size_t) buf->alloc * sizeof (int32_t));
+      if (buf->box == NULL || buf->offset == NULL || buf->vertices == NULL)
+        {
+          perror ("Allocating tile memory");
+          exit (-1);
+        }
+    }
+
+  box = &buf->box[4 * buf->num_segments];
+
+  box[0] = box[2] = xy[0];
+  box[1] = box[3] = xy[1];
+
+  for (i = 1 ; i < count ; i++)
+    {
+      if (xy[2 * i] < box[0]) box[0] = xy[2 * i];
+      if (xy[2 * i] > box[2]) box[2] = xy[2 * i];
+      if (xy[2 * i + 1] < box[1]) box[1] = xy[2 * i + 1];
+      if (xy[2 * i + 1] > box[3]) box[3] = xy[2 * i + 1];
+    }
+
+  buf->offset[buf->num_segments] = offset;
+  buf->vertices[buf->num_segments] = count;
+  buf->num_segments++;
+}
+
+
+
+/*  Append one 32 bit big endian word to the tree.  */
+
+static void tree_put (TILE_BUFFER *buf, uint32_t value)
+{
+  if (buf->tree_size + 4 > buf->tree_alloc)
+    {
+      buf->tree_alloc = buf->tree_alloc ? buf->tree_alloc * 2 : 4096;
+
+      if ((buf->tree = (uint8_t *) realloc (buf->tree, buf->tree_alloc)) == NULL)
+        {
+          perror ("Allocating tile memory");
+          exit (-1);
+        }
+    }
+
+  buf->tree[buf->tree_size] = (uint8_t) (value >> 24);
+  buf->tree[buf->tree_size + 1] = (uint8_t) (value >> 16);
+  buf->tree[buf->tree_size + 2] = (uint8_t) (value >> 8);
+  buf->tree[buf->tree_size + 3] = (uint8_t) value;
+  buf->tree_size += 4;
+}
+
+
+
+/*  Write the node covering west to east and south to north (fixed point) for the num segments in list (indices in
+    increasing order, so the record offsets are too).  The node is split into quarters while the segments that touch
+    it have more than threshold vertices between them.  */
+
+static void build_node (TILE_BUFFER *buf, const int32_t *list, int32_t num, int32_t west, int32_t south, int32_t east,
+                        int32_t north, int32_t depth, int32_t threshold)
+{
+  int32_t           i, q, n, *quarter, *box, x0, y0, x1, y1;
+  int64_t           vertices = 0;
+
+
+  for (i = 0 ; i < num ; i++) vertices += buf->vertices[list[i]];
+
+  if (vertices <= threshold || depth == CCL_TILE_MAX_DEPTH)
+    {
+      tree_put (buf, (uint32_t) num);
+      for (i = 0 ; i < num ; i++) tree_put (buf, (uint32_t) buf->offset[list[i]]);
+      return;
+    }
+
+  tree_put (buf, CCL_TILE_SPLIT);
+
+  if ((quarter = (int32_t *) malloc (((size_t) num + 1) * sizeof (int32_t))) == NULL)
+    {
+      perror ("Allocating tile memory");
+      exit (-1);
+    }
+
+
+  /*  Southwest, southeast, northwest, northeast.  Segments that lie on the line between two quarters go in both.  */
+
+  for (q = 0 ; q < 4 ; q++)
+    {
+      x0 = (q & 1) ? (west + east) / 2 : west;
+      x1 = (q & 1) ? east : (west + east) / 2;
+      y0 = (q & 2) ? (south + north) / 2 : south;
+      y1 = (q & 2) ? north : (south + north) / 2;
+
+      for (i = 0, n = 0 ; i < num ; i++)
+        {
+          box = &buf->box[4 * list[i]];
+
+          if (box[0] <= x1 && box[2] >= x0 && box[1] <= y1 && box[3] >= y0) quarter[n++] = list[i];
+        }
+
+      build_node (buf, quarter, n, x0, y0, x1, y1, depth + 1, threshold);
+    }
+
+  free (quarter);
+}
+
+
+
+/*  Build the quadtree for a cell from the segments saved with tile_add_segment (which are then cleared).  Returns the
+    tree (allocated, the caller frees it) and its size in bytes.  */
+
+uint8_t *tile_build (TILE_BUFFER *buf, int32_t cell, int32_t threshold, size_t *size)
+{
+  int32_t           i, *list, west, south;
+  uint8_t           *tree;
+
+
+  if ((list = (int32_t *) malloc (((size_t) buf->num_segments + 1) * sizeof (int32_t))) == NULL)
+    {
+      perror ("Allocating tile memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < buf->num_segments ; i++) list[i] = i;
+
+  west = (cell % CELL_COLS) * CELL_SPAN;
+  south = (cell / CELL_COLS) * CELL_SPAN;
+
+  buf->tree_size = 0;
+
+  build_node (buf, list, buf->num_segments, west, south, west + CELL_SPAN, south + CELL_SPAN, 0, threshold);
+
+  free (list);
+
+  if ((tree = (uint8_t *) malloc (buf->tree_size)) == NULL)
+    {
+      perror ("Allocating tile memory");
+      exit (-1);
+    }
+
+  memcpy (tree, buf->tree, buf->tree_size);
+  *size = buf->tree_size;
+
+  buf->num_segments = 0;
+
+  return (tree);
+}
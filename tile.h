@@ -0,0 +1,51 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#ifndef __TILE_H__
+#define __TILE_H__
+
+#include "build_coast.h"
+
+
+/*  The bounds and record offset of every segment in the cell being packed, used to build the cell's quadtree (see
+    CCL_TAG_TILE in ccl_format.h) if it turns out to be dense.  Each encoder thread has one and it only grows.  */
+
+typedef struct
+{
+  int32_t       *box;                   /*  West, south, east, north (fixed point) of each segment  */
+  int32_t       *offset;                /*  Byte offset of each segment record from the start of the cell's records  */
+  int32_t       *vertices;              /*  Number of vertices in each segment  */
+  int32_t       num_segments;
+  int32_t       alloc;                  /*  Number of segments allocated  */
+  uint8_t       *tree;                  /*  Tree being built  */
+  size_t        tree_size;              /*  Number of bytes used in tree  */
+  size_t        tree_alloc;             /*  Number of bytes allocated for tree  */
+} TILE_BUFFER;
+
+
+void tile_buffer_init (TILE_BUFFER *buf);
+void tile_buffer_free (TILE_BUFFER *buf);
+void tile_add_segment (TILE_BUFFER *buf, const int32_t *xy, int32_t count, int32_t offset);
+uint8_t *tile_build (TILE_BUFFER *buf, int32_t cell, int32_t threshold, size_t *size);
+
+
+#endif
@@ -0,0 +1,96 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#ifndef __VARINT_H__
+#define __VARINT_H__
+
+#include <stdint.h>
+#include <string.h>
+
+
+/*  Byte aligned variable length integers for the compact (V2.0) segment records (see ccl_format.h).  Seven bits per
+    byte, low order bits first, with the high bit set on every byte but the last.  Signed values are zigzag coded first
+    (0, -1, 1, -2, 2 ... become 0, 1, 2, 3, 4 ...) so small deltas of either sign take one byte.  Like bit_reader.h
+    this only needs the C library.  */
+
+#define         VARINT_MAX_BYTES    5
+
+
+static inline uint32_t zigzag_encode (int32_t value)
+{
+  return (((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+}
+
+
+static inline int32_t zigzag_decode (uint32_t value)
+{
+  return ((int32_t) (value >> 1) ^ -(int32_t) (value & 1));
+}
+
+
+/*  Write value at ptr and return the number of bytes used (1 to VARINT_MAX_BYTES).  */
+
+static inline size_t varint_put (uint8_t *ptr, uint32_t value)
+{
+  size_t        n = 0;
+
+
+  while (value >= 0x80)
+    {
+      ptr[n++] = (uint8_t) (value | 0x80);
+      value >>= 7;
+    }
+
+  ptr[n++] = (uint8_t) value;
+
+  return (n);
+}
+
+
+/*  Read a value at *ptr (which is moved past it).  Returns 0 if it runs past end or is too long.  */
+
+static inline int32_t varint_get (const uint8_t **ptr, const uint8_t *end, uint32_t *value)
+{
+  const uint8_t *p = *ptr;
+  uint32_t      v = 0;
+  int32_t       shift;
+
+
+  for (shift = 0 ; shift < 7 * VARINT_MAX_BYTES ; shift += 7)
+    {
+      if (p >= end) return (0);
+
+      v |= (uint32_t) (*p & 0x7f) << shift;
+
+      if (!(*p++ & 0x80))
+        {
+          *value = v;
+          *ptr = p;
+          return (1);
+        }
+    }
+
+  return (0);
+}
+
+
+#endif
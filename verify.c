@@ -0,0 +1,360 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#include "verify.h"
+#include "ccl_reader.h"
+
+#include <pthread.h>
+#include <stdarg.h>
+
+
+/*  Shared state for the verify threads.  Each thread takes VERIFY_BLOCK cells at a time and decodes every level of
+    them into its own buffers.  */
+
+typedef struct
+{
+  const CCL_FILE    *ccl;
+  const CELL_CHECK  *check;
+  int32_t           max_segments;           /*  Largest cell at any level  */
+  int32_t           max_vertices;
+  int32_t           next_cell;
+  int32_t           bad_cells;              /*  Cells with at least one problem  */
+  int32_t           reports;                /*  Problems printed so far  */
+  int64_t           segments;               /*  Full resolution segments and vertices decoded  */
+  int64_t           vertices;
+  pthread_mutex_t   mutex;
+} VERIFY_POOL;
+
+
+
+static void report (VERIFY_POOL *pool, int32_t cell, int32_t level, const char *fmt, ...)
+{
+  va_list           args;
+
+
+  pthread_mutex_lock (&pool->mutex);
+
+  if (pool->reports++ < VERIFY_MAX_REPORTS)
+    {
+      fprintf (stderr, "Cell %d (lat %g, lon %g) level %d: ", cell, (cell / CELL_COLS) * CELL_DEGREES - 90.0,
+               (cell % CELL_COLS) * CELL_DEGREES - 180.0, level);
+
+      va_start (args, fmt);
+      vfprintf (stderr, fmt, args);
+      va_end (args);
+
+      fprintf (stderr, "\n");
+      fflush (stderr);
+    }
+
+  pthread_mutex_unlock (&pool->mutex);
+}
+
+
+
+/*  Check one cell.  xy, count, lon, and lat are the thread's decode buffers.  Returns the number of problems.  */
+
+static int32_t verify_cell (VERIFY_POOL *pool, int32_t cell, int32_t *count, int32_t *xy, double *lon, double *lat)
+{
+  const CCL_FILE    *ccl = pool->ccl;
+  const CCL_LEVEL   *lv;
+  const CELL_CHECK  *check = &pool->check[cell];
+  int32_t           level, i, num, nv, problems = 0;
+  uint64_t          hash;
+
+
+  for (level = 0 ; level < ccl->num_levels ; level++)
+    {
+      lv = &ccl->level[level];
+
+
+      /*  The full resolution header has to be exactly what the writer meant to write.  */
+
+      if (!level)
+        {
+          if (lv->address[cell] != check->address)
+            {
+              report (pool, cell, level, "header address is %d, should be %d", lv->address[cell], check->address);
+              problems++;
+            }
+
+          if (lv->num_segments[cell] != check->num_segments)
+            {
+              report (pool, cell, level, "header has %d segments, should be %d", lv->num_segments[cell],
+                      check->num_segments);
+              problems++;
+            }
+
+          if (lv->num_vertices[cell] != check->num_vertices)
+            {
+              report (pool, cell, level, "header has %d vertices, should be %d", lv->num_vertices[cell],
+                      check->num_vertices);
+              problems++;
+            }
+
+          if (lv->cell_size[cell] != check->size)
+            {
+              report (pool, cell, level, "records are %d bytes, should be %d", lv->cell_size[cell], check->size);
+              problems++;
+            }
+
+          if (problems) return (problems);
+        }
+
+
+      /*  Decoding checks that every record fits in the cell and that the vertices add up to the header count.  */
+
+      if ((num = ccl_decode_cell_fixed (ccl, level, cell, count, pool->max_segments, xy, pool->max_vertices)) < 0)
+        {
+          report (pool, cell, level, "the %d segment records don't decode", lv->num_segments[cell]);
+          problems++;
+          continue;
+        }
+
+      if (level) continue;
+
+
+      /*  Compare the decoded vertices with the bucketed (and possibly merged) segments that were packed.  */
+
+      if (check->packed)
+        {
+          hash = VERIFY_HASH_START;
+
+          for (i = 0, nv = 0 ; i < num ; i++)
+            {
+              hash = verify_hash_segment (hash, &xy[2 * nv], count[i]);
+              nv += count[i];
+            }
+
+          if (hash != check->hash)
+            {
+              report (pool, cell, level, "the %d decoded vertices hash to %016llx, the packed segments to %016llx", nv,
+                      (unsigned long long) hash, (unsigned long long) check->hash);
+              problems++;
+            }
+        }
+
+
+      /*  A window covering the whole cell has to find every segment through the quadtree.  */
+
+      if (ccl->tile_address != NULL && ccl->tile_size[cell])
+        {
+          double west = (cell % CELL_COLS) * CELL_DEGREES - 180.0, south = (cell / CELL_COLS) * CELL_DEGREES - 90.0;
+
+          num = ccl_decode_window (ccl, cell, west, south, west + CELL_DEGREES, south + CELL_DEGREES, count,
+                                   pool->max_segments, lon, lat, pool->max_vertices);
+
+          if (num != lv->num_segments[cell])
+            {
+              report (pool, cell, level, "the quadtree finds %d of the %d segments", num, lv->num_segments[cell]);
+              problems++;
+            }
+        }
+    }
+
+  return (problems);
+}
+
+
+
+static void *verify_thread (void *arg)
+{
+  VERIFY_POOL       *pool = (VERIFY_POOL *) arg;
+  int32_t           *count, *xy, first, cell, bad;
+  int64_t           segments, vertices;
+  double            *lon, *lat;
+
+
+  count = (int32_t *) malloc ((size_t) MAX (pool->max_segments, 1) * sizeof (int32_t));
+  xy = (int32_t *) malloc ((size_t) MAX (pool->max_vertices, 1) * 2 * sizeof (int32_t));
+  lon = (double *) malloc ((size_t) MAX (pool->max_vertices, 1) * sizeof (double));
+  lat = (double *) malloc ((size_t) MAX (pool->max_vertices, 1) * sizeof (double));
+  if (count == NULL || xy == NULL || lon == NULL || lat == NULL)
+    {
+      perror ("Allocating verify memory");
+      exit (-1);
+    }
+
+  bad = 0;
+  segments = vertices = 0;
+
+  while (NVTrue)
+    {
+      pthread_mutex_lock (&pool->mutex);
+      first = pool->next_cell;
+      pool->next_cell += VERIFY_BLOCK;
+      pthread_mutex_unlock (&pool->mutex);
+
+      if (first >= CELL_COUNT) break;
+
+      for (cell = first ; cell < MIN (first + VERIFY_BLOCK, CELL_COUNT) ; cell++)
+        {
+          if (verify_cell (pool, cell, count, xy, lon, lat)) bad++;
+
+          segments += pool->ccl->level[0].num_segments[cell];
+          vertices += pool->ccl->level[0].num_vertices[cell];
+        }
+    }
+
+  pthread_mutex_lock (&pool->mutex);
+  pool->bad_cells += bad;
+  pool->segments += segments;
+  pool->vertices += vertices;
+  pthread_mutex_unlock (&pool->mutex);
+
+  free (count);
+  free (xy);
+  free (lon);
+  free (lat);
+
+  return (NULL);
+}
+
+
+
+/*  With --index the file should have been opened through its sparse index.  Load the headers from the file as well
+    and make sure the index has exactly the same levels, cells, and quadtrees.  Returns 0 if it does.  */
+
+static int32_t verify_index (const CCL_FILE *ccl, const char *name)
+{
+  CCL_FILE          *plain;
+  int32_t           level, bad = 0;
+
+
+  if (!ccl->indexed)
+    {
+      fprintf (stderr, "The index of %s is missing or doesn't match the file\n", name);
+      return (-1);
+    }
+
+  if ((plain = ccl_open_headers (name, 1)) == NULL)
+    {
+      fprintf (stderr, "Unable to open %s with the reader\n", name);
+      return (-1);
+    }
+
+  if (plain->num_levels != ccl->num_levels || plain->tile_threshold != ccl->tile_threshold ||
+      plain->tile_block != ccl->tile_block || plain->tile_block_size != ccl->tile_block_size ||
+      (plain->tile_address != NULL &&
+       memcmp (plain->tile_address, ccl->tile_address, 2 * CELL_COUNT * sizeof (int32_t)))) bad = 1;
+
+  for (level = 0 ; !bad && level < ccl->num_levels ; level++)
+    {
+      if (plain->level[level].tolerance != ccl->level[level].tolerance ||
+          memcmp (plain->level[level].address, ccl->level[level].address, 4 * CELL_COUNT * sizeof (int32_t))) bad = 1;
+    }
+
+  if (bad) fprintf (stderr, "The index of %s doesn't match the headers in the file\n", name);
+
+  ccl_close (plain);
+
+  return (bad ? -1 : 0);
+}
+
+
+
+/*  --verify.  Open the finished file with the reader, check that the version block and the extensions are what we
+    asked for, and then decode every cell at every level with options->num_threads threads.  The full resolution
+    header entries are compared with options->check (filled in by encode_cells) and the decoded vertices of every cell
+    that was packed in this run are hashed and compared with the hash of the segments the encoder got from the store.
+    Cells copied from the previous file by --incremental are only decoded.  With --index the sparse index must match
+    the headers in the file.  Returns the number of bad cells (-1 if the
+    file can't be opened or doesn't match the options at all).  */
+
+int32_t verify_file (const char *name, const char *file_version, const OPTIONS *options)
+{
+  VERIFY_POOL       pool;
+  CCL_FILE          *ccl;
+  pthread_t         *threads;
+  int32_t           i, level, cell, num_threads = MAX (options->num_threads, 1);
+  size_t            n;
+
+
+  if ((ccl = ccl_open (name, 1)) == NULL)
+    {
+      fprintf (stderr, "Unable to open %s with the reader\n", name);
+      return (-1);
+    }
+
+  n = strlen (file_version);
+
+  if (strncmp (ccl->version, file_version, n) || ccl->version[n] != '\n' || ccl->num_levels != 1 + options->num_lod ||
+      ccl->tile_threshold != options->tile_threshold || ccl->compressed != options->compress)
+    {
+      fprintf (stderr, "The version block or extensions of %s don't match the options\n", name);
+      ccl_close (ccl);
+      return (-1);
+    }
+
+  if (options->index && verify_index (ccl, name))
+    {
+      ccl_close (ccl);
+      return (-1);
+    }
+
+
+  memset (&pool, 0, sizeof (VERIFY_POOL));
+  pool.ccl = ccl;
+  pool.check = options->check;
+
+  for (level = 0 ; level < ccl->num_levels ; level++)
+    {
+      for (cell = 0 ; cell < CELL_COUNT ; cell++)
+        {
+          pool.max_segments = MAX (pool.max_segments, ccl->level[level].num_segments[cell]);
+          pool.max_vertices = MAX (pool.max_vertices, ccl->level[level].num_vertices[cell]);
+        }
+    }
+
+  pthread_mutex_init (&pool.mutex, NULL);
+
+  threads = (pthread_t *) malloc (num_threads * sizeof (pthread_t));
+  if (threads == NULL)
+    {
+      perror ("Allocating thread memory");
+      exit (-1);
+    }
+
+  for (i = 0 ; i < num_threads ; i++)
+    {
+      if (pthread_create (&threads[i], NULL, verify_thread, &pool))
+        {
+          perror ("Creating verify thread");
+          exit (-1);
+        }
+    }
+
+  for (i = 0 ; i < num_threads ; i++) pthread_join (threads[i], NULL);
+
+
+  if (pool.reports > VERIFY_MAX_REPORTS)
+    fprintf (stderr, "%d more problems were not printed\n", pool.reports - VERIFY_MAX_REPORTS);
+
+  PROGRESS ("Verified %lld segments and %lld vertices in %d levels, %d bad cells\n\n", (long long) pool.segments,
+            (long long) pool.vertices, ccl->num_levels, pool.bad_cells);
+
+  free (threads);
+  pthread_mutex_destroy (&pool.mutex);
+  ccl_close (ccl);
+
+  return (pool.bad_cells);
+}
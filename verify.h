@@ -0,0 +1,64 @@
+
+/*********************************************************************************************
+
+    This is public domain software that was developed by or for the U.S. Naval Oceanographic
+    Office and/or the U.S. Army Corps of Engineers.
+
+    This is a work of the U.S. Government. In accordance with 17 USC 105, copyright protection
+    is not available for any work of the U.S. Government.
+
+    Neither the United States Government, nor any employees of the United States Government,
+    nor the author, makes any warranty, express or implied, without even the implied warranty
+    of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE, or assumes any liability or
+    responsibility for the accuracy, completeness, or usefulness of any information,
+    apparatus, product, or process disclosed, or represents that its use would not infringe
+    privately-owned rights. Reference herein to any specific commercial products, process,
+    or service by trade name, trademark, manufacturer, or otherwise, does not necessarily
+    constitute or imply its endorsement, recommendation, or favoring by the United States
+    Government. The views and opinions of authors expressed herein do not necessarily state
+    or reflect those of the United States Government, and shall not be used for advertising
+    or product endorsement purposes.
+
+*********************************************************************************************/
+#ifndef __VERIFY_H__
+#define __VERIFY_H__
+
+#include "build_coast.h"
+
+
+/*  Number of cells a verify thread takes at a time.  */
+
+#define         VERIFY_BLOCK        256
+
+
+/*  Only this many problems are printed, the rest are just counted.  */
+
+#define         VERIFY_MAX_REPORTS  100
+
+
+/*  Start value for verify_hash_segment.  */
+
+#define         VERIFY_HASH_START   0xcbf29ce484222325ULL
+
+
+/*  FNV-1a style hash of one segment (the vertex count and the count fixed point lon/lat pairs in xy), 32 bits at a
+    time.  The encoder hashes the segments it packs and the verifier hashes the segments it decodes, so this has to be
+    the same on both sides.  */
+
+static inline uint64_t verify_hash_segment (uint64_t hash, const int32_t *xy, int32_t count)
+{
+  int32_t           k;
+
+
+  hash = (hash ^ (uint32_t) count) * 0x100000001b3ULL;
+
+  for (k = 0 ; k < 2 * count ; k++) hash = (hash ^ (uint32_t) xy[k]) * 0x100000001b3ULL;
+
+  return (hash);
+}
+
+
+int32_t verify_file (const char *name, const char *file_version, const OPTIONS *options);
+
+
+#endif
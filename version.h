@@ -23,9 +23,12 @@
 
 #ifndef VERSION
 
-#define     VERSION     "PFM Software - build_coast V1.05 - 07/29/14"
+#include "ccl_format.h"
 
-#define     FILE_VERSION "PFM Software - Compressed Coastline file V1.0 - 07/10/06"
+#define     VERSION     "PFM Software - build_coast V2.00 - 10/14/26"
+
+#define     FILE_VERSION "PFM Software - Compressed Coastline file V1.0" CCL_PROFILE_TAG " - 07/10/06"
+#define     COMPACT_FILE_VERSION "PFM Software - Compressed Coastline file V2.0" CCL_PROFILE_TAG " - 10/14/26"
 
 #endif
 
@@ -73,4 +76,90 @@
 
     - Fixed errors discovered by cppcheck.
 
+
+    Version 2.00
+    PFM Software
+    10/14/26
+
+    - Segments are now bucketed by cell in memory (cell_store.c) instead of being appended to 64,800 cell_XXX_YYY
+      temporary files.  If the --max-memory limit is exceeded cell data is spilled to a single scratch file as chains
+      of fixed size chunks for each cell (read back with large sequential reads in pass 2).
+    - Pass 2 packs cells on multiple threads (--threads, encode.c) with a single writer emitting them in canonical
+      cell order so the output is identical to the single threaded output.
+    - Pass 1 reads the input files (and ranges of shapes within large files) on multiple threads (ingest.c).  Each
+      task buckets into its own cell store and the stores are merged in file/shape order.
+    - Added --mmap to read the .shp/.shx files by memory mapping them and walking the records in place (shp_map.c)
+      instead of allocating every shape with SHPReadObject.
+    - Segment buffers in pass 1 grow geometrically and are reused from segment to segment, and pass 2 packs
+      segments straight into the cell output buffer, so there is no per vertex or per segment allocation.
+    - Segments are built as complete interleaved records and added to the cell store with a single copy, and
+      spills to the scratch file are written with a few large pwritev calls.
+    - Removed the per segment and per vertex debug prints from pass 2.  They are now TRACE statements that are
+      compiled out unless BUILD_COAST_TRACE is defined and are printed with --trace.  Added --quiet.
+    - The header table is built in memory while the cells are written and written with one seek and one write at
+      the end instead of 64,800 individual entry writes plus a seek back for every populated cell.
+    - Segment records are packed with a 64 bit accumulator bit writer (bit_writer.h) instead of one bit_pack call
+      per field.  The bit layout is unchanged.
+    - The min/max lon/lat delta scan for each segment uses SSE2/SSE4.1/AVX2 or NEON when the compiler targets them
+      (delta_scan.h) and the bit counts are computed with integer math instead of log10.  The bit counts are
+      identical to the old ones for every 32 bit value.
+    - The vertices of each shape are converted to fixed point positions and cells in one pass (quantize.c, using
+      SSE2/AVX or NEON when available) so the segment splitter only works with integers.  The 360.0 longitude check
+      is now a select instead of a branch.
+    - Added output name - to write the .ccl file to standard output.  The packed cells are held until they are all
+      done and then everything is written in order so no seeking is needed.
+    - Added --incremental.  A manifest next to the output file records a hash of each input and the cells it
+      touched so that a rebuild only splits and packs the cells affected by changed inputs and copies the rest of
+      the cell records from the previous file.
+    - Added --bbox W,S,E,N to build only the cells that overlap an area.  Input files and shapes that are outside
+      of those cells are skipped using their bounds before any vertices are split.
+    - Moved the .ccl layout definitions to ccl_format.h and added a random access reader (ccl_reader.c) with
+      cell and bounding box queries, decoding into caller supplied buffers, and an LRU cache of decoded cells.
+    - Fixed the last segment of each input file being written a second time when the next file was started.
+    - Added --lod to write simplified levels of detail (simplify.c) after the full resolution cells.  They are
+      found through an extension directory at the end of the file and the version block notes them in extra
+      lines after the version string so V1.0 readers are not affected.  The reader and --incremental handle them.
+    - Added --subdivide N to write a quadtree index (tile.c) for each cell with more than N vertices in another
+      extension block.  ccl_decode_window in the reader uses it to decode only the segments near a small area.
+    - Added --merge to join the segments of a cell whose end points coincide and drop degenerate segments
+      (merge.c) before they are packed.
+    - Added --compact to write V2.0 files with byte aligned zigzag varint segment records and cell relative start
+      points (varint.h), and --zlib to also compress the records of each cell.  The reader handles V1.0 and V2.0.
+    - Added a benchmark (bench/bench.c, built with bench/mk) that generates repeatable synthetic shapefiles and
+      reports the best time, vertices/s, and MB/s of the read, ingest, bucket, encode, write, and decode phases.
+    - Added --stats FILE to write JSON run statistics (input, segment, and cell crossing counts, scratch file
+      traffic, bit width histograms, the largest and slowest cells, peak RSS, and Chrome trace event spans) at the
+      end of the build or when SIGUSR1 is received (stats.c).
+    - Added --verify to decode the finished file in parallel with the reader (verify.c) and check the header entries,
+      record sizes, vertex hashes against the packed cell store segments, and quadtrees of every cell.
+    - Added --export geojson|wkb|shp (and --level) to convert an existing .ccl file (export.c).  Rows of cells are
+      decoded and formatted by all of the threads into their own buffers and written in order.
+
+    - Normalize each shape to the grid once, up front (quantize.c).  Longitudes past 180 are wrapped, points at
+      exactly 180 stay on the east edge of the last cell instead of jumping to the 0 degree cell, the poles are
+      clamped into the first and last rows, lines that cross the antimeridian are split with an interpolated vertex
+      on each side, and polygon closing edges along the antimeridian or a pole are dropped.
+
+    - Added build time grid and position profiles (CCL_GRID and CCL_SCALE in ccl_format.h) for 0.5, 2, and 5
+      degree cells and 1e-4 or 1e-6 degree positions.  All of the grid sizes and field widths stay constants so the
+      quantizing and packing loops are the same code as before.  Other profiles are recorded in FILE_VERSION.
+    - The LOD LEVELS and TILE THRESHOLD lines are left out of the version block when they don't fit in its 128
+      bytes (they used to overrun it).  Readers get both from the extension directory.
+
+    - Added --prefetch N.  The shapelib path reads and decodes the shapes of each ingest task on a reader thread
+      and hands them to the segment splitter in batches through a bounded ring, and both paths ask the kernel to
+      read the .shp file ahead of us (posix_fadvise, or madvise with --mmap).
+
+    - Added --index to write a sparse index (OUTPUT.cci) of the populated cells of every level.  ccl_open loads
+      the headers from it when it matches the file so opening a file reads a few KB instead of every header.
+
+    - --max-memory now covers pass 2 as well.  The ingest tasks waiting to be merged and the cells packed ahead of
+      the writer are held to 1/8 of it (the threads wait for the merge or the writer), and the levels of detail,
+      quadtrees, and streamed cells that are held until the end of the file go to a spool that spills to a scratch
+      file instead of all staying in memory.
+
+    - Added --job to build several output files (different input files or boxes) from one pass over the inputs.
+      The store remembers where each input file's segments start in every cell and each output is packed from the
+      shared store in turn.
+
 */